@@ -353,6 +353,8 @@ typedef void (MDB_rel_func)(MDB_val *item, void *oldptr, void *newptr, void *rel
 #define MDB_INTEGERDUP	0x20
 	/** with #MDB_DUPSORT, use reverse string dups */
 #define MDB_REVERSEDUP	0x40
+	/** keep subtree counts in branch pages, for #mdb_cursor_rank() */
+#define MDB_COUNTED		0x80
 	/** create DB if not already existing */
 #define MDB_CREATE		0x40000
 /** @} */
@@ -507,6 +509,45 @@ typedef struct MDB_envinfo {
 	unsigned int me_numreaders;		/**< max reader slots used in the environment */
 } MDB_envinfo;
 
+/** @brief Where the time of a commit went, see #mdb_txn_commit_stat() */
+typedef struct MDB_commit_stat {
+	uint64_t	cs_total_ns;		/**< Time for the whole commit */
+	uint64_t	cs_dbs_ns;			/**< Updating the records of named DBs */
+	uint64_t	cs_freelist_ns;		/**< Saving the freelist */
+	uint64_t	cs_flush_ns;		/**< Writing dirty pages */
+	uint64_t	cs_sync_ns;			/**< Syncing the data file */
+	uint64_t	cs_meta_ns;			/**< Writing and syncing the meta page */
+	mdb_size_t	cs_dirty_pages;		/**< Dirty pages flushed, overflow chains count once */
+	mdb_size_t	cs_written_pages;	/**< Pages written, counting every overflow page */
+	mdb_size_t	cs_written_bytes;	/**< Bytes written, not counting the meta page */
+	mdb_size_t	cs_freelist_pages;	/**< Free pages recorded by this commit */
+} MDB_commit_stat;
+
+/** @brief Page types reported by #mdb_page_walk() */
+#define MDB_PAGE_BRANCH		1
+#define MDB_PAGE_LEAF		2
+#define MDB_PAGE_OVERFLOW	3
+
+/** @brief One page of a database, see #mdb_page_walk() */
+typedef struct MDB_page_info {
+	mdb_size_t	pi_pgno;		/**< Number of the (first) page */
+	unsigned int	pi_type;		/**< #MDB_PAGE_BRANCH, #MDB_PAGE_LEAF or #MDB_PAGE_OVERFLOW */
+	unsigned int	pi_depth;		/**< Level in its tree, 1 for the root */
+	unsigned int	pi_nkeys;		/**< Number of nodes, 0 for overflow pages */
+	unsigned int	pi_pages;		/**< Pages spanned, more than 1 only for overflow pages */
+	size_t	pi_size;			/**< Bytes spanned, pi_pages times the page size */
+	size_t	pi_used;			/**< Bytes used by the header, nodes and data */
+	int		pi_dup;				/**< Nonzero for pages of a sorted-duplicate subtree */
+} MDB_page_info;
+
+/** @brief A callback function for #mdb_page_walk().
+ *
+ * @param[in] info The page being visited
+ * @param[in] ctx An arbitrary context pointer for the callback
+ * @return 0 to continue, anything else stops the walk and is returned
+ */
+typedef int (MDB_page_func)(const MDB_page_info *info, void *ctx);
+
 	/** @brief Return the LMDB library version information.
 	 *
 	 * @param[out] major if non-NULL, the library major version number is copied here
@@ -915,6 +956,29 @@ int  mdb_env_set_maxreaders(MDB_env *env, unsigned int readers);
 	 */
 int  mdb_env_get_maxreaders(MDB_env *env, unsigned int *readers);
 
+	/** @brief Let write transactions spin on the writer lock before blocking.
+	 *
+	 * Beginning a write transaction waits for the writer lock. When many
+	 * threads run short write transactions, sleeping and being woken up on
+	 * every handoff can cost as much as the transactions themselves. With
+	 * this option #mdb_txn_begin() first retries the lock without blocking,
+	 * adapting the number of tries to how many recently sufficed, and only
+	 * blocks when that fails. A process that dies holding the lock is still
+	 * recovered as with the blocking lock.
+	 * This setting is per #MDB_env and may be changed at any time. It only
+	 * has an effect where the lock is a POSIX mutex, not with semaphores or
+	 * on Windows.
+	 * @param[in] env An environment handle returned by #mdb_env_create()
+	 * @param[in] spins The most tries before blocking, 0 to always block.
+	 * The default is 0.
+	 * @return A non-zero error value on failure and 0 on success. Some possible
+	 * errors are:
+	 * <ul>
+	 *	<li>EINVAL - an invalid parameter was specified.
+	 * </ul>
+	 */
+int  mdb_env_set_writespin(MDB_env *env, unsigned int spins);
+
 	/** @brief Set the maximum number of named databases for the environment.
 	 *
 	 * This function is only needed if multiple databases will be used in the
@@ -1051,6 +1115,21 @@ mdb_size_t mdb_txn_id(MDB_txn *txn);
 	 */
 int  mdb_txn_commit(MDB_txn *txn);
 
+	/** @brief Commit a transaction and report where the time went.
+	 *
+	 * This is #mdb_txn_commit(), timing each phase of the commit with
+	 * a monotonic clock. The clock is only read when \b stat is not NULL.
+	 * Phases that do not apply, such as the sync of an #MDB_NOSYNC
+	 * environment, report close to zero. A commit that wrote nothing, or
+	 * the commit of a nested transaction, only reports its total time.
+	 * With #MDB_WRITEMAP pages are not written but only marked clean, the
+	 * page and byte counts then tell how much the sync had to write out.
+	 * @param[in] txn A transaction handle returned by #mdb_txn_begin()
+	 * @param[out] stat Address where the statistics will be stored, may be NULL
+	 * @return As #mdb_txn_commit(). \b stat is only meaningful on success.
+	 */
+int  mdb_txn_commit_stat(MDB_txn *txn, MDB_commit_stat *stat);
+
 	/** @brief Abandon all the operations of the transaction instead of saving them.
 	 *
 	 * The transaction handle is freed. It and its cursors must not be used
@@ -1157,6 +1236,13 @@ int  mdb_txn_renew(MDB_txn *txn);
 	 *	<li>#MDB_REVERSEDUP
 	 *		This option specifies that duplicate data items should be compared as
 	 *		strings in reverse order.
+	 *	<li>#MDB_COUNTED
+	 *		Keep the number of data items below each branch node in the node
+	 *		itself, so that #mdb_cursor_rank() and #mdb_cursor_select() run in
+	 *		logarithmic time. This option only applies to named databases and
+	 *		may not be combined with #MDB_DUPSORT. It must be given when the
+	 *		database is created; databases created with it must not be written
+	 *		by LMDB versions that do not know this option.
 	 *	<li>#MDB_CREATE
 	 *		Create the named database if it doesn't exist. This option is not
 	 *		allowed in a read-only transaction or a read-only environment.
@@ -1186,6 +1272,32 @@ int  mdb_dbi_open(MDB_txn *txn, const char *name, unsigned int flags, MDB_dbi *d
 	 */
 int  mdb_stat(MDB_txn *txn, MDB_dbi dbi, MDB_stat *stat);
 
+	/** @brief Visit every page of a database.
+	 *
+	 * The tree is walked depth first and \b func is called once for each
+	 * branch and leaf page, parent before children, and once for each
+	 * overflow chain, right after the leaf that points to it. The pages of
+	 * sorted-duplicate subtrees are visited too, with pi_dup set and a depth
+	 * relative to the subtree root. Sub-pages stored inside a leaf node are
+	 * not pages of their own and count as used space of that leaf. The main
+	 * DB's records of named databases are not followed, walk each named
+	 * database with its own handle. Walking the freelist, dbi 0, is allowed.
+	 * A read-only transaction sees a consistent snapshot, so several threads
+	 * can walk different databases of the same snapshot in parallel.
+	 * @param[in] txn A transaction handle returned by #mdb_txn_begin()
+	 * @param[in] dbi A database handle returned by #mdb_dbi_open()
+	 * @param[in] func A #MDB_page_func function
+	 * @param[in] ctx An arbitrary pointer passed to \b func
+	 * @return A non-zero error value on failure, the nonzero return
+	 * of \b func if it stopped the walk, and 0 on success. Some possible
+	 * errors are:
+	 * <ul>
+	 *	<li>#MDB_CORRUPTED - a page had an unexpected type.
+	 *	<li>EINVAL - an invalid parameter was specified.
+	 * </ul>
+	 */
+int  mdb_page_walk(MDB_txn *txn, MDB_dbi dbi, MDB_page_func *func, void *ctx);
+
 	/** @brief Retrieve the DB flags for a database handle.
 	 *
 	 * @param[in] txn A transaction handle returned by #mdb_txn_begin()
@@ -1224,6 +1336,29 @@ void mdb_dbi_close(MDB_env *env, MDB_dbi dbi);
 	 */
 int  mdb_drop(MDB_txn *txn, MDB_dbi dbi, int del);
 
+	/** @brief Exchange the contents of two named databases.
+	 *
+	 * The database records of \b a and \b b are swapped, so that each
+	 * handle refers to the tree the other one held. No pages are read,
+	 * written or copied. Like every other change, the exchange becomes
+	 * visible to other transactions atomically when this transaction
+	 * commits. Both databases must have been opened with the same flags,
+	 * and the same comparison functions should be set on both handles.
+	 * Cursors open on either database in this transaction are reset.
+	 * @param[in] txn A transaction handle returned by #mdb_txn_begin()
+	 * @param[in] a A database handle returned by #mdb_dbi_open()
+	 * @param[in] b Another database handle returned by #mdb_dbi_open()
+	 * @return A non-zero error value on failure and 0 on success. Some possible
+	 * errors are:
+	 * <ul>
+	 *	<li>#MDB_INCOMPATIBLE - the databases were created with different flags.
+	 *	<li>EACCES - an attempt was made to write in a read-only transaction.
+	 *	<li>EINVAL - an invalid parameter was specified, or \b a and \b b
+	 *		are the same database or not named databases.
+	 * </ul>
+	 */
+int  mdb_dbi_swap(MDB_txn *txn, MDB_dbi a, MDB_dbi b);
+
 	/** @brief Set a custom key comparison function for a database.
 	 *
 	 * The comparison function is called whenever it is necessary to compare a
@@ -1406,6 +1541,34 @@ int  mdb_put(MDB_txn *txn, MDB_dbi dbi, MDB_val *key, MDB_val *data,
 	 */
 int  mdb_del(MDB_txn *txn, MDB_dbi dbi, MDB_val *key, MDB_val *data);
 
+	/** @brief Delete a range of keys from a database.
+	 *
+	 * This function removes all key/data pairs whose keys are not less
+	 * than \b lo and less than \b hi. Subtrees that lie entirely inside
+	 * the range are unlinked from their parent page as a whole and their
+	 * pages are freed without being rewritten; only the keys at the two
+	 * edges of the range are deleted one at a time. In #MDB_COUNTED
+	 * databases without overflow pages the leaf pages of unlinked
+	 * subtrees are not even read. For #MDB_DUPSORT databases every key is deleted individually.
+	 * Cursors open on the database in this transaction are reset, as
+	 * with #mdb_drop().
+	 * @param[in] txn A transaction handle returned by #mdb_txn_begin()
+	 * @param[in] dbi A database handle returned by #mdb_dbi_open()
+	 * @param[in] lo The first key to delete, or NULL to start at the first key
+	 * @param[in] hi The key to stop at, or NULL to delete through the last key
+	 * @param[out] countp Address where the number of deleted data items
+	 * will be stored, may be NULL
+	 * @return A non-zero error value on failure and 0 on success. Some possible
+	 * errors are:
+	 * <ul>
+	 *	<li>#MDB_TXN_FULL - the transaction has too many dirty pages.
+	 *	<li>EACCES - an attempt was made to write in a read-only transaction.
+	 *	<li>EINVAL - an invalid parameter was specified.
+	 * </ul>
+	 */
+int  mdb_del_range(MDB_txn *txn, MDB_dbi dbi, MDB_val *lo, MDB_val *hi,
+			    mdb_size_t *countp);
+
 	/** @brief Create a cursor handle.
 	 *
 	 * A cursor is associated with a specific transaction and database.
@@ -1589,6 +1752,101 @@ int  mdb_cursor_del(MDB_cursor *cursor, unsigned int flags);
 	 */
 int  mdb_cursor_count(MDB_cursor *cursor, mdb_size_t *countp);
 
+	/** @brief Return the position of the current key in its database.
+	 *
+	 * The rank is the number of keys in the database that sort before
+	 * the current key. This call is only valid on databases opened
+	 * with #MDB_COUNTED.
+	 * @param[in] cursor A cursor handle returned by #mdb_cursor_open()
+	 * @param[out] rankp Address where the rank will be stored
+	 * @return A non-zero error value on failure and 0 on success. Some possible
+	 * errors are:
+	 * <ul>
+	 *	<li>#MDB_INCOMPATIBLE - the database was not opened with #MDB_COUNTED.
+	 *	<li>EINVAL - cursor is not initialized, or an invalid parameter was specified.
+	 * </ul>
+	 */
+int  mdb_cursor_rank(MDB_cursor *cursor, mdb_size_t *rankp);
+
+	/** @brief Position a cursor at the key with the given rank.
+	 *
+	 * This is the inverse of #mdb_cursor_rank(): the cursor is moved to
+	 * the key that has \b rank keys sorting before it, and that key and
+	 * its data are returned. This call is only valid on databases opened
+	 * with #MDB_COUNTED.
+	 * @param[in] cursor A cursor handle returned by #mdb_cursor_open()
+	 * @param[in] rank The zero-based position of the key
+	 * @param[out] key Address where the key will be stored, may be NULL
+	 * @param[out] data Address where the data will be stored, may be NULL
+	 * @return A non-zero error value on failure and 0 on success. Some possible
+	 * errors are:
+	 * <ul>
+	 *	<li>#MDB_NOTFOUND - \b rank is not less than the number of keys.
+	 *	<li>#MDB_INCOMPATIBLE - the database was not opened with #MDB_COUNTED.
+	 *	<li>EINVAL - an invalid parameter was specified.
+	 * </ul>
+	 */
+int  mdb_cursor_select(MDB_cursor *cursor, mdb_size_t rank, MDB_val *key, MDB_val *data);
+
+	/** @brief Estimate how far into its database the current key lies.
+	 *
+	 * The estimate is read from the pages the cursor already holds, by
+	 * assuming that every page below the root divides its part of the
+	 * key space evenly among its nodes. Only the root's children are
+	 * read, to weigh them by their size. The difference between
+	 * the fractions of two keys, times the number of entries, estimates
+	 * the number of keys between them.
+	 * @param[in] cursor A cursor handle returned by #mdb_cursor_open()
+	 * @param[out] fracp Address where the fraction, from 0.0 for the first
+	 * key up to 1.0 past the last key, will be stored
+	 * @return A non-zero error value on failure and 0 on success. Some possible
+	 * errors are:
+	 * <ul>
+	 *	<li>EINVAL - cursor is not initialized, or an invalid parameter was specified.
+	 * </ul>
+	 */
+int  mdb_cursor_fraction(MDB_cursor *cursor, double *fracp);
+
+	/** @brief Position a cursor at an estimated fraction of its database.
+	 *
+	 * This is the inverse of #mdb_cursor_fraction(): one root-to-leaf
+	 * descent finds the key whose estimated fraction is closest to
+	 * \b frac, without scanning. For #MDB_DUPSORT databases the cursor
+	 * is placed on the first data item of that key.
+	 * @param[in] cursor A cursor handle returned by #mdb_cursor_open()
+	 * @param[in] frac A fraction from 0.0 up to, but excluding, 1.0
+	 * @param[out] key Address where the key will be stored, may be NULL
+	 * @param[out] data Address where the data will be stored, may be NULL
+	 * @return A non-zero error value on failure and 0 on success. Some possible
+	 * errors are:
+	 * <ul>
+	 *	<li>#MDB_NOTFOUND - the database is empty, or \b frac is 1.0 or more.
+	 *	<li>EINVAL - an invalid parameter was specified.
+	 * </ul>
+	 */
+int  mdb_cursor_seek_fraction(MDB_cursor *cursor, double frac, MDB_val *key, MDB_val *data);
+
+	/** @brief Position a cursor at a randomly chosen data item.
+	 *
+	 * Like #mdb_cursor_seek_fraction(), but at every level of the tree the
+	 * children of the page on the path are weighed by how many nodes they
+	 * hold. Passing a uniformly distributed \b frac then picks keys close
+	 * to uniformly, even when pages are filled unevenly. This reads every
+	 * child of each page on the path. Databases opened with #MDB_COUNTED
+	 * can be sampled exactly with #mdb_cursor_select() instead.
+	 * @param[in] cursor A cursor handle returned by #mdb_cursor_open()
+	 * @param[in] frac A random number from 0.0 up to, but excluding, 1.0
+	 * @param[out] key Address where the key will be stored, may be NULL
+	 * @param[out] data Address where the data will be stored, may be NULL
+	 * @return A non-zero error value on failure and 0 on success. Some possible
+	 * errors are:
+	 * <ul>
+	 *	<li>#MDB_NOTFOUND - the database is empty, or \b frac is 1.0 or more.
+	 *	<li>EINVAL - an invalid parameter was specified.
+	 * </ul>
+	 */
+int  mdb_cursor_sample(MDB_cursor *cursor, double frac, MDB_val *key, MDB_val *data);
+
 	/** @brief Compare two data items according to a particular database.
 	 *
 	 * This returns a comparison as if the two data items were keys in the
@@ -0,0 +1,176 @@
+/*****************************************************************************\
+*  Copyright (c) 2023 Ricardo Machado, Sydney, Australia All rights reserved.
+*
+*  MIT License
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to
+*  deal in the Software without restriction, including without limitation the
+*  rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+*  sell copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in
+*  all copies or substantial portions of the Software.
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+*  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+*  IN THE SOFTWARE.
+*
+*  You should have received a copy of the MIT License along with this program.
+*  If not, see https://opensource.org/licenses/MIT.
+\*****************************************************************************/
+// Page fill and fragmentation report: walks every page of one snapshot of an
+// environment with analyzer_t and prints, for each store, its depth, how full
+// its branch and leaf pages are and the space lost on overflow pages, then the
+// size and contiguity of the freelist. Safe to run against a live environment.
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include "lmdbpp.h"
+
+using namespace lmdb;
+
+namespace {
+
+   struct options_t
+   {
+      std::string path;
+      unsigned int max_stores{ DEFAULT_MAXSTORES };
+      size_t threads{ std::max<size_t>(1, std::thread::hardware_concurrency()) };
+      bool histograms{ false };
+   };
+
+   void usage(const char* prog)
+   {
+      std::printf("usage: %s [options] path\n"
+         "  path       environment directory\n"
+         "  -m N       maximum number of stores (default %u)\n"
+         "  -j N       threads walking the stores (default: number of cores)\n"
+         "  -f         print the fill histogram of each store\n", prog, DEFAULT_MAXSTORES);
+   }
+
+   bool parse(int argc, char* argv[], options_t& opt)
+   {
+      for (int c; (c = getopt(argc, argv, "m:j:fh")) != -1;)
+      {
+         switch (c)
+         {
+            case 'm': opt.max_stores = (unsigned int)std::strtoul(optarg, nullptr, 10); break;
+            case 'j': opt.threads = (size_t)std::strtoul(optarg, nullptr, 10); break;
+            case 'f': opt.histograms = true; break;
+            default: return false;
+         }
+      }
+      if (optind != argc - 1)
+      {
+         return false;
+      }
+      opt.path = argv[optind];
+      return opt.max_stores > 0 && opt.threads > 0;
+   }
+
+   double mib(double pages, size_t page_size) noexcept
+   {
+      return pages * (double)page_size / (1024.0 * 1024.0);
+   }
+
+   void print_tree(const char* name, const page_stats_t& stats)
+   {
+      std::printf("%-24s %12zu %5zu %9zu %6.1f %9zu %6.1f %9zu %5zu %9zu %10.2f\n",
+         name, stats.entries, stats.depth, stats.branch_pages, 100.0 * stats.branch_fill_factor(),
+         stats.leaf_pages, 100.0 * stats.leaf_fill_factor(), stats.dup_pages, stats.dup_depth, stats.overflow_pages,
+         stats.overflow_waste / (1024.0 * 1024.0));
+   }
+
+   void print_fill(const char* name, const char* kind, const std::array<size_t, page_stats_t::FILL_BUCKETS>& fill)
+   {
+      std::printf("%-24s %-6s", name, kind);
+      for (size_t count : fill)
+      {
+         std::printf(" %8zu", count);
+      }
+      std::printf("\n");
+   }
+
+   void report(const options_t& opt, const analysis_t& analysis)
+   {
+      page_stats_t total = analysis.total();
+      const freelist_stats_t& freelist = analysis.freelist;
+      std::printf("snapshot %zu, %zu byte pages, %zu pages in the file (%.1f MiB)\n\n",
+         analysis.snapshot, analysis.page_size, analysis.file_pages, mib((double)analysis.file_pages, analysis.page_size));
+      std::printf("%-24s %12s %5s %9s %6s %9s %6s %9s %5s %9s %10s\n",
+         "store", "entries", "depth", "branch", "fill%", "leaf", "fill%", "dup", "depth", "overflow", "waste MiB");
+      for (const page_stats_t& store : analysis.stores)
+      {
+         print_tree(store.name.c_str(), store);
+      }
+      print_tree("<main>", analysis.main);
+      print_tree("<freelist>", analysis.freelist_tree);
+      print_tree("<total>", total);
+      if (opt.histograms)
+      {
+         std::printf("\npages by fill, in steps of %zu%%\n", 100 / page_stats_t::FILL_BUCKETS);
+         for (const page_stats_t& store : analysis.stores)
+         {
+            print_fill(store.name.c_str(), "branch", store.branch_fill);
+            print_fill(store.name.c_str(), "leaf", store.leaf_fill);
+         }
+      }
+      std::printf("\nfree pages %zu (%.1f%% of the file, %.1f MiB) in %zu records, %zu runs, longest %zu\n",
+         freelist.pages, analysis.file_pages ? 100.0 * freelist.pages / analysis.file_pages : 0.0,
+         mib((double)freelist.pages, analysis.page_size), freelist.records, freelist.runs, freelist.longest_run);
+      std::printf("runs by length:");
+      for (size_t i = 0; i < freelist_stats_t::RUN_BUCKETS; ++i)
+      {
+         if (freelist.run_lengths[i])
+         {
+            std::printf(" %zu%s: %zu", size_t(1) << i, i + 1 == freelist_stats_t::RUN_BUCKETS ? "+" : "", freelist.run_lengths[i]);
+         }
+      }
+      std::printf("\na compacting copy would take about %zu pages (%.1f MiB)\n",
+         analysis.file_pages - freelist.pages, mib((double)(analysis.file_pages - freelist.pages), analysis.page_size));
+   }
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+   options_t opt;
+   if (!parse(argc, argv, opt))
+   {
+      usage(argv[0]);
+      return 1;
+   }
+   // initialize() would create an empty environment
+   if (!std::filesystem::exists(std::filesystem::path(opt.path) / "data.mdb"))
+   {
+      std::printf("no environment in %s\n", opt.path.c_str());
+      return 1;
+   }
+   database_t env;
+   if (status_t status = env.initialize(opt.path, opt.max_stores); status.nok())
+   {
+      std::printf("cannot open %s: %s\n", opt.path.c_str(), status.message().c_str());
+      return 1;
+   }
+   analyzer_t analyzer(env);
+   analysis_t analysis;
+   analyze_options_t options;
+   options.threads = opt.threads;
+   if (status_t status = analyzer.run(analysis, options); status.nok())
+   {
+      std::printf("cannot analyze %s: %s\n", opt.path.c_str(), status.message().c_str());
+      return 1;
+   }
+   report(opt, analysis);
+   return 0;
+}
@@ -0,0 +1,701 @@
+/*****************************************************************************\
+*  Copyright (c) 2023 Ricardo Machado, Sydney, Australia All rights reserved.
+*
+*  MIT License
+*
+*  Permission is hereby granted, free of charge, to any person obtaining a copy
+*  of this software and associated documentation files (the "Software"), to
+*  deal in the Software without restriction, including without limitation the
+*  rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+*  sell copies of the Software, and to permit persons to whom the Software is
+*  furnished to do so, subject to the following conditions:
+*
+*  The above copyright notice and this permission notice shall be included in
+*  all copies or substantial portions of the Software.
+*
+*  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+*  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+*  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+*  IN THE SOFTWARE.
+*
+*  You should have received a copy of the MIT License along with this program.
+*  If not, see https://opensource.org/licenses/MIT.
+\*****************************************************************************/
+// Multi-process concurrency benchmark: forks reader processes and runs writer
+// threads against one environment, for reader counts 1..N, and prints a
+// scaling report. POSIX only, as it relies on fork(). With -t it instead
+// measures the cost of short transactions as the number of stores grows, and
+// with -x the writer lock handoff between threads running short write txns.
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "lmdbpp.h"
+
+using namespace lmdb;
+using bench_clock = std::chrono::steady_clock;
+
+namespace {
+
+   struct options_t
+   {
+      std::string path{ "./lmdbpp-bench" };
+      unsigned int readers{ std::thread::hardware_concurrency() };
+      unsigned int writers{ 1 };
+      unsigned int max_readers{ 0 };
+      unsigned int keys{ 100000 };
+      unsigned int value_size{ 100 };
+      unsigned int batch{ 100 };
+      double seconds{ 2.0 };
+      bool linear{ false };
+      unsigned int stores{ 0 };
+      unsigned int spin{ 0 };
+   };
+
+   // what each reader process sends back through its pipe
+   struct reader_result_t
+   {
+      uint64_t reads{ 0 };
+      uint64_t txns{ 0 };
+      uint64_t begin_ns{ 0 };
+      uint64_t begin_max_ns{ 0 };
+      uint64_t readers_full{ 0 };
+      uint64_t errors{ 0 };
+   };
+
+   struct writer_result_t
+   {
+      uint64_t commits{ 0 };
+      uint64_t wait_ns{ 0 };
+      uint64_t wait_max_ns{ 0 };
+      uint64_t errors{ 0 };
+   };
+
+   uint64_t elapsed_ns(bench_clock::time_point start) noexcept
+   {
+      return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(bench_clock::now() - start).count();
+   }
+
+   std::string make_key(unsigned int n)
+   {
+      char buf[16];
+      std::snprintf(buf, sizeof(buf), "k%08u", n);
+      return buf;
+   }
+
+   void usage(const char* prog)
+   {
+      std::printf("usage: %s [options]\n"
+         "  -p path    environment directory (default ./lmdbpp-bench)\n"
+         "  -r N       maximum number of reader processes (default: number of cores)\n"
+         "  -w M       number of writer threads (default 1, 0 for none)\n"
+         "  -m N       size of the reader table (default: readers + writers + 1)\n"
+         "  -k K       number of keys (default 100000)\n"
+         "  -v B       value size in bytes (default 100)\n"
+         "  -b B       reads per read transaction (default 100)\n"
+         "  -s S       seconds per step (default 2)\n"
+         "  -l         step reader counts by one, not by doubling\n"
+         "  -t N       time short transactions with 1, 10, 100, ... up to N stores\n"
+         "  -x S       time writer lock handoffs between 1, 2, 4, ... -w writer threads,\n"
+         "             sleeping on the lock and spinning up to S times first\n", prog);
+   }
+
+   bool parse(int argc, char* argv[], options_t& opt)
+   {
+      for (int c; (c = getopt(argc, argv, "p:r:w:m:k:v:b:s:lt:x:h")) != -1;)
+      {
+         switch (c)
+         {
+            case 'p': opt.path = optarg; break;
+            case 'r': opt.readers = (unsigned int)std::strtoul(optarg, nullptr, 10); break;
+            case 'w': opt.writers = (unsigned int)std::strtoul(optarg, nullptr, 10); break;
+            case 'm': opt.max_readers = (unsigned int)std::strtoul(optarg, nullptr, 10); break;
+            case 'k': opt.keys = (unsigned int)std::strtoul(optarg, nullptr, 10); break;
+            case 'v': opt.value_size = (unsigned int)std::strtoul(optarg, nullptr, 10); break;
+            case 'b': opt.batch = (unsigned int)std::strtoul(optarg, nullptr, 10); break;
+            case 's': opt.seconds = std::strtod(optarg, nullptr); break;
+            case 'l': opt.linear = true; break;
+            case 't': opt.stores = (unsigned int)std::strtoul(optarg, nullptr, 10); break;
+            case 'x': opt.spin = (unsigned int)std::strtoul(optarg, nullptr, 10); break;
+            default: return false;
+         }
+      }
+      if (opt.readers == 0)
+      {
+         opt.readers = 1;
+      }
+      if (opt.max_readers == 0)
+      {
+         opt.max_readers = opt.readers + opt.writers + 1;
+      }
+      return opt.keys > 0 && opt.batch > 0 && opt.seconds > 0;
+   }
+
+   size_t mmap_size(const options_t& opt) noexcept
+   {
+      // room for the data set, the pages writers keep dirtying, and some slack
+      size_t size = (size_t)opt.keys * (opt.value_size + 64) * 4;
+      return size < DEFAULT_MMAPSIZE ? DEFAULT_MMAPSIZE : size;
+   }
+
+   // the main process creates the store, readers only open it
+   status_t open_env(const options_t& opt, database_t& env, store_t& store, bool create)
+   {
+      status_t status;
+      if (status = env.initialize(opt.path, DEFAULT_MAXSTORES, mmap_size(opt), opt.max_readers); status.nok())
+      {
+         return status;
+      }
+      transaction_t txn(env);
+      if (status = txn.begin(create ? transaction_type_t::read_write : transaction_type_t::read_only); status.nok())
+      {
+         return status;
+      }
+      if (status = create ? store.create(txn, "bench") : store.open(txn, "bench"); status.nok())
+      {
+         return status;
+      }
+      return txn.commit();
+   }
+
+   status_t populate(const options_t& opt, database_t& env, store_t& store)
+   {
+      status_t status;
+      transaction_t txn(env);
+      std::string value(opt.value_size, 'v');
+      if (status = txn.begin(transaction_type_t::read_write); status.nok())
+      {
+         return status;
+      }
+      for (unsigned int i = 0; i < opt.keys && status.ok(); ++i)
+      {
+         status = store.put(txn, make_key(i), value);
+      }
+      return status.ok() ? txn.commit() : status;
+   }
+
+   // body of a forked reader process. Opens its own environment, as an
+   // environment must not be used across fork(), then waits for the start signal
+   reader_result_t reader(const options_t& opt, int start_fd, unsigned int seed)
+   {
+      reader_result_t result;
+      database_t env;
+      store_t store(env);
+      if (open_env(opt, env, store, false).nok())
+      {
+         result.errors++;
+         return result;
+      }
+      char go;
+      if (read(start_fd, &go, 1) != 1)
+      {
+         result.errors++;
+         return result;
+      }
+      std::mt19937 rng(seed);
+      std::uniform_int_distribution<unsigned int> pick(0, opt.keys - 1);
+      std::string key, k, v;
+      auto deadline = bench_clock::now() + std::chrono::duration<double>(opt.seconds);
+      while (bench_clock::now() < deadline)
+      {
+         transaction_t txn(env);
+         auto start = bench_clock::now();
+         status_t status = txn.begin(transaction_type_t::read_only);
+         uint64_t ns = elapsed_ns(start);
+         if (status.nok())
+         {
+            status.error() == MDB_READERS_FULL ? result.readers_full++ : result.errors++;
+            std::this_thread::yield();
+            continue;
+         }
+         result.txns++;
+         result.begin_ns += ns;
+         result.begin_max_ns = ns > result.begin_max_ns ? ns : result.begin_max_ns;
+         for (unsigned int i = 0; i < opt.batch; ++i)
+         {
+            key = make_key(pick(rng));
+            if (store.get(txn, key, k, v).ok())
+            {
+               result.reads++;
+            }
+            else
+            {
+               result.errors++;
+            }
+         }
+         txn.abort();
+      }
+      return result;
+   }
+
+   void writer(const options_t& opt, database_t& env, store_t& store, std::atomic<bool>& stop, unsigned int seed, writer_result_t& result)
+   {
+      std::mt19937 rng(seed);
+      std::uniform_int_distribution<unsigned int> pick(0, opt.keys - 1);
+      std::string value(opt.value_size, 'w');
+      while (!stop.load(std::memory_order_relaxed))
+      {
+         transaction_t txn(env);
+         auto start = bench_clock::now();
+         status_t status = txn.begin(transaction_type_t::read_write);
+         uint64_t ns = elapsed_ns(start);
+         if (status.nok())
+         {
+            result.errors++;
+            continue;
+         }
+         result.wait_ns += ns;
+         result.wait_max_ns = ns > result.wait_max_ns ? ns : result.wait_max_ns;
+         for (unsigned int i = 0; i < 10 && status.ok(); ++i)
+         {
+            status = store.put(txn, make_key(pick(rng)), value);
+         }
+         if (status.ok() && txn.commit().ok())
+         {
+            result.commits++;
+         }
+         else
+         {
+            result.errors++;
+         }
+      }
+   }
+
+   struct step_t
+   {
+      unsigned int readers{ 0 };
+      reader_result_t read;
+      writer_result_t write;
+      unsigned int slots_used{ 0 };
+   };
+
+   // run one step with n reader processes and the configured writer threads
+   bool run_step(const options_t& opt, database_t& env, store_t& store, unsigned int n, step_t& step)
+   {
+      int start_pipe[2];
+      std::vector<int> result_fds;
+      std::vector<pid_t> children;
+      if (pipe(start_pipe) != 0)
+      {
+         std::perror("pipe");
+         return false;
+      }
+      // fork before any writer thread exists, so children inherit no held locks
+      std::fflush(stdout);
+      for (unsigned int i = 0; i < n; ++i)
+      {
+         int result_pipe[2];
+         if (pipe(result_pipe) != 0)
+         {
+            std::perror("pipe");
+            return false;
+         }
+         pid_t pid = fork();
+         if (pid < 0)
+         {
+            std::perror("fork");
+            return false;
+         }
+         if (pid == 0)
+         {
+            close(start_pipe[1]);
+            close(result_pipe[0]);
+            reader_result_t result = reader(opt, start_pipe[0], 1000 * n + i);
+            ssize_t written = write(result_pipe[1], &result, sizeof(result));
+            _exit(written == (ssize_t)sizeof(result) ? 0 : 1);
+         }
+         close(result_pipe[1]);
+         result_fds.push_back(result_pipe[0]);
+         children.push_back(pid);
+      }
+      close(start_pipe[0]);
+
+      std::atomic<bool> stop{ false };
+      std::vector<writer_result_t> writes(opt.writers);
+      std::vector<std::thread> threads;
+      for (unsigned int i = 0; i < opt.writers; ++i)
+      {
+         threads.emplace_back(writer, std::cref(opt), std::ref(env), std::ref(store), std::ref(stop), 7919 * n + i, std::ref(writes[i]));
+      }
+      // children open their environment before reading the start byte, so
+      // the step starts once all of them are ready
+      std::vector<char> go(n, 'g');
+      if (n && write(start_pipe[1], go.data(), n) != (ssize_t)n)
+      {
+         std::perror("write");
+      }
+      close(start_pipe[1]);
+
+      step = step_t();
+      step.readers = n;
+      for (unsigned int i = 0; i < n; ++i)
+      {
+         reader_result_t r;
+         if (read(result_fds[i], &r, sizeof(r)) != (ssize_t)sizeof(r))
+         {
+            r.errors++;
+         }
+         close(result_fds[i]);
+         step.read.reads += r.reads;
+         step.read.txns += r.txns;
+         step.read.begin_ns += r.begin_ns;
+         step.read.begin_max_ns = r.begin_max_ns > step.read.begin_max_ns ? r.begin_max_ns : step.read.begin_max_ns;
+         step.read.readers_full += r.readers_full;
+         step.read.errors += r.errors;
+      }
+      MDB_envinfo info;
+      if (mdb_env_info(env.handle(), &info) == MDB_SUCCESS)
+      {
+         step.slots_used = info.me_numreaders;
+      }
+      stop = true;
+      for (auto& t : threads)
+      {
+         t.join();
+      }
+      for (const auto& w : writes)
+      {
+         step.write.commits += w.commits;
+         step.write.wait_ns += w.wait_ns;
+         step.write.wait_max_ns = w.wait_max_ns > step.write.wait_max_ns ? w.wait_max_ns : step.write.wait_max_ns;
+         step.write.errors += w.errors;
+      }
+      for (pid_t pid : children)
+      {
+         int wstatus;
+         waitpid(pid, &wstatus, 0);
+      }
+      // reclaim the slots of the exited readers for the next step
+      env.check();
+      return true;
+   }
+
+   // 1, 2, 4, ... and always the maximum, or every count with -l
+   unsigned int next_step(const options_t& opt, unsigned int n) noexcept
+   {
+      if (opt.linear || n == opt.readers)
+      {
+         return n + 1;
+      }
+      return n * 2 > opt.readers ? opt.readers : n * 2;
+   }
+
+   struct txn_step_t
+   {
+      unsigned int stores{ 0 };
+      uint64_t reads{ 0 };
+      uint64_t read_ns{ 0 };
+      uint64_t writes{ 0 };
+      uint64_t write_ns{ 0 };
+      uint64_t errors{ 0 };
+   };
+
+   std::string make_store_name(unsigned int n)
+   {
+      char buf[16];
+      std::snprintf(buf, sizeof(buf), "s%07u", n);
+      return buf;
+   }
+
+   // time read txns that begin, read one key and abort, then write txns that
+   // begin, put one key and commit, each touching one store of the first n
+   bool run_txn_step(const options_t& opt, database_t& env, std::vector<store_t>& stores, unsigned int n, txn_step_t& step)
+   {
+      status_t status;
+      transaction_t create(env);
+      if (status = create.begin(transaction_type_t::read_write); status.nok())
+      {
+         std::printf("cannot begin: %s\n", status.message().c_str());
+         return false;
+      }
+      for (unsigned int i = (unsigned int)stores.size(); i < n && status.ok(); ++i)
+      {
+         stores.emplace_back(env);
+         if (status = stores.back().create(create, make_store_name(i)); status.ok())
+         {
+            status = stores.back().put(create, make_key(0), std::string(opt.value_size, 'v'));
+         }
+      }
+      if (status.nok() || (status = create.commit()).nok())
+      {
+         std::printf("cannot create stores: %s\n", status.message().c_str());
+         return false;
+      }
+      step = txn_step_t();
+      step.stores = n;
+      std::mt19937 rng(n);
+      std::uniform_int_distribution<unsigned int> pick(0, n - 1);
+      std::string k, v, value(opt.value_size, 'w');
+      auto phase = std::chrono::duration<double>(opt.seconds / 2);
+      auto start = bench_clock::now();
+      for (auto deadline = start + phase; bench_clock::now() < deadline; ++step.reads)
+      {
+         transaction_t txn(env);
+         if (txn.begin(transaction_type_t::read_only).nok() || stores[pick(rng)].get(txn, make_key(0), k, v).nok())
+         {
+            step.errors++;
+         }
+         txn.abort();
+      }
+      step.read_ns = elapsed_ns(start);
+      // leave the disk out of it, this is about the txn bookkeeping
+      mdb_env_set_flags(env.handle(), MDB_NOSYNC, 1);
+      start = bench_clock::now();
+      for (auto deadline = start + phase; bench_clock::now() < deadline; ++step.writes)
+      {
+         transaction_t txn(env);
+         if (txn.begin(transaction_type_t::read_write).nok() || stores[pick(rng)].put(txn, make_key(0), value).nok() || txn.commit().nok())
+         {
+            step.errors++;
+         }
+      }
+      step.write_ns = elapsed_ns(start);
+      mdb_env_set_flags(env.handle(), MDB_NOSYNC, 0);
+      return true;
+   }
+
+   // 1, 10, 100, ... and always the maximum
+   unsigned int next_txn_step(const options_t& opt, unsigned int n) noexcept
+   {
+      if (n == opt.stores)
+      {
+         return n + 1;
+      }
+      return n * 10 > opt.stores ? opt.stores : n * 10;
+   }
+
+   void report_txn(const options_t& opt, const std::vector<txn_step_t>& steps)
+   {
+      std::printf("\n%u byte values, %.1fs per step\n\n", opt.value_size, opt.seconds);
+      std::printf("%8s %13s %11s %13s %11s %6s\n", "stores", "reads/s", "read avg", "writes/s", "write avg", "errors");
+      for (const auto& s : steps)
+      {
+         std::printf("%8u %13.0f %9.2fus %13.0f %9.2fus %6llu\n",
+            s.stores, s.reads * 1e9 / s.read_ns, s.reads ? s.read_ns / 1000.0 / s.reads : 0.0,
+            s.writes * 1e9 / s.write_ns, s.writes ? s.write_ns / 1000.0 / s.writes : 0.0,
+            (unsigned long long)s.errors);
+      }
+      std::printf("\nread: begin a read-only txn, get one key from a random store, abort\n"
+         "write: begin a read-write txn, put one key into a random store, commit without sync\n");
+   }
+
+   int run_txn(const options_t& opt)
+   {
+      database_t env;
+      if (status_t status = env.initialize(opt.path, opt.stores, mmap_size(opt), opt.max_readers); status.nok())
+      {
+         std::printf("cannot open %s: %s\n", opt.path.c_str(), status.message().c_str());
+         return 1;
+      }
+      std::vector<store_t> stores;
+      std::vector<txn_step_t> steps;
+      for (unsigned int n = 1; n <= opt.stores; n = next_txn_step(opt, n))
+      {
+         txn_step_t step;
+         std::printf("running with %u store(s)...\n", n);
+         if (!run_txn_step(opt, env, stores, n, step))
+         {
+            return 1;
+         }
+         steps.push_back(step);
+      }
+      report_txn(opt, steps);
+      return 0;
+   }
+
+   struct handoff_result_t
+   {
+      uint64_t commits{ 0 };
+      uint64_t handoffs{ 0 };
+      uint64_t handoff_ns{ 0 };
+      uint64_t handoff_max_ns{ 0 };
+      uint64_t errors{ 0 };
+   };
+
+   struct handoff_step_t
+   {
+      unsigned int writers{ 0 };
+      unsigned int spin{ 0 };
+      handoff_result_t result;
+   };
+
+   // run write txns of one put each. When a writer had to wait for the lock, the time from
+   // the previous writer's commit to this writer's begin returning is a handoff
+   void handoff_writer(const options_t& opt, database_t& env, store_t& store, std::atomic<bool>& stop,
+      std::atomic<uint64_t>& released, bench_clock::time_point epoch, unsigned int seed, handoff_result_t& result)
+   {
+      std::mt19937 rng(seed);
+      std::uniform_int_distribution<unsigned int> pick(0, opt.keys - 1);
+      std::string value(opt.value_size, 'x');
+      while (!stop.load(std::memory_order_relaxed))
+      {
+         transaction_t txn(env);
+         uint64_t start = elapsed_ns(epoch);
+         if (txn.begin(transaction_type_t::read_write).nok())
+         {
+            result.errors++;
+            continue;
+         }
+         uint64_t acquired = elapsed_ns(epoch);
+         uint64_t previous = released.load(std::memory_order_acquire);
+         if (previous > start)
+         {
+            // the lock is released inside commit, before the previous writer notes the time
+            uint64_t ns = acquired > previous ? acquired - previous : 0;
+            result.handoffs++;
+            result.handoff_ns += ns;
+            result.handoff_max_ns = ns > result.handoff_max_ns ? ns : result.handoff_max_ns;
+         }
+         if (store.put(txn, make_key(pick(rng)), value).nok() || txn.commit().nok())
+         {
+            result.errors++;
+            continue;
+         }
+         released.store(elapsed_ns(epoch), std::memory_order_release);
+         result.commits++;
+      }
+   }
+
+   handoff_step_t run_handoff_step(const options_t& opt, database_t& env, store_t& store, unsigned int writers, unsigned int spin)
+   {
+      handoff_step_t step;
+      step.writers = writers;
+      step.spin = spin;
+      env.set_writer_spin(spin);
+      std::atomic<bool> stop{ false };
+      std::atomic<uint64_t> released{ 0 };
+      std::vector<handoff_result_t> results(writers);
+      std::vector<std::thread> threads;
+      auto epoch = bench_clock::now();
+      for (unsigned int i = 0; i < writers; ++i)
+      {
+         threads.emplace_back(handoff_writer, std::cref(opt), std::ref(env), std::ref(store), std::ref(stop),
+            std::ref(released), epoch, 104729 * writers + i, std::ref(results[i]));
+      }
+      std::this_thread::sleep_for(std::chrono::duration<double>(opt.seconds));
+      stop = true;
+      for (unsigned int i = 0; i < writers; ++i)
+      {
+         threads[i].join();
+         step.result.commits += results[i].commits;
+         step.result.handoffs += results[i].handoffs;
+         step.result.handoff_ns += results[i].handoff_ns;
+         step.result.handoff_max_ns = results[i].handoff_max_ns > step.result.handoff_max_ns ? results[i].handoff_max_ns : step.result.handoff_max_ns;
+         step.result.errors += results[i].errors;
+      }
+      env.set_writer_spin(0);
+      return step;
+   }
+
+   int run_handoff(const options_t& opt, database_t& env, store_t& store)
+   {
+      std::vector<handoff_step_t> steps;
+      // leave the disk out of it, this is about the lock
+      mdb_env_set_flags(env.handle(), MDB_NOSYNC, 1);
+      for (unsigned int n = 1; n <= opt.writers; n = n == opt.writers ? n + 1 : (n * 2 > opt.writers ? opt.writers : n * 2))
+      {
+         std::printf("running with %u writer thread(s)...\n", n);
+         steps.push_back(run_handoff_step(opt, env, store, n, 0));
+         steps.push_back(run_handoff_step(opt, env, store, n, opt.spin));
+      }
+      mdb_env_set_flags(env.handle(), MDB_NOSYNC, 0);
+      std::printf("\n%u keys, %u byte values, %.1fs per step\n\n", opt.keys, opt.value_size, opt.seconds);
+      std::printf("%7s %6s %11s %10s %12s %12s %6s\n", "writers", "spin", "commits/s", "handoffs", "handoff avg", "handoff max", "errors");
+      for (const auto& s : steps)
+      {
+         std::printf("%7u %6u %11.0f %10llu %10.2fus %10.2fus %6llu\n",
+            s.writers, s.spin, s.result.commits / opt.seconds, (unsigned long long)s.result.handoffs,
+            s.result.handoffs ? s.result.handoff_ns / 1000.0 / s.result.handoffs : 0.0, s.result.handoff_max_ns / 1000.0,
+            (unsigned long long)s.result.errors);
+      }
+      std::printf("\nhandoff: from a commit to the begin of a writer that was waiting for the lock\n"
+         "spin: most tries on the writer lock before sleeping, see database_t::set_writer_spin()\n");
+      return 0;
+   }
+
+   void report(const options_t& opt, const std::vector<step_t>& steps)
+   {
+      std::printf("\n%u keys, %u byte values, %u reads per txn, %u writer thread(s), %u reader slots, %.1fs per step\n\n",
+         opt.keys, opt.value_size, opt.batch, opt.writers, opt.max_readers, opt.seconds);
+      std::printf("%7s %13s %8s %6s %11s %11s %6s %6s %10s %11s %11s %6s\n",
+         "readers", "reads/s", "speedup", "eff%", "begin avg", "begin max", "full", "slots",
+         "commits/s", "wait avg", "wait max", "errors");
+      double base = 0.0;
+      for (const auto& s : steps)
+      {
+         double reads = s.read.reads / opt.seconds;
+         if (base == 0.0)
+         {
+            base = reads / s.readers;
+         }
+         double speedup = base > 0.0 ? reads / base : 0.0;
+         std::printf("%7u %13.0f %8.2f %6.1f %9.2fus %9.2fus %6llu %6u %10.1f %9.2fus %9.2fus %6llu\n",
+            s.readers, reads, speedup, 100.0 * speedup / s.readers,
+            s.read.txns ? s.read.begin_ns / 1000.0 / s.read.txns : 0.0, s.read.begin_max_ns / 1000.0,
+            (unsigned long long)s.read.readers_full, s.slots_used,
+            s.write.commits / opt.seconds,
+            s.write.commits ? s.write.wait_ns / 1000.0 / s.write.commits : 0.0, s.write.wait_max_ns / 1000.0,
+            (unsigned long long)(s.read.errors + s.write.errors));
+      }
+      std::printf("\nbegin: time to start a read txn, which includes taking a reader slot\n"
+         "full: read txns refused with MDB_READERS_FULL\n"
+         "slots: highest number of reader table entries in use so far\n"
+         "wait: time a writer waits in txn begin for the writer lock\n");
+   }
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+   options_t opt;
+   if (!parse(argc, argv, opt))
+   {
+      usage(argv[0]);
+      return 1;
+   }
+   mkdir(opt.path.c_str(), 0755);
+   if (opt.stores)
+   {
+      return run_txn(opt);
+   }
+   database_t env;
+   store_t store(env);
+   if (status_t status = open_env(opt, env, store, true); status.nok())
+   {
+      std::printf("cannot open %s: %s\n", opt.path.c_str(), status.message().c_str());
+      return 1;
+   }
+   if (status_t status = populate(opt, env, store); status.nok())
+   {
+      std::printf("cannot populate %s: %s\n", opt.path.c_str(), status.message().c_str());
+      return 1;
+   }
+   if (opt.spin)
+   {
+      return run_handoff(opt, env, store);
+   }
+   std::vector<step_t> steps;
+   for (unsigned int n = 1; n <= opt.readers; n = next_step(opt, n))
+   {
+      step_t step;
+      std::printf("running with %u reader process(es)...\n", n);
+      if (!run_step(opt, env, store, n, step))
+      {
+         return 1;
+      }
+      steps.push_back(step);
+   }
+   report(opt, steps);
+   return 0;
+}
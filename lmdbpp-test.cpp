@@ -26,6 +26,14 @@
 \*****************************************************************************/
 #define CATCH_CONFIG_MAIN
 #include <catch.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <filesystem>
+#include <iterator>
+#include <map>
+#include <random>
+#include <set>
 #include <vector>
 #include "lmdbpp.h"
 
@@ -96,6 +104,367 @@ TEST_CASE("lmdbpp.h environment_t class tests", "[environment_t]")
       REQUIRE(env.handle() != nullptr);
       REQUIRE(env.flush().ok());
    }
+   SECTION("test environment_t set_writer_spin() method")
+   {
+      std::string path(".\\");
+      database_t env;
+      REQUIRE(env.initialize(path).ok());
+      REQUIRE(env.set_writer_spin(1000).ok());
+      store_t tb(env);
+      transaction_t txn(env);
+      REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+      REQUIRE(tb.create(txn, "writer-spin.dbm").ok());
+      REQUIRE(txn.commit().ok());
+      std::atomic<int> failed{ 0 };
+      std::vector<std::thread> writers;
+      for (int t = 0; t < 4; ++t)
+      {
+         writers.emplace_back([&, t]()
+         {
+            for (int i = 0; i < 100; ++i)
+            {
+               transaction_t wtxn(env);
+               if (wtxn.begin(transaction_type_t::read_write).nok() ||
+                  tb.put(wtxn, std::to_string(t * 1000 + i), "value").nok() || wtxn.commit().nok())
+               {
+                  failed++;
+               }
+            }
+         });
+      }
+      for (auto& w : writers)
+      {
+         w.join();
+      }
+      REQUIRE(failed == 0);
+      REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+      REQUIRE(tb.entries(txn) == 400);
+      REQUIRE(tb.drop(txn).ok());
+      REQUIRE(txn.commit().ok());
+      REQUIRE(env.set_writer_spin(0).ok());
+   }
+}
+
+TEST_CASE("lmdbpp.h database_t periodic sync tests", "[database_t]")
+{
+   using namespace std::chrono_literals;
+   std::string path(".\\");
+   database_t env;
+   REQUIRE(env.initialize(path).ok());
+   transaction_t txn(env);
+   store_t tb(env);
+   REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+   REQUIRE(tb.create(txn, "sync.dbm").ok());
+   REQUIRE(txn.commit().ok());
+
+   SECTION("Test database_t wait_durable() method after the interval")
+   {
+      REQUIRE(env.start_periodic_sync(20ms).ok());
+      REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+      REQUIRE(tb.put(txn, "key", "value").ok());
+      size_t id = txn.id();
+      REQUIRE(txn.commit().ok());
+      REQUIRE(env.wait_durable(id, 10s).ok());
+      REQUIRE(env.durable_txnid() >= id);
+   }
+   SECTION("Test database_t wait_durable() method after enough bytes")
+   {
+      REQUIRE(env.start_periodic_sync(1h, 1).ok());
+      REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+      REQUIRE(tb.put(txn, "key", "value").ok());
+      size_t id = txn.id();
+      REQUIRE(txn.commit().ok());
+      REQUIRE(env.wait_durable(id, 10s).ok());
+   }
+   SECTION("Test database_t start_periodic_sync() method with an empty interval")
+   {
+      REQUIRE(env.start_periodic_sync(0ms).error() == EINVAL);
+      REQUIRE(env.start_periodic_sync(-1ms, 1).error() == EINVAL);
+      REQUIRE(env.start_periodic_sync(1h).ok());
+      REQUIRE(env.start_periodic_sync(0ms).error() == EINVAL);
+      // the running sync is kept
+      REQUIRE(env.durable_txnid() > 0);
+      REQUIRE(env.stop_periodic_sync().ok());
+      REQUIRE(env.stop_periodic_sync().error() == MDB_SYNC_NOT_STARTED);
+   }
+   SECTION("Test database_t wait_durable() method timing out")
+   {
+      REQUIRE(env.start_periodic_sync(1h).ok());
+      REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+      REQUIRE(tb.put(txn, "key", "value").ok());
+      size_t id = txn.id();
+      REQUIRE(txn.commit().ok());
+      REQUIRE(env.durable_txnid() < id);
+      REQUIRE(env.wait_durable(id, 10ms).error() == MDB_SYNC_TIMEOUT);
+      REQUIRE(env.stop_periodic_sync().ok());
+      REQUIRE(env.wait_durable(id, 10ms).error() == MDB_SYNC_NOT_STARTED);
+   }
+   REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+   REQUIRE(tb.drop(txn).ok());
+   REQUIRE(txn.commit().ok());
+}
+
+TEST_CASE("lmdbpp.h database_t trace tests", "[database_t]")
+{
+   using namespace std::chrono_literals;
+   std::string path(".\\");
+   database_t env;
+   REQUIRE(env.initialize(path).ok());
+   transaction_t txn(env);
+   store_t tb(env);
+   REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+   REQUIRE(tb.create(txn, "trace.dbm").ok());
+   REQUIRE(txn.commit().ok());
+   auto read_file = [](const std::string& name)
+   {
+      std::ifstream in(name, std::ios::binary);
+      return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+   };
+   auto occurrences = [](const std::string& text, const std::string& what)
+   {
+      size_t n{ 0 };
+      for (size_t pos = text.find(what); pos != std::string::npos; pos = text.find(what, pos + 1))
+      {
+         ++n;
+      }
+      return n;
+   };
+
+   SECTION("Test database_t start_trace() and write_trace() methods")
+   {
+      REQUIRE(env.write_trace("trace.json").error() == MDB_TRACE_NOT_STARTED);
+      trace_options_t options;
+      options.min_scan = 0us;
+      REQUIRE(env.start_trace(options).ok());
+      std::atomic<int> failed{ 0 };
+      std::vector<std::thread> writers;
+      for (int t = 0; t < 2; ++t)
+      {
+         writers.emplace_back([&, t]()
+         {
+            for (int i = 0; i < 5; ++i)
+            {
+               transaction_t wtxn(env);
+               if (wtxn.begin(transaction_type_t::read_write).nok() ||
+                  tb.put(wtxn, "key-" + std::to_string(t * 10 + i), "value").nok() || wtxn.commit().nok())
+               {
+                  failed++;
+               }
+            }
+         });
+      }
+      for (std::thread& writer : writers)
+      {
+         writer.join();
+      }
+      REQUIRE(failed == 0);
+      REQUIRE(txn.begin(transaction_type_t::read_only).ok());
+      size_t keys{ 0 };
+      REQUIRE(tb.scan_prefix(txn, "key-", [&](std::string_view, std::string_view) { ++keys; }).ok());
+      REQUIRE(keys == 10);
+      txn.abort();
+      REQUIRE(env.stop_trace().ok());
+      // nothing is recorded once stopped
+      REQUIRE(txn.begin(transaction_type_t::read_only).ok());
+      txn.abort();
+      REQUIRE(env.write_trace("trace.json").ok());
+      std::string trace = read_file("trace.json");
+      REQUIRE(trace.starts_with("{\"displayTimeUnit\":\"ns\",\"traceEvents\":["));
+      REQUIRE(trace.ends_with("]}\n"));
+      REQUIRE(occurrences(trace, "\"name\":\"thread_name\"") == 3);
+      REQUIRE(occurrences(trace, "\"name\":\"writer lock\"") == 10);
+      REQUIRE(occurrences(trace, "\"name\":\"write txn\"") == 10);
+      REQUIRE(occurrences(trace, "\"name\":\"commit\"") == 10);
+      REQUIRE(occurrences(trace, "\"name\":\"flush pages\"") == 10);
+      REQUIRE(occurrences(trace, "\"name\":\"read txn\"") == 1);
+      REQUIRE(occurrences(trace, "\"name\":\"scan\",\"cat\":\"lmdb\",\"ph\":\"X\",\"pid\":1,\"tid\":3") == 1);
+      REQUIRE(occurrences(trace, "\"args\":{\"keys\":10}") == 1);
+      std::filesystem::remove("trace.json");
+   }
+   SECTION("Test database_t trace keeps the last events of each thread")
+   {
+      trace_options_t options;
+      options.events_per_thread = 4;
+      REQUIRE(env.start_trace(options).ok());
+      for (int i = 0; i < 10; ++i)
+      {
+         REQUIRE(txn.begin(transaction_type_t::read_only).ok());
+         txn.abort();
+      }
+      REQUIRE(env.tracer()->events() == 4);
+      REQUIRE(env.stop_trace().ok());
+      REQUIRE(env.tracer() == nullptr);
+      REQUIRE(env.write_trace("trace.json").ok());
+      REQUIRE(occurrences(read_file("trace.json"), "\"name\":\"read txn\"") == 4);
+      std::filesystem::remove("trace.json");
+   }
+   SECTION("Test tracer_t write() while threads record")
+   {
+      trace_options_t options;
+      options.events_per_thread = 16;
+      tracer_t tracer(options);
+      std::atomic<bool> done{ false };
+      std::vector<std::thread> recorders;
+      for (int t = 0; t < 4; ++t)
+      {
+         recorders.emplace_back([&]()
+         {
+            // every field of event k holds k, so a torn copy shows up as a mismatch
+            for (uint64_t k = 1; !done; ++k)
+            {
+               tracer.record("event", k * 1000, k * 1000, "k", k);
+            }
+         });
+      }
+      size_t torn{ 0 }, events{ 0 };
+      for (int i = 0; i < 50; ++i)
+      {
+         REQUIRE(tracer.write("trace.json").ok());
+         std::string json = read_file("trace.json");
+         for (size_t at = json.find("\"ts\":"); at != std::string::npos; at = json.find("\"ts\":", at + 1))
+         {
+            unsigned long long ts, ts_frac, dur, dur_frac, k;
+            if (std::sscanf(json.c_str() + at, "\"ts\":%llu.%llu,\"dur\":%llu.%llu,\"args\":{\"k\":%llu}", &ts, &ts_frac, &dur, &dur_frac, &k) != 5 ||
+               ts != k || dur != k || ts_frac != 0 || dur_frac != 0)
+            {
+               ++torn;
+            }
+            ++events;
+         }
+      }
+      done = true;
+      for (std::thread& recorder : recorders)
+      {
+         recorder.join();
+      }
+      REQUIRE(events > 0);
+      REQUIRE(torn == 0);
+      std::filesystem::remove("trace.json");
+   }
+   REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+   REQUIRE(tb.drop(txn).ok());
+   REQUIRE(txn.commit().ok());
+}
+
+TEST_CASE("lmdbpp.h database_t catalog tests", "[database_t]")
+{
+   enum { accounts, ledger };
+   std::string path(".\\");
+   database_t env;
+   REQUIRE(env.initialize(path).ok());
+   transaction_t txn(env);
+   REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+   store_t a(env), b(env);
+   REQUIRE(a.create(txn, "catalog-a.dbm").ok());
+   REQUIRE(b.create(txn, "catalog-b.dbm", MDB_DUPSORT).ok());
+   REQUIRE(txn.commit().ok());
+   REQUIRE(env.open_catalog({ "catalog-a.dbm", "catalog-b.dbm" }).ok());
+
+   SECTION("Test store_t open() method by id")
+   {
+      store_t s(env);
+      REQUIRE(s.open(ledger).ok());
+      REQUIRE(s.handle() == b.handle());
+      REQUIRE(s.name() == "catalog-b.dbm");
+      REQUIRE(s.open(accounts).error() == MDB_ALREADY_OPEN);
+      store_t t(env);
+      REQUIRE(t.open(size_t(2)).error() == MDB_NOTFOUND);
+   }
+   SECTION("Test store_t open() method by name")
+   {
+      store_t s(env), missing(env);
+      REQUIRE(s.open("catalog-a.dbm").ok());
+      REQUIRE(s.handle() == a.handle());
+      REQUIRE(missing.open("catalog-missing.dbm").error() == MDB_NOTFOUND);
+      REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+      REQUIRE(s.put(txn, "key", "value").ok());
+      REQUIRE(txn.commit().ok());
+      REQUIRE(txn.begin(transaction_type_t::read_only).ok());
+      std::string k, v;
+      REQUIRE(a.get(txn, "key", k, v).ok());
+      REQUIRE(v == "value");
+   }
+   SECTION("Test database_t open_catalog() method with a missing store")
+   {
+      REQUIRE(env.open_catalog({ "catalog-missing.dbm" }).error() == MDB_NOTFOUND);
+   }
+   SECTION("Test database_t catalog after commit and abort")
+   {
+      MDB_dbi dbi{ 0 };
+      store_t c(env), d(env);
+      REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+      REQUIRE(c.create(txn, "catalog-c.dbm").ok());
+      REQUIRE_FALSE(env.find_store("catalog-c.dbm", dbi));
+      txn.abort();
+      REQUIRE_FALSE(env.find_store("catalog-c.dbm", dbi));
+      c = store_t(env);
+      REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+      REQUIRE(c.create(txn, "catalog-c.dbm").ok());
+      REQUIRE(txn.commit().ok());
+      REQUIRE(env.find_store("catalog-c.dbm", dbi));
+      REQUIRE(dbi == c.handle());
+      REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+      REQUIRE(c.drop(txn).ok());
+      REQUIRE_FALSE(env.find_store("catalog-c.dbm", dbi));
+      REQUIRE(txn.commit().ok());
+   }
+   SECTION("Test database_t catalog of a store opened by a transaction that aborts")
+   {
+      MDB_dbi dbi{ 0 };
+      int by_name{ 0 }, by_txn{ 0 };
+      store_t e(env);
+      REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+      REQUIRE(e.create(txn, "catalog-e.dbm").ok());
+      // the handle of catalog-e.dbm is closed by the abort, no other thread can have it
+      std::thread other([&]()
+         {
+            store_t s(env), t(env);
+            transaction_t reader(env);
+            by_name = s.open("catalog-e.dbm").error();
+            if (reader.begin(transaction_type_t::read_only).ok())
+            {
+               by_txn = t.open(reader, "catalog-e.dbm").error();
+            }
+         });
+      other.join();
+      REQUIRE(by_name == MDB_STORE_PENDING);
+      REQUIRE(by_txn == MDB_STORE_PENDING);
+      REQUIRE_FALSE(env.find_store("catalog-e.dbm", dbi));
+      txn.abort();
+      store_t f(env), s(env);
+      REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+      REQUIRE(f.create(txn, "catalog-f.dbm").ok());
+      REQUIRE(txn.commit().ok());
+      REQUIRE_FALSE(env.find_store("catalog-e.dbm", dbi));
+      REQUIRE(s.open("catalog-e.dbm").error() == MDB_NOTFOUND);
+      REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+      REQUIRE(f.drop(txn).ok());
+      REQUIRE(txn.commit().ok());
+   }
+   SECTION("Test database_t catalog after a read-only transaction")
+   {
+      // create a store behind the catalog's back
+      MDB_txn* raw{ nullptr };
+      MDB_dbi dbi{ 0 };
+      REQUIRE(mdb_txn_begin(env.handle(), nullptr, 0, &raw) == MDB_SUCCESS);
+      REQUIRE(mdb_dbi_open(raw, "catalog-d.dbm", MDB_CREATE, &dbi) == MDB_SUCCESS);
+      REQUIRE(mdb_txn_commit(raw) == MDB_SUCCESS);
+      REQUIRE_FALSE(env.find_store("catalog-d.dbm", dbi));
+      store_t d(env);
+      REQUIRE(txn.begin(transaction_type_t::read_only).ok());
+      REQUIRE(d.open(txn, "catalog-d.dbm").ok());
+      txn.abort();
+      REQUIRE(env.find_store("catalog-d.dbm", dbi));
+      REQUIRE(dbi == d.handle());
+      REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+      REQUIRE(d.drop(txn).ok());
+      REQUIRE(txn.commit().ok());
+   }
+   txn.abort();
+   REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+   REQUIRE(a.drop(txn).ok());
+   REQUIRE(b.drop(txn).ok());
+   REQUIRE(txn.commit().ok());
 }
 
 TEST_CASE("lmdbpp.h transaction_t class tests", "[transaction_t]")
@@ -160,6 +529,196 @@ TEST_CASE("lmdbpp.h transaction_t class tests", "[transaction_t]")
       REQUIRE(txn.abort().ok());
       REQUIRE(txn.handle() == nullptr);
    }
+   SECTION("Test transaction_t commit() method with commit_stats_t")
+   {
+      transaction_t txn(env);
+      store_t tb(env);
+      commit_stats_t stats;
+      REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+      REQUIRE(tb.create(txn, "commit-stats.dbm").ok());
+      REQUIRE(tb.put(txn, "key", std::string(10000, 'v')).ok());
+      REQUIRE(txn.commit(stats).ok());
+      REQUIRE(txn.handle() == nullptr);
+      // a leaf, an overflow chain, the main DB root and freelist pages
+      REQUIRE(stats.dirty_pages >= 3);
+      REQUIRE(stats.written_pages >= stats.dirty_pages + 2);
+      REQUIRE(stats.written_bytes >= 10000);
+      REQUIRE(stats.total.count() > 0);
+      REQUIRE(stats.total >= stats.update_stores + stats.freelist_save + stats.page_flush + stats.sync + stats.write_meta);
+      REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+      REQUIRE(tb.drop(txn).ok());
+      REQUIRE(txn.commit(stats).ok());
+      REQUIRE(stats.freelist_pages >= 4);
+      REQUIRE(txn.commit(stats).error() == MDB_TRANSACTION_HANDLE_NULL);
+   }
+   SECTION("Test freed pages are reused once the oldest reader ends")
+   {
+      store_t tb(env);
+      std::string value(1000, 'v');
+      auto rewrite = [&](int rounds) -> size_t
+      {
+         for (int r = 0; r < rounds; ++r)
+         {
+            transaction_t txn(env);
+            REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+            for (int i = 0; i < 200; ++i)
+            {
+               REQUIRE(tb.put(txn, std::to_string(i), value).ok());
+            }
+            REQUIRE(txn.commit().ok());
+         }
+         MDB_envinfo info;
+         REQUIRE(mdb_env_info(env.handle(), &info) == MDB_SUCCESS);
+         return info.me_last_pgno;
+      };
+      transaction_t txn(env);
+      REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+      REQUIRE(tb.create(txn, "oldest-reader.dbm").ok());
+      REQUIRE(txn.commit().ok());
+      rewrite(5);
+      // a reader pins its snapshot, so every rewrite needs new pages
+      transaction_t reader(env);
+      REQUIRE(reader.begin(transaction_type_t::read_only).ok());
+      size_t start = rewrite(1);
+      size_t pinned = rewrite(20);
+      REQUIRE(pinned - start > 20 * 50);
+      // once it ends the pages it held are free again
+      REQUIRE(reader.abort().ok());
+      rewrite(2);
+      size_t released = rewrite(20);
+      REQUIRE(released - pinned < 100);
+      REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+      REQUIRE(tb.drop(txn).ok());
+      REQUIRE(txn.commit().ok());
+   }
+}
+
+// stores are set up in a txn the first time it uses them, see mdb_dbi_init()
+TEST_CASE("lmdbpp.h transaction_t first use of a store tests", "[transaction_t]")
+{
+   auto val = [](const char* str)
+   {
+      return MDB_val{ std::strlen(str), const_cast<char*>(str) };
+   };
+   auto get = [&](MDB_txn* txn, MDB_dbi dbi, const char* key, std::string& value)
+   {
+      MDB_val k = val(key), v;
+      int rc = mdb_get(txn, dbi, &k, &v);
+      value = rc == MDB_SUCCESS ? std::string((const char*)v.mv_data, v.mv_size) : std::string();
+      return rc;
+   };
+   auto put = [&](MDB_txn* txn, MDB_dbi dbi, const char* key, const char* value)
+   {
+      MDB_val k = val(key), v = val(value);
+      return mdb_put(txn, dbi, &k, &v, 0);
+   };
+   std::filesystem::remove_all("dbi-init-test");
+   std::filesystem::create_directories("dbi-init-test");
+   database_t db;
+   REQUIRE(db.initialize("dbi-init-test").ok());
+   MDB_env* env = db.handle();
+   MDB_txn* txn{ nullptr };
+   MDB_txn* child{ nullptr };
+   MDB_dbi first{ 0 }, second{ 0 };
+   std::string value;
+   REQUIRE(mdb_txn_begin(env, nullptr, 0, &txn) == MDB_SUCCESS);
+   REQUIRE(mdb_dbi_open(txn, "first", MDB_CREATE, &first) == MDB_SUCCESS);
+   REQUIRE(mdb_dbi_open(txn, "second", MDB_CREATE, &second) == MDB_SUCCESS);
+   REQUIRE(put(txn, first, "key", "first") == MDB_SUCCESS);
+   REQUIRE(put(txn, second, "key", "second") == MDB_SUCCESS);
+   REQUIRE(mdb_txn_commit(txn) == MDB_SUCCESS);
+
+   SECTION("Test a store first used in a nested txn")
+   {
+      REQUIRE(mdb_txn_begin(env, nullptr, 0, &txn) == MDB_SUCCESS);
+      // the parent has not used first, the children set it up
+      REQUIRE(mdb_txn_begin(env, txn, 0, &child) == MDB_SUCCESS);
+      REQUIRE(put(child, first, "committed", "yes") == MDB_SUCCESS);
+      REQUIRE(mdb_txn_commit(child) == MDB_SUCCESS);
+      REQUIRE(mdb_txn_begin(env, txn, 0, &child) == MDB_SUCCESS);
+      REQUIRE(put(child, first, "aborted", "yes") == MDB_SUCCESS);
+      mdb_txn_abort(child);
+      REQUIRE(get(txn, first, "committed", value) == MDB_SUCCESS);
+      REQUIRE(value == "yes");
+      REQUIRE(get(txn, first, "aborted", value) == MDB_NOTFOUND);
+      // second is first used by a child that aborts, then by the parent
+      REQUIRE(mdb_txn_begin(env, txn, 0, &child) == MDB_SUCCESS);
+      REQUIRE(put(child, second, "aborted", "yes") == MDB_SUCCESS);
+      mdb_txn_abort(child);
+      REQUIRE(get(txn, second, "aborted", value) == MDB_NOTFOUND);
+      REQUIRE(get(txn, second, "key", value) == MDB_SUCCESS);
+      REQUIRE(value == "second");
+      // a store created by a child is kept or closed with the child
+      MDB_dbi kept{ 0 }, dropped{ 0 };
+      REQUIRE(mdb_txn_begin(env, txn, 0, &child) == MDB_SUCCESS);
+      REQUIRE(mdb_dbi_open(child, "dropped", MDB_CREATE, &dropped) == MDB_SUCCESS);
+      REQUIRE(put(child, dropped, "key", "dropped") == MDB_SUCCESS);
+      mdb_txn_abort(child);
+      REQUIRE(get(txn, dropped, "key", value) == EINVAL);
+      REQUIRE(mdb_txn_begin(env, txn, 0, &child) == MDB_SUCCESS);
+      REQUIRE(mdb_dbi_open(child, "kept", MDB_CREATE, &kept) == MDB_SUCCESS);
+      REQUIRE(put(child, kept, "key", "kept") == MDB_SUCCESS);
+      REQUIRE(mdb_txn_commit(child) == MDB_SUCCESS);
+      REQUIRE(get(txn, kept, "key", value) == MDB_SUCCESS);
+      REQUIRE(value == "kept");
+      REQUIRE(mdb_txn_commit(txn) == MDB_SUCCESS);
+      REQUIRE(mdb_txn_begin(env, nullptr, MDB_RDONLY, &txn) == MDB_SUCCESS);
+      REQUIRE(get(txn, first, "committed", value) == MDB_SUCCESS);
+      REQUIRE(get(txn, first, "aborted", value) == MDB_NOTFOUND);
+      REQUIRE(get(txn, kept, "key", value) == MDB_SUCCESS);
+      REQUIRE(value == "kept");
+      mdb_txn_abort(txn);
+   }
+   SECTION("Test a store opened in a read-only txn and used in a write txn")
+   {
+      MDB_dbi dbi{ 0 };
+      mdb_dbi_close(env, first);
+      REQUIRE(mdb_txn_begin(env, nullptr, MDB_RDONLY, &txn) == MDB_SUCCESS);
+      REQUIRE(mdb_dbi_open(txn, "first", 0, &dbi) == MDB_SUCCESS);
+      REQUIRE(get(txn, dbi, "key", value) == MDB_SUCCESS);
+      // committing the read-only txn keeps the handle
+      REQUIRE(mdb_txn_commit(txn) == MDB_SUCCESS);
+      REQUIRE(mdb_txn_begin(env, nullptr, 0, &txn) == MDB_SUCCESS);
+      REQUIRE(put(txn, dbi, "key", "written") == MDB_SUCCESS);
+      REQUIRE(mdb_txn_commit(txn) == MDB_SUCCESS);
+      REQUIRE(mdb_txn_begin(env, nullptr, MDB_RDONLY, &txn) == MDB_SUCCESS);
+      REQUIRE(get(txn, dbi, "key", value) == MDB_SUCCESS);
+      REQUIRE(value == "written");
+      mdb_txn_abort(txn);
+   }
+   SECTION("Test a handle closed and its slot reused while a txn is live")
+   {
+      MDB_txn* reader{ nullptr };
+      MDB_dbi dbi{ 0 };
+      mdb_dbi_close(env, second);
+      // the reader has not used the slot of first yet when it is reused for second
+      REQUIRE(mdb_txn_begin(env, nullptr, MDB_RDONLY, &reader) == MDB_SUCCESS);
+      mdb_dbi_close(env, first);
+      REQUIRE(mdb_txn_begin(env, nullptr, 0, &txn) == MDB_SUCCESS);
+      REQUIRE(mdb_dbi_open(txn, "second", 0, &dbi) == MDB_SUCCESS);
+      REQUIRE(dbi == first);
+      REQUIRE(put(txn, dbi, "key", "reused") == MDB_SUCCESS);
+      REQUIRE(mdb_txn_commit(txn) == MDB_SUCCESS);
+      // at first use the reader sets the slot up as second, on its own snapshot
+      REQUIRE(get(reader, dbi, "key", value) == MDB_SUCCESS);
+      REQUIRE(value == "second");
+      mdb_txn_abort(reader);
+      // a write txn begun before the reopen sets the slot up at first use
+      REQUIRE(mdb_txn_begin(env, nullptr, 0, &txn) == MDB_SUCCESS);
+      mdb_dbi_close(env, dbi);
+      REQUIRE(mdb_dbi_open(txn, "second", 0, &dbi) == MDB_SUCCESS);
+      REQUIRE(dbi == first);
+      REQUIRE(get(txn, dbi, "key", value) == MDB_SUCCESS);
+      REQUIRE(value == "reused");
+      REQUIRE(put(txn, dbi, "key", "again") == MDB_SUCCESS);
+      REQUIRE(mdb_txn_commit(txn) == MDB_SUCCESS);
+      REQUIRE(mdb_txn_begin(env, nullptr, MDB_RDONLY, &txn) == MDB_SUCCESS);
+      REQUIRE(get(txn, dbi, "key", value) == MDB_SUCCESS);
+      REQUIRE(value == "again");
+      mdb_txn_abort(txn);
+   }
+   db.cleanup();
+   std::filesystem::remove_all("dbi-init-test");
 }
 
 template <typename T>
@@ -227,102 +786,466 @@ TEST_CASE("lmdbpp.h data_t class tests", "[data_t]")
    }
 }
 
-TEST_CASE("lmdbpp.h table_t class tests", "[table_t]")
+TEST_CASE("lmdbpp.h layout_t class tests", "[layout_t]")
 {
-   std::string path(".\\");
-   database_t env;
-   REQUIRE(env.initialize(path).ok());
-   REQUIRE(env.handle() != nullptr);
-   transaction_t txn(env);
+   enum { id, name, price, quantity, note };
+   using order_v1 = layout_t<uint64_t, std::string_view, double>;
+   using order_v2 = layout_t<uint64_t, std::string_view, double, int32_t, std::string_view>;
 
-   SECTION("Test table_ constructor")
+   SECTION("Test layout_t offsets")
    {
-      store_t tb(env);
-      REQUIRE(tb.handle() == 0);
+      static_assert(order_v1::OFFSETS[id] == order_v1::HEADER_SIZE);
+      static_assert(order_v1::OFFSETS[price] == order_v1::HEADER_SIZE + 16);
+      static_assert(order_v2::OFFSETS[quantity] == order_v1::OFFSETS[order_v1::FIELDS]);
+      REQUIRE(order_v2::OFFSETS[order_v2::FIELDS] == 4 + 8 + 8 + 8 + 4 + 8);
    }
-   SECTION("Test table_t create() method")
+   SECTION("Test layout_t encode() and view_t get() methods")
    {
-      std::string path{ "test.dbm" };
-      store_t tb(env);
-      REQUIRE(txn.begin(transaction_type_t::read_write).ok());
-      REQUIRE(tb.create(txn, path).ok());
+      std::string value = order_v2::encode(42, "widget", 9.5, -3, "");
+      REQUIRE(value.size() == order_v2::OFFSETS[order_v2::FIELDS] + 6);
+      order_v2::view_t view(value);
+      REQUIRE(view.valid());
+      REQUIRE(view.fields() == 5);
+      REQUIRE(view.get<id>() == 42);
+      REQUIRE(view.get<name>() == "widget");
+      REQUIRE(view.get<price>() == 9.5);
+      REQUIRE(view.get<quantity>() == -3);
+      REQUIRE(view.get<note>().empty());
    }
-   SECTION("Test table_t put() and get() methods")
+   SECTION("Test layout_t versions")
    {
-      std::vector<std::pair<const char*, const char*>> data =
-      {
-           { "first", "first record" }
-         , { "second", "second record" }
-         , { "third", "third record" } 
-      };
-      std::string path{ "test.dbm" };
-      store_t tb(env);
+      std::string old_value = order_v1::encode(7, "gadget", 1.25);
+      order_v2::view_t newer(old_value);
+      REQUIRE(newer.valid());
+      REQUIRE(newer.fields() == 3);
+      REQUIRE(newer.has<price>());
+      REQUIRE_FALSE(newer.has<quantity>());
+      REQUIRE(newer.get<name>() == "gadget");
+      REQUIRE(newer.get<quantity>() == 0);
+      REQUIRE(newer.get<note>().empty());
+      std::string new_value = order_v2::encode(8, "gizmo", 2.5, 10, "fragile");
+      order_v1::view_t older(new_value);
+      REQUIRE(older.valid());
+      REQUIRE(older.fields() == 3);
+      REQUIRE(older.get<id>() == 8);
+      REQUIRE(older.get<name>() == "gizmo");
+      REQUIRE(older.get<price>() == 2.5);
+   }
+   SECTION("Test layout_t set() method")
+   {
+      std::string value = order_v1::encode(7, "gadget", 1.25);
+      REQUIRE(order_v1::set<price>(value, 3.75));
+      REQUIRE(order_v1::view_t(value).get<price>() == 3.75);
+      REQUIRE(order_v1::view_t(value).get<name>() == "gadget");
+      REQUIRE_FALSE(order_v2::set<quantity>(value, 5));
+   }
+   SECTION("Test layout_t view_t with bad values")
+   {
+      REQUIRE_FALSE(order_v1::view_t().valid());
+      REQUIRE_FALSE(order_v1::view_t("ab").valid());
+      std::string value = order_v1::encode(7, "gadget", 1.25);
+      order_v1::view_t truncated(std::string_view(value).substr(0, order_v1::OFFSETS[price]));
+      REQUIRE_FALSE(truncated.valid());
+      REQUIRE(truncated.get<id>() == 0);
+      // a string slot pointing past the end of the value reads as empty
+      order_v1::view_t cut(std::string_view(value).substr(0, order_v1::OFFSETS[order_v1::FIELDS] + 2));
+      REQUIRE(cut.valid());
+      REQUIRE(cut.get<name>().empty());
+      REQUIRE(cut.get<price>() == 1.25);
+   }
+   SECTION("Test layout_t with store_t get() method")
+   {
+      std::string path(".\\");
+      database_t env;
+      REQUIRE(env.initialize(path).ok());
+      transaction_t txn(env);
       REQUIRE(txn.begin(transaction_type_t::read_write).ok());
-      REQUIRE(tb.create(txn, path).ok());
+      store_t tb(env);
+      REQUIRE(tb.create(txn, "layout.dbm").ok());
+      REQUIRE(tb.put(txn, "order-1", order_v2::encode(1, "widget", 9.5, 4, "rush")).ok());
       REQUIRE(txn.commit().ok());
+      REQUIRE(txn.begin(transaction_type_t::read_only).ok());
+      std::string_view bytes;
+      REQUIRE(tb.get(txn, "order-1", bytes).ok());
+      order_v2::view_t view(bytes);
+      REQUIRE(view.get<quantity>() == 4);
+      REQUIRE(view.get<note>() == "rush");
+      REQUIRE(tb.get(txn, "order-2", bytes).error() == MDB_NOTFOUND);
+      txn.abort();
       REQUIRE(txn.begin(transaction_type_t::read_write).ok());
-      for (auto [key, value] : data)
-      {
-         REQUIRE(tb.put(txn, key, value).ok());
-         std::string k{key}, v;
-         REQUIRE(tb.get(txn, k, k, v).ok());
-         REQUIRE(k == key);
-         REQUIRE(v == value);
-      }
       REQUIRE(tb.drop(txn).ok());
       REQUIRE(txn.commit().ok());
    }
-   SECTION("Test table_t del()")
+}
+
+TEST_CASE("lmdbpp.h key_codec_t class tests", "[key_codec_t]")
+{
+   using event_key = key_codec_t<int32_t, descending_t<double>, std::string_view, uint16_t>;
+
+   SECTION("Test key_codec_t byte order matches value order")
    {
-      std::vector<std::pair<std::string, std::string>> data =
+      std::mt19937 rng(69);
+      std::uniform_int_distribution<int> small(-3, 3);
+      const char* names[] = { "", "a", "ab", "a\0b", "b", "\0", "\xff" };
+      size_t name_sizes[] = { 0, 1, 2, 3, 1, 1, 1 };
+      auto random_values = [&]()
       {
-           { "first", "first record" }
-         , { "second", "second record" }
-         , { "third", "third record" }
+         size_t n = size_t(small(rng) + 3);
+         // integers are mostly small so that later parts decide ties, with the extremes mixed in
+         int32_t a = small(rng) == 3 ? std::numeric_limits<int32_t>::min() : small(rng) * 1000;
+         double b = small(rng) == 3 ? -std::numeric_limits<double>::infinity() : small(rng) / 8.0;
+         uint16_t d = small(rng) == 3 ? uint16_t(65535) : uint16_t(small(rng) + 3);
+         return std::make_tuple(a, b, std::string_view(names[n], name_sizes[n]), d);
       };
-      std::string path{ "test.dbm" };
-      store_t tb(env);
-      REQUIRE(txn.begin(transaction_type_t::read_write).ok());
-      REQUIRE(tb.create(txn, path).ok());
-      for (auto [key, value] : data)
+      auto less = [](const auto& x, const auto& y)
       {
-         REQUIRE(tb.put(txn, key, value).ok());
-         std::string k{ key }, v;
-         REQUIRE(tb.get(txn, k, k, v).ok());
-         REQUIRE(k == key);
-         REQUIRE(v == value);
+         if (std::get<0>(x) != std::get<0>(y)) return std::get<0>(x) < std::get<0>(y);
+         if (std::get<1>(x) != std::get<1>(y)) return std::get<1>(x) > std::get<1>(y);
+         if (std::get<2>(x) != std::get<2>(y)) return std::get<2>(x) < std::get<2>(y);
+         return std::get<3>(x) < std::get<3>(y);
+      };
+      for (int i = 0; i < 5000; ++i)
+      {
+         auto x = random_values();
+         auto y = random_values();
+         std::string kx = std::apply(event_key::encode, x);
+         std::string ky = std::apply(event_key::encode, y);
+         REQUIRE((kx < ky) == less(x, y));
+         REQUIRE((kx == ky) == (!less(x, y) && !less(y, x)));
       }
-      REQUIRE(tb.del(txn, data[1].first, data[1].second).ok());
-      REQUIRE(tb.get(txn, data[1].first, data[1].first, data[1].second).nok());
-      REQUIRE(tb.drop(txn).ok());
-      REQUIRE(txn.commit().ok());
    }
-   SECTION("Test table_t entries() method")
+   SECTION("Test key_codec_t decode() method")
    {
-      std::vector<std::pair<std::string, std::string>> data =
-      {
-           { "first", "first record" }
-         , { "second", "second record" }
-         , { "third", "third record" }
-      };
-      std::string path{ "test.dbm" };
-      store_t tb(env);
+      event_key::values_t values;
+      std::string key = event_key::encode(-7, -2.5, std::string_view("x\0\0y", 4), 12);
+      REQUIRE(event_key::decode(key, values));
+      REQUIRE(std::get<0>(values) == -7);
+      REQUIRE(std::get<1>(values) == -2.5);
+      REQUIRE(std::get<2>(values) == std::string("x\0\0y", 4));
+      REQUIRE(std::get<3>(values) == 12);
+      REQUIRE_FALSE(event_key::decode(key.substr(0, key.size() - 1), values));
+      REQUIRE_FALSE(event_key::decode(key + "z", values));
+      REQUIRE_FALSE(event_key::decode("", values));
+      using name_key = key_codec_t<descending_t<std::string>, std::string_view>;
+      name_key::values_t names;
+      REQUIRE(name_key::decode(name_key::encode(std::string_view("\0z", 2), ""), names));
+      REQUIRE(std::get<0>(names) == std::string("\0z", 2));
+      REQUIRE(std::get<1>(names).empty());
+   }
+   SECTION("Test key_codec_t encode_fixed() method")
+   {
+      using tick_key = key_codec_t<uint32_t, descending_t<int64_t>, bool, float>;
+      static_assert(tick_key::FIXED && tick_key::SIZE == 17);
+      static_assert(!event_key::FIXED);
+      constexpr auto key = tick_key::encode_fixed(1, -1, true, 0.5f);
+      static_assert(key[3] == 1 && key[4] == char(0x80) && key[11] == 0 && key[12] == 1);
+      REQUIRE(std::string(key.data(), key.size()) == tick_key::encode(1, -1, true, 0.5f));
+      tick_key::values_t values;
+      REQUIRE(tick_key::decode(std::string_view(key.data(), key.size()), values));
+      REQUIRE(values == std::make_tuple(1u, int64_t(-1), true, 0.5f));
+      REQUIRE_FALSE(tick_key::decode(std::string_view(key.data(), key.size() - 1), values));
+   }
+   SECTION("Test key_codec_t prefix() method with store_t")
+   {
+      std::string path(".\\");
+      database_t env;
+      REQUIRE(env.initialize(path).ok());
+      transaction_t txn(env);
       REQUIRE(txn.begin(transaction_type_t::read_write).ok());
-      REQUIRE(tb.create(txn, path).ok());
-      for (auto [key, value] : data)
+      store_t tb(env);
+      REQUIRE(tb.create(txn, "keycodec.dbm").ok());
+      for (int32_t user = -2; user <= 2; ++user)
       {
-         REQUIRE(tb.put(txn, key, value).ok());
-         std::string k{ key }, v;
-         REQUIRE(tb.get(txn, k, k, v).ok());
-         REQUIRE(k == key);
-         REQUIRE(v == value);
+         for (double score : { 1.5, -4.0, 30.0 })
+         {
+            REQUIRE(tb.put(txn, event_key::encode(user, score, "game", 1), "").ok());
+         }
       }
-      REQUIRE(tb.entries(txn) == data.size());
-      REQUIRE(tb.drop(txn).ok());
       REQUIRE(txn.commit().ok());
-   }
-}
-
+      REQUIRE(txn.begin(transaction_type_t::read_only).ok());
+      cursor_t cursor(txn, tb);
+      std::string prefix = event_key::prefix(-1);
+      std::string key, value;
+      std::vector<double> scores;
+      event_key::values_t values;
+      for (status_t status = cursor.search(prefix, key, value); status.ok() && key.starts_with(prefix); status = cursor.next(key, value))
+      {
+         REQUIRE(event_key::decode(key, values));
+         REQUIRE(std::get<0>(values) == -1);
+         scores.push_back(std::get<1>(values));
+      }
+      REQUIRE(scores == std::vector<double>{ 30.0, 1.5, -4.0 });
+      cursor.close();
+      txn.abort();
+      REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+      REQUIRE(tb.drop(txn).ok());
+      REQUIRE(txn.commit().ok());
+   }
+}
+
+TEST_CASE("lmdbpp.h ordered_store_t class tests", "[ordered_store_t]")
+{
+   std::string path(".\\");
+   auto keys_of = [](transaction_t& txn, store_t& tb)
+   {
+      std::vector<std::string> keys;
+      cursor_t cursor(txn, tb);
+      std::string key, value;
+      for (status_t status = cursor.first(key, value); status.ok(); status = cursor.next(key, value))
+      {
+         keys.push_back(key);
+      }
+      return keys;
+   };
+
+   SECTION("Test ordered_store_t with a custom order")
+   {
+      struct shortest_first_t
+      {
+         int operator()(const std::string_view& a, const std::string_view& b) const noexcept
+         {
+            return a.size() != b.size() ? (a.size() < b.size() ? -1 : 1) : a.compare(b);
+         }
+      };
+      std::vector<std::string> sorted{ "z", "ab", "ba", "aaa" };
+      {
+         database_t env;
+         REQUIRE(env.initialize(path).ok());
+         transaction_t txn(env);
+         REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+         ordered_store_t<shortest_first_t> tb(env);
+         REQUIRE(tb.create(txn, "ordered.dbm").ok());
+         for (const char* key : { "aaa", "ba", "z", "ab" })
+         {
+            REQUIRE(tb.put(txn, key, key).ok());
+         }
+         REQUIRE(keys_of(txn, tb) == sorted);
+         REQUIRE(txn.commit().ok());
+      }
+      // the order is set again when the store is opened by another environment handle
+      database_t env;
+      REQUIRE(env.initialize(path).ok());
+      transaction_t txn(env);
+      REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+      ordered_store_t<shortest_first_t> tb(env);
+      REQUIRE(tb.open(txn, "ordered.dbm").ok());
+      REQUIRE(tb.put(txn, "b", "b").ok());
+      sorted.insert(sorted.begin(), "b");
+      REQUIRE(keys_of(txn, tb) == sorted);
+      std::string_view value;
+      REQUIRE(tb.get(txn, "aaa", value).ok());
+      REQUIRE(value == "aaa");
+      REQUIRE(tb.drop(txn).ok());
+      REQUIRE(txn.commit().ok());
+   }
+   SECTION("Test ordered_store_t with the built-in orders")
+   {
+      database_t env;
+      REQUIRE(env.initialize(path).ok());
+      transaction_t txn(env);
+      REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+      ordered_store_t<reverse_order_t> reversed(env);
+      REQUIRE(reversed.create(txn, "reversed.dbm").ok());
+      for (const char* key : { "ab", "ca", "ba", "a" })
+      {
+         REQUIRE(reversed.put(txn, key, "").ok());
+      }
+      std::vector<std::string> keys = keys_of(txn, reversed);
+      REQUIRE(keys == std::vector<std::string>{ "a", "ba", "ca", "ab" });
+      for (size_t i = 1; i < keys.size(); ++i)
+      {
+         REQUIRE(ordered_store_t<reverse_order_t>::compare(keys[i - 1], keys[i]) < 0);
+      }
+      ordered_store_t<integer_order_t> numbers(env);
+      REQUIRE(numbers.create(txn, "numbers.dbm").ok());
+      for (unsigned int n : { 65536u, 1u, 256u })
+      {
+         REQUIRE(numbers.put(txn, std::string_view(reinterpret_cast<const char*>(&n), sizeof(n)), "").ok());
+      }
+      keys = keys_of(txn, numbers);
+      REQUIRE(keys.size() == 3);
+      unsigned int first, last;
+      std::memcpy(&first, keys.front().data(), sizeof(first));
+      std::memcpy(&last, keys.back().data(), sizeof(last));
+      REQUIRE(first == 1);
+      REQUIRE(last == 65536);
+      REQUIRE(integer_order_t{}(keys[0], keys[1]) < 0);
+      // prefix scans are only allowed in lexical order, where keys sharing a prefix are contiguous
+      ordered_store_t<> lexical(env);
+      REQUIRE(lexical.create(txn, "lexical.dbm").ok());
+      for (const char* key : { "ab", "ca", "ba", "a" })
+      {
+         REQUIRE(lexical.put(txn, key, "").ok());
+      }
+      std::vector<std::string> prefixed;
+      REQUIRE(lexical.scan_prefix(txn, "a", [&](std::string_view key, std::string_view) { prefixed.emplace_back(key); }).ok());
+      REQUIRE(prefixed == std::vector<std::string>{ "a", "ab" });
+      REQUIRE(lexical.drop(txn).ok());
+      REQUIRE(reversed.drop(txn).ok());
+      REQUIRE(numbers.drop(txn).ok());
+      REQUIRE(txn.commit().ok());
+   }
+}
+
+TEST_CASE("lmdbpp.h table_t class tests", "[table_t]")
+{
+   std::string path(".\\");
+   database_t env;
+   REQUIRE(env.initialize(path).ok());
+   REQUIRE(env.handle() != nullptr);
+   transaction_t txn(env);
+
+   SECTION("Test table_ constructor")
+   {
+      store_t tb(env);
+      REQUIRE(tb.handle() == 0);
+   }
+   SECTION("Test table_t create() method")
+   {
+      std::string path{ "test.dbm" };
+      store_t tb(env);
+      REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+      REQUIRE(tb.create(txn, path).ok());
+   }
+   SECTION("Test table_t put() and get() methods")
+   {
+      std::vector<std::pair<const char*, const char*>> data =
+      {
+           { "first", "first record" }
+         , { "second", "second record" }
+         , { "third", "third record" } 
+      };
+      std::string path{ "test.dbm" };
+      store_t tb(env);
+      REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+      REQUIRE(tb.create(txn, path).ok());
+      REQUIRE(txn.commit().ok());
+      REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+      for (auto [key, value] : data)
+      {
+         REQUIRE(tb.put(txn, key, value).ok());
+         std::string k{key}, v;
+         REQUIRE(tb.get(txn, k, k, v).ok());
+         REQUIRE(k == key);
+         REQUIRE(v == value);
+      }
+      REQUIRE(tb.drop(txn).ok());
+      REQUIRE(txn.commit().ok());
+   }
+   SECTION("Test table_t del()")
+   {
+      std::vector<std::pair<std::string, std::string>> data =
+      {
+           { "first", "first record" }
+         , { "second", "second record" }
+         , { "third", "third record" }
+      };
+      std::string path{ "test.dbm" };
+      store_t tb(env);
+      REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+      REQUIRE(tb.create(txn, path).ok());
+      for (auto [key, value] : data)
+      {
+         REQUIRE(tb.put(txn, key, value).ok());
+         std::string k{ key }, v;
+         REQUIRE(tb.get(txn, k, k, v).ok());
+         REQUIRE(k == key);
+         REQUIRE(v == value);
+      }
+      REQUIRE(tb.del(txn, data[1].first, data[1].second).ok());
+      REQUIRE(tb.get(txn, data[1].first, data[1].first, data[1].second).nok());
+      REQUIRE(tb.drop(txn).ok());
+      REQUIRE(txn.commit().ok());
+   }
+   SECTION("Test table_t entries() method")
+   {
+      std::vector<std::pair<std::string, std::string>> data =
+      {
+           { "first", "first record" }
+         , { "second", "second record" }
+         , { "third", "third record" }
+      };
+      std::string path{ "test.dbm" };
+      store_t tb(env);
+      REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+      REQUIRE(tb.create(txn, path).ok());
+      for (auto [key, value] : data)
+      {
+         REQUIRE(tb.put(txn, key, value).ok());
+         std::string k{ key }, v;
+         REQUIRE(tb.get(txn, k, k, v).ok());
+         REQUIRE(k == key);
+         REQUIRE(v == value);
+      }
+      REQUIRE(tb.entries(txn) == data.size());
+      REQUIRE(tb.drop(txn).ok());
+      REQUIRE(txn.commit().ok());
+   }
+   SECTION("Test table_t truncate() method")
+   {
+      store_t tb(env);
+      std::string key, value;
+      REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+      REQUIRE(tb.create(txn, "test.dbm").ok());
+      REQUIRE(tb.put(txn, "first", "first record").ok());
+      REQUIRE(tb.put(txn, "second", "second record").ok());
+      REQUIRE(txn.commit().ok());
+      REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+      REQUIRE(tb.truncate(txn).ok());
+      REQUIRE(tb.is_open());
+      REQUIRE(tb.entries(txn) == 0);
+      REQUIRE(tb.put(txn, "third", "third record").ok());
+      REQUIRE(txn.commit().ok());
+      REQUIRE(txn.begin(transaction_type_t::read_only).ok());
+      REQUIRE(tb.entries(txn) == 1);
+      REQUIRE(tb.get(txn, "third", key, value).ok());
+      txn.abort();
+      REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+      REQUIRE(tb.drop(txn).ok());
+      REQUIRE(txn.commit().ok());
+   }
+   SECTION("Test table_t swap() method")
+   {
+      store_t live(env), shadow(env), counted(env);
+      std::string key, value;
+      REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+      REQUIRE(live.create(txn, "live.dbm").ok());
+      REQUIRE(shadow.create(txn, "shadow.dbm").ok());
+      REQUIRE(counted.create(txn, "counted.dbm", MDB_COUNTED).ok());
+      REQUIRE(live.put(txn, "old", "old record").ok());
+      REQUIRE(txn.commit().ok());
+
+      // rebuild into the shadow store while a reader keeps using the live one
+      transaction_t reader(env);
+      REQUIRE(reader.begin(transaction_type_t::read_only).ok());
+      REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+      REQUIRE(shadow.truncate(txn).ok());
+      REQUIRE(shadow.put(txn, "new", "new record").ok());
+      REQUIRE(shadow.put(txn, "newer", "newer record").ok());
+      REQUIRE(live.swap(txn, shadow).ok());
+      REQUIRE(live.entries(txn) == 2);
+      REQUIRE(shadow.entries(txn) == 1);
+      REQUIRE(live.swap(txn, counted).error() == MDB_INCOMPATIBLE);
+      REQUIRE(live.swap(txn, live).error() == EINVAL);
+      REQUIRE(txn.commit().ok());
+      REQUIRE(live.get(reader, "old", key, value).ok());
+      REQUIRE(live.get(reader, "new", key, value).error() == MDB_NOTFOUND);
+      reader.abort();
+
+      REQUIRE(txn.begin(transaction_type_t::read_only).ok());
+      REQUIRE(live.get(txn, "new", key, value).ok());
+      REQUIRE(value == "new record");
+      REQUIRE(live.get(txn, "old", key, value).error() == MDB_NOTFOUND);
+      REQUIRE(shadow.get(txn, "old", key, value).ok());
+      txn.abort();
+      REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+      REQUIRE(live.drop(txn).ok());
+      REQUIRE(shadow.drop(txn).ok());
+      REQUIRE(counted.drop(txn).ok());
+      REQUIRE(txn.commit().ok());
+   }
+}
+
 using dataset_t = std::vector<std::pair<std::string, std::string>>;
 
 status_t populate(transaction_t& txn, store_t& tbl, const dataset_t& ds) noexcept
@@ -474,3 +1397,1291 @@ TEST_CASE("lmdbpp.h cursor_t class tests", "[cursor_t]")
    }
 }
 
+
+TEST_CASE("lmdbpp.h store_t scan tests", "[store_t]")
+{
+   dataset_t data =
+   {
+        { "a1", "a1 record" }
+      , { "b1", "b1 record" }
+      , { "b2", "b2 record" }
+      , { "b3", "b3 record" }
+      , { "c1", "c1 record" }
+   };
+
+   std::string path(".\\");
+   database_t env;
+   REQUIRE(env.initialize(path).ok());
+   transaction_t txn(env);
+   REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+   store_t tb(env);
+   REQUIRE(tb.create(txn, "scan.dbm").ok());
+   REQUIRE(populate(txn, tb, data).ok());
+   REQUIRE(txn.commit().ok());
+   REQUIRE(txn.begin(transaction_type_t::read_only).ok());
+
+   std::vector<std::string> keys;
+   auto collect = [&keys](std::string_view key, std::string_view) { keys.emplace_back(key); };
+
+   SECTION("Test store_t scan_prefix() method")
+   {
+      REQUIRE(tb.scan_prefix(txn, "b", collect).ok());
+      REQUIRE(keys == std::vector<std::string>{ "b1", "b2", "b3" });
+   }
+   SECTION("Test store_t scan_prefix() method in reverse")
+   {
+      REQUIRE(tb.scan_prefix(txn, "b", collect, scan_direction_t::reverse).ok());
+      REQUIRE(keys == std::vector<std::string>{ "b3", "b2", "b1" });
+      keys.clear();
+      REQUIRE(tb.scan_prefix(txn, "c", collect, scan_direction_t::reverse).ok());
+      REQUIRE(keys == std::vector<std::string>{ "c1" });
+   }
+   SECTION("Test store_t scan_prefix() method with limit and early termination")
+   {
+      REQUIRE(tb.scan_prefix(txn, "b", collect, scan_direction_t::forward, 2).ok());
+      REQUIRE(keys == std::vector<std::string>{ "b1", "b2" });
+      keys.clear();
+      REQUIRE(tb.scan_prefix(txn, "b", [&keys](std::string_view key, std::string_view) { keys.emplace_back(key); return key != "b2"; }).ok());
+      REQUIRE(keys == std::vector<std::string>{ "b1", "b2" });
+   }
+   SECTION("Test store_t scan_prefix() method with no match")
+   {
+      REQUIRE(tb.scan_prefix(txn, "x", collect).ok());
+      REQUIRE(tb.scan_prefix(txn, "x", collect, scan_direction_t::reverse).ok());
+      REQUIRE(keys.empty());
+   }
+   SECTION("Test store_t scan_range() method")
+   {
+      REQUIRE(tb.scan_range(txn, "b1", "c1", collect).ok());
+      REQUIRE(keys == std::vector<std::string>{ "b1", "b2", "b3" });
+      keys.clear();
+      REQUIRE(tb.scan_range(txn, "b1", "c1", collect, range_bounds_t::open_closed).ok());
+      REQUIRE(keys == std::vector<std::string>{ "b2", "b3", "c1" });
+      keys.clear();
+      REQUIRE(tb.scan_range(txn, "b1", "b3", collect, range_bounds_t::open).ok());
+      REQUIRE(keys == std::vector<std::string>{ "b2" });
+   }
+   SECTION("Test store_t scan_range() method in reverse")
+   {
+      REQUIRE(tb.scan_range(txn, "a", "b3", collect, range_bounds_t::closed, scan_direction_t::reverse).ok());
+      REQUIRE(keys == std::vector<std::string>{ "b3", "b2", "b1", "a1" });
+      keys.clear();
+      REQUIRE(tb.scan_range(txn, "b", "z", collect, range_bounds_t::closed_open, scan_direction_t::reverse, 2).ok());
+      REQUIRE(keys == std::vector<std::string>{ "c1", "b3" });
+   }
+}
+
+TEST_CASE("lmdbpp.h store_t counted tests", "[store_t]")
+{
+   std::string path(".\\");
+   database_t env;
+   REQUIRE(env.initialize(path).ok());
+   transaction_t txn(env);
+   REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+   store_t tb(env);
+   REQUIRE(tb.create(txn, "counted.dbm", MDB_COUNTED).ok());
+
+   // enough keys and large enough values for a three level tree
+   std::set<std::string> keys;
+   std::mt19937 rng(52);
+   std::string value(200, 'v');
+   auto make_key = [](unsigned int n)
+   {
+      char buf[16];
+      std::snprintf(buf, sizeof(buf), "k%05u", n);
+      return std::string(buf);
+   };
+   auto verify = [&]()
+   {
+      size_t n{ 0 };
+      std::string key, val;
+      REQUIRE(tb.entries(txn) == keys.size());
+      REQUIRE(tb.count(txn, "", "z", n).ok());
+      REQUIRE(n == keys.size());
+      for (int i = 0; i < 20; ++i)
+      {
+         std::string lo = make_key(rng() % 6000), hi = make_key(rng() % 6000);
+         if (hi < lo)
+         {
+            std::swap(lo, hi);
+         }
+         REQUIRE(tb.count(txn, lo, hi, n).ok());
+         REQUIRE(n == size_t(std::distance(keys.lower_bound(lo), keys.lower_bound(hi))));
+         REQUIRE(tb.count(txn, hi, lo, n).ok());
+         REQUIRE(n == 0);
+         REQUIRE(tb.rank(txn, lo, n).ok());
+         REQUIRE(n == size_t(std::distance(keys.begin(), keys.lower_bound(lo))));
+         if (n < keys.size())
+         {
+            REQUIRE(tb.select(txn, n, key, val).ok());
+            REQUIRE(key == *keys.lower_bound(lo));
+         }
+      }
+   };
+
+   for (int round = 0; round < 4; ++round)
+   {
+      for (int i = 0; i < 1500; ++i)
+      {
+         std::string key = make_key(rng() % 6000);
+         if (rng() % 3 == 0)
+         {
+            if (keys.erase(key))
+            {
+               REQUIRE(tb.del(txn, key, "").ok());
+            }
+         }
+         else
+         {
+            keys.insert(key);
+            REQUIRE(tb.put(txn, key, value).ok());
+         }
+         if (i % 500 == 0)
+         {
+            verify();
+         }
+      }
+      verify();
+      REQUIRE(txn.commit().ok());
+      REQUIRE(txn.begin(transaction_type_t::read_only).ok());
+      verify();
+      REQUIRE(txn.commit().ok());
+      REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+   }
+
+   SECTION("Test store_t count() method bounds")
+   {
+      std::string lo = *std::next(keys.begin(), 10), hi = *std::next(keys.begin(), 20);
+      size_t n{ 0 };
+      REQUIRE(tb.count(txn, lo, hi, n, range_bounds_t::closed).ok());
+      REQUIRE(n == 11);
+      REQUIRE(tb.count(txn, lo, hi, n, range_bounds_t::open).ok());
+      REQUIRE(n == 9);
+      REQUIRE(tb.count(txn, lo, hi, n, range_bounds_t::open_closed).ok());
+      REQUIRE(n == 10);
+   }
+   SECTION("Test store_t select() method past the end")
+   {
+      std::string key, val;
+      REQUIRE(tb.select(txn, keys.size(), key, val).error() == MDB_NOTFOUND);
+   }
+   SECTION("Test store_t rank() method on a store without counts")
+   {
+      store_t plain(env);
+      size_t n{ 0 };
+      REQUIRE(plain.create(txn, "plain.dbm").ok());
+      REQUIRE(plain.put(txn, "a", "a").ok());
+      REQUIRE(plain.rank(txn, "a", n).error() == MDB_INCOMPATIBLE);
+      // keys that need no seek fail the same way
+      REQUIRE(plain.rank(txn, "", n).error() == MDB_INCOMPATIBLE);
+      REQUIRE(plain.rank(txn, "z", n).error() == MDB_INCOMPATIBLE);
+      REQUIRE(plain.count(txn, "", "z", n).error() == MDB_INCOMPATIBLE);
+      REQUIRE(plain.count(txn, "a", "b", n).error() == MDB_INCOMPATIBLE);
+   }
+   REQUIRE(tb.drop(txn).ok());
+   REQUIRE(txn.commit().ok());
+}
+
+TEST_CASE("lmdbpp.h store_t estimate tests", "[store_t]")
+{
+   std::string path(".\\");
+   database_t env;
+   REQUIRE(env.initialize(path).ok());
+   transaction_t txn(env);
+   REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+   store_t tb(env);
+   REQUIRE(tb.create(txn, "estimate.dbm").ok());
+   std::string value(100, 'v');
+   for (unsigned int i = 0; i < 20000; ++i)
+   {
+      char key[16];
+      std::snprintf(key, sizeof(key), "k%05u", i);
+      REQUIRE(tb.put(txn, key, value).ok());
+   }
+   REQUIRE(txn.commit().ok());
+   REQUIRE(txn.begin(transaction_type_t::read_only).ok());
+
+   SECTION("Test store_t estimate() method")
+   {
+      range_estimate_t est;
+      REQUIRE(tb.estimate(txn, "k05000", "k15000", est).ok());
+      REQUIRE(est.entries > 8000);
+      REQUIRE(est.entries < 12000);
+      REQUIRE(est.bytes > est.entries * value.size());
+      REQUIRE(tb.estimate(txn, "", "z", est).ok());
+      REQUIRE(est.entries == 20000);
+      REQUIRE(tb.estimate(txn, "k15000", "k05000", est).ok());
+      REQUIRE(est.entries == 0);
+   }
+   SECTION("Test store_t split() method")
+   {
+      std::vector<std::string> keys;
+      REQUIRE(tb.split(txn, 3, keys).ok());
+      REQUIRE(keys.size() == 3);
+      REQUIRE(std::is_sorted(keys.begin(), keys.end()));
+      std::string lo = "k";
+      keys.emplace_back("l");
+      for (const auto& hi : keys)
+      {
+         size_t n{ 0 };
+         REQUIRE(tb.scan_range(txn, lo, hi, [&n](std::string_view, std::string_view) { ++n; }).ok());
+         REQUIRE(n > 4000);
+         REQUIRE(n < 6000);
+         lo = hi;
+      }
+      REQUIRE(tb.split(txn, "k10000", "k10010", 100, keys).ok());
+      REQUIRE(keys.size() <= 9);
+      REQUIRE(std::all_of(keys.begin(), keys.end(), [](const std::string& key) { return key > "k10000" && key < "k10010"; }));
+   }
+   txn.abort();
+   REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+   REQUIRE(tb.drop(txn).ok());
+   REQUIRE(txn.commit().ok());
+}
+
+TEST_CASE("lmdbpp.h store_t sample tests", "[store_t]")
+{
+   std::string path(".\\");
+   database_t env;
+   REQUIRE(env.initialize(path).ok());
+   transaction_t txn(env);
+   REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+   store_t plain(env), counted(env);
+   REQUIRE(plain.create(txn, "sample.dbm").ok());
+   REQUIRE(counted.create(txn, "sample-counted.dbm", MDB_COUNTED).ok());
+   // uneven value sizes give pages with very different fill
+   std::mt19937 rng(54);
+   for (unsigned int i = 0; i < 10000; ++i)
+   {
+      char key[16];
+      std::snprintf(key, sizeof(key), "k%05u", i);
+      std::string value(i < 5000 ? 20 : 200, 'v');
+      REQUIRE(plain.put(txn, key, value).ok());
+      REQUIRE(counted.put(txn, key, value).ok());
+   }
+   REQUIRE(txn.commit().ok());
+   REQUIRE(txn.begin(transaction_type_t::read_only).ok());
+
+   // count samples in ten buckets of 1000 keys each
+   std::vector<size_t> buckets(10, 0);
+   auto bucket = [&buckets](std::string_view key, std::string_view) { buckets[std::stoul(std::string(key.substr(1))) / 1000]++; };
+   const size_t samples = 20000;
+
+   SECTION("Test store_t sample() method on a counted store")
+   {
+      REQUIRE(counted.sample(txn, samples, rng, bucket).ok());
+      for (size_t n : buckets)
+      {
+         // about five standard deviations either side of 2000
+         REQUIRE(n > 1800);
+         REQUIRE(n < 2200);
+      }
+   }
+   SECTION("Test store_t sample() method on a plain store")
+   {
+      REQUIRE(plain.sample(txn, samples, rng, bucket).ok());
+      // pages above the leaves are weighed by fanout, not by keys, so some bias remains
+      for (size_t n : buckets)
+      {
+         REQUIRE(n > 1000);
+         REQUIRE(n < 4000);
+      }
+   }
+   SECTION("Test store_t sample() method with early termination")
+   {
+      size_t n{ 0 };
+      REQUIRE(plain.sample(txn, samples, rng, [&n](std::string_view, std::string_view) { return ++n < 5; }).ok());
+      REQUIRE(n == 5);
+   }
+   txn.abort();
+   REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+   REQUIRE(plain.drop(txn).ok());
+   REQUIRE(counted.drop(txn).ok());
+   REQUIRE(txn.commit().ok());
+}
+
+TEST_CASE("lmdbpp.h store_t delete_range tests", "[store_t]")
+{
+   std::string path(".\\");
+   database_t env;
+   REQUIRE(env.initialize(path).ok());
+   transaction_t txn(env);
+   REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+   store_t plain(env), counted(env);
+   REQUIRE(plain.create(txn, "delrange.dbm").ok());
+   REQUIRE(counted.create(txn, "delrange-counted.dbm", MDB_COUNTED).ok());
+   auto make_key = [](unsigned int n)
+   {
+      char buf[16];
+      std::snprintf(buf, sizeof(buf), "k%05u", n);
+      return std::string(buf);
+   };
+   // a three level tree, with some values on overflow pages in the plain store
+   std::set<std::string> keys;
+   for (unsigned int i = 0; i < 10000; ++i)
+   {
+      std::string key = make_key(i);
+      keys.insert(key);
+      REQUIRE(plain.put(txn, key, std::string(i % 97 == 0 ? 5000 : 100, 'v')).ok());
+      REQUIRE(counted.put(txn, key, std::string(100, 'v')).ok());
+   }
+   REQUIRE(txn.commit().ok());
+   REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+   auto contents = [&txn](store_t& tb)
+   {
+      std::set<std::string> found;
+      REQUIRE(tb.scan_range(txn, "a", "z", [&found](std::string_view k, std::string_view) { found.emplace(k); }).ok());
+      return found;
+   };
+
+   SECTION("Test store_t delete_range() method with random ranges")
+   {
+      std::mt19937 rng(59);
+      for (int i = 0; i < 40; ++i)
+      {
+         std::string lo = make_key(rng() % 10000);
+         std::string hi = make_key(rng() % 10000);
+         if (hi < lo)
+         {
+            std::swap(lo, hi);
+         }
+         size_t expected = size_t(std::distance(keys.lower_bound(lo), keys.lower_bound(hi)));
+         size_t n{ 0 };
+         REQUIRE(plain.delete_range(txn, lo, hi, n).ok());
+         REQUIRE(n == expected);
+         REQUIRE(counted.delete_range(txn, lo, hi, n).ok());
+         REQUIRE(n == expected);
+         keys.erase(keys.lower_bound(lo), keys.lower_bound(hi));
+         REQUIRE(plain.entries(txn) == keys.size());
+         REQUIRE(counted.count(txn, "", "z", n).ok());
+         REQUIRE(n == keys.size());
+         if (i % 10 == 9)
+         {
+            REQUIRE(contents(plain) == keys);
+            REQUIRE(contents(counted) == keys);
+            REQUIRE(txn.commit().ok());
+            REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+         }
+      }
+   }
+   SECTION("Test store_t delete_range() method bounds")
+   {
+      size_t n{ 0 };
+      REQUIRE(plain.delete_range(txn, make_key(10), make_key(20), n, range_bounds_t::closed).ok());
+      REQUIRE(n == 11);
+      REQUIRE(plain.delete_range(txn, make_key(30), make_key(40), n, range_bounds_t::open).ok());
+      REQUIRE(n == 9);
+      REQUIRE(plain.delete_range(txn, make_key(50), make_key(60), n, range_bounds_t::open_closed).ok());
+      REQUIRE(n == 10);
+      REQUIRE(plain.delete_range(txn, make_key(60), make_key(50), n).ok());
+      REQUIRE(n == 0);
+      REQUIRE(plain.delete_range(txn, make_key(9999), "z", n, range_bounds_t::open).ok());
+      REQUIRE(n == 0);
+      REQUIRE(plain.entries(txn) == 10000 - 30);
+   }
+   SECTION("Test store_t delete_range() method frees the pages of the range")
+   {
+      size_t n{ 0 };
+      MDB_stat before, after;
+      REQUIRE(mdb_stat(txn.handle(), counted.handle(), &before) == MDB_SUCCESS);
+      REQUIRE(counted.delete_range(txn, make_key(10), make_key(9990), n).ok());
+      REQUIRE(n == 9980);
+      REQUIRE(mdb_stat(txn.handle(), counted.handle(), &after) == MDB_SUCCESS);
+      REQUIRE(before.ms_leaf_pages > 200);
+      REQUIRE(after.ms_leaf_pages + after.ms_branch_pages <= 3);
+      REQUIRE(counted.rank(txn, make_key(9990), n).ok());
+      REQUIRE(n == 10);
+      REQUIRE(txn.commit().ok());
+      REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+      REQUIRE(counted.entries(txn) == 20);
+   }
+   SECTION("Test store_t delete_range() method on the whole store")
+   {
+      size_t n{ 0 };
+      REQUIRE(plain.delete_range(txn, "", "z", n).ok());
+      REQUIRE(n == 10000);
+      REQUIRE(plain.entries(txn) == 0);
+      REQUIRE(plain.delete_range(txn, "", "z", n).ok());
+      REQUIRE(n == 0);
+      REQUIRE(plain.put(txn, "a", "a").ok());
+      REQUIRE(plain.entries(txn) == 1);
+   }
+   REQUIRE(txn.commit().ok());
+   REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+   REQUIRE(plain.drop(txn).ok());
+   REQUIRE(counted.drop(txn).ok());
+   REQUIRE(txn.commit().ok());
+}
+
+TEST_CASE("lmdbpp.h store_t aggregate tests", "[store_t]")
+{
+   std::string path(".\\");
+   database_t env;
+   REQUIRE(env.initialize(path).ok());
+   transaction_t txn(env);
+   REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+   store_t plain(env), fixed(env);
+   REQUIRE(plain.create(txn, "aggregate.dbm").ok());
+   REQUIRE(fixed.create(txn, "aggregate-fixed.dbm", MDB_DUPSORT | MDB_DUPFIXED).ok());
+   std::map<std::string, int64_t> values;
+   for (unsigned int i = 0; i < 20000; ++i)
+   {
+      char key[16];
+      std::snprintf(key, sizeof(key), "k%05u", i);
+      int64_t value = static_cast<int64_t>(i * 7919 % 1000) - 500;
+      values[key] = value;
+      REQUIRE(plain.put(txn, key, std::string_view((const char*)&value, sizeof(value))).ok());
+   }
+   for (unsigned int i = 0; i < 200; ++i)
+   {
+      char key[16];
+      std::snprintf(key, sizeof(key), "d%03u", i);
+      // one duplicate for the first key, several leaf pages worth for the others
+      for (uint32_t j = 0; j < (i == 0 ? 1u : 2000u); ++j)
+      {
+         uint32_t value = i + j * 3;
+         REQUIRE(fixed.put(txn, key, std::string_view((const char*)&value, sizeof(value))).ok());
+      }
+   }
+   REQUIRE(txn.commit().ok());
+   REQUIRE(txn.begin(transaction_type_t::read_only).ok());
+
+   auto expected = [&values](const std::string& lo, const std::string& hi)
+   {
+      aggregate_t<int64_t> agg;
+      for (auto it = values.lower_bound(lo); it != values.end() && it->first < hi; ++it)
+      {
+         agg.add(&it->second, 1);
+      }
+      return agg;
+   };
+
+   SECTION("Test store_t aggregate() method")
+   {
+      aggregate_t<int64_t> agg;
+      REQUIRE(plain.aggregate(txn, "", "z", agg).ok());
+      aggregate_t<int64_t> all = expected("", "z");
+      REQUIRE(agg.count == 20000);
+      REQUIRE(agg.sum == all.sum);
+      REQUIRE(agg.minimum == -500);
+      REQUIRE(agg.maximum == 499);
+      REQUIRE(plain.aggregate(txn, "k01234", "k05678", agg).ok());
+      aggregate_t<int64_t> part = expected("k01234", "k05678");
+      REQUIRE(agg.count == 4444);
+      REQUIRE(agg.sum == part.sum);
+      REQUIRE(agg.minimum == part.minimum);
+      REQUIRE(agg.maximum == part.maximum);
+      REQUIRE(plain.aggregate(txn, "k01234", "k05678", agg, range_bounds_t::closed).ok());
+      REQUIRE(agg.count == 4445);
+      REQUIRE(plain.aggregate(txn, "k01234", "k05678", agg, range_bounds_t::open).ok());
+      REQUIRE(agg.count == 4443);
+      REQUIRE(agg.sum == part.sum - values["k01234"]);
+      REQUIRE(plain.aggregate(txn, "k05678", "k01234", agg).ok());
+      REQUIRE(agg.count == 0);
+      REQUIRE(agg.mean() == 0.0);
+   }
+   SECTION("Test store_t aggregate() method with threads")
+   {
+      aggregate_t<int64_t> one, four;
+      REQUIRE(plain.aggregate(txn, "k00100", "k19900", one).ok());
+      REQUIRE(plain.aggregate(txn, "k00100", "k19900", four, range_bounds_t::closed_open, 4).ok());
+      REQUIRE(four.count == one.count);
+      REQUIRE(four.sum == one.sum);
+      REQUIRE(four.minimum == one.minimum);
+      REQUIRE(four.maximum == one.maximum);
+      aggregate_t<uint32_t> fixed_one, fixed_four;
+      REQUIRE(fixed.aggregate(txn, "", "z", fixed_one).ok());
+      REQUIRE(fixed.aggregate(txn, "", "z", fixed_four, range_bounds_t::closed_open, 4).ok());
+      REQUIRE(fixed_four.count == fixed_one.count);
+      REQUIRE(fixed_four.sum == fixed_one.sum);
+      // a read-write transaction reduces on the calling thread only
+      txn.abort();
+      REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+      REQUIRE(plain.aggregate(txn, "k00100", "k19900", four, range_bounds_t::closed_open, 4).ok());
+      REQUIRE(four.sum == one.sum);
+   }
+   SECTION("Test store_t aggregate() method over duplicates")
+   {
+      aggregate_t<uint32_t> agg;
+      REQUIRE(fixed.aggregate(txn, "", "z", agg).ok());
+      uint64_t sum{ 0 };
+      for (uint32_t i = 1; i < 200; ++i)
+      {
+         sum += 2000ull * i + 3ull * (1999ull * 2000ull / 2);
+      }
+      REQUIRE(agg.count == 1 + 199 * 2000);
+      REQUIRE(agg.sum == sum);
+      REQUIRE(agg.minimum == 0);
+      REQUIRE(agg.maximum == 199 + 1999 * 3);
+      REQUIRE(fixed.aggregate(txn, "d001", "d002", agg, range_bounds_t::closed).ok());
+      REQUIRE(agg.count == 4000);
+      REQUIRE(fixed.aggregate(txn, "d000", "d001", agg).ok());
+      REQUIRE(agg.count == 1);
+      REQUIRE(agg.sum == 0);
+      REQUIRE(fixed.aggregate(txn, "d000", "d002", agg, range_bounds_t::open).ok());
+      REQUIRE(agg.count == 2000);
+      REQUIRE(agg.minimum == 1);
+   }
+   SECTION("Test store_t count_if() method")
+   {
+      size_t n{ 0 };
+      REQUIRE(plain.count_if<int64_t>(txn, "", "z", [](int64_t value) { return value < 0; }, n).ok());
+      size_t negative = std::count_if(values.begin(), values.end(), [](const auto& kv) { return kv.second < 0; });
+      REQUIRE(n == negative);
+      std::atomic<size_t> calls{ 0 };
+      REQUIRE(plain.count_if<int64_t>(txn, "", "z", [&calls](int64_t value) { ++calls; return value < 0; }, n, range_bounds_t::closed_open, 3).ok());
+      REQUIRE(n == negative);
+      REQUIRE(calls == 20000);
+      REQUIRE(fixed.count_if<uint32_t>(txn, "d100", "d200", [](uint32_t value) { return value % 2 == 0; }, n).ok());
+      REQUIRE(n == 100 * 1000);
+   }
+   SECTION("Test store_t aggregate() method with the wrong value size")
+   {
+      aggregate_t<int32_t> agg;
+      REQUIRE(plain.aggregate(txn, "", "z", agg).error() == MDB_BAD_VALSIZE);
+      REQUIRE(fixed.aggregate(txn, "", "z", agg, range_bounds_t::closed_open, 4).ok());
+      aggregate_t<int16_t> small;
+      REQUIRE(fixed.aggregate(txn, "", "z", small).error() == MDB_BAD_VALSIZE);
+   }
+   txn.abort();
+   REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+   REQUIRE(plain.drop(txn).ok());
+   REQUIRE(fixed.drop(txn).ok());
+   REQUIRE(txn.commit().ok());
+}
+
+TEST_CASE("lmdbpp.h batch_t class tests", "[batch_t]")
+{
+   std::string path(".\\");
+   database_t env;
+   REQUIRE(env.initialize(path).ok());
+   transaction_t txn(env);
+   REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+   store_t first(env), second(env);
+   REQUIRE(first.create(txn, "batch1.dbm").ok());
+   REQUIRE(second.create(txn, "batch2.dbm").ok());
+   REQUIRE(first.put(txn, "m", "m record").ok());
+   REQUIRE(first.put(txn, "n", "n record").ok());
+   batch_t batch;
+   std::string key, value;
+
+   SECTION("Test batch_t apply() method coalescing")
+   {
+      batch.put(first, "b", "b1");
+      batch.put(second, "b", "second b");
+      batch.put(first, "a", "a1");
+      batch.put(first, "b", "b2");
+      batch.put(first, "c", "c1");
+      batch.del(first, "c");
+      batch.del(first, "m");
+      batch.put(first, "m", "m2");
+      batch.del(first, "n");
+      batch.del(first, "x");
+      batch.put(first, "z", "z1");
+      REQUIRE(batch.size() == 11);
+      REQUIRE(batch.apply(txn).ok());
+      REQUIRE(batch.empty());
+      REQUIRE(first.entries(txn) == 4);
+      REQUIRE(second.entries(txn) == 1);
+      REQUIRE(first.get(txn, "a", key, value).ok());
+      REQUIRE(value == "a1");
+      REQUIRE(first.get(txn, "b", key, value).ok());
+      REQUIRE(value == "b2");
+      REQUIRE(first.get(txn, "c", key, value).error() == MDB_NOTFOUND);
+      REQUIRE(first.get(txn, "m", key, value).ok());
+      REQUIRE(value == "m2");
+      REQUIRE(first.get(txn, "n", key, value).error() == MDB_NOTFOUND);
+      REQUIRE(first.get(txn, "z", key, value).ok());
+      REQUIRE(second.get(txn, "b", key, value).ok());
+      REQUIRE(value == "second b");
+   }
+   SECTION("Test batch_t apply() method with random keys")
+   {
+      std::mt19937 rng(58);
+      std::map<std::string, std::string> expected{ { "m", "m record" }, { "n", "n record" } };
+      for (int i = 0; i < 5000; ++i)
+      {
+         char buf[16];
+         std::snprintf(buf, sizeof(buf), "%c%04u", 'a' + int(rng() % 26), unsigned(rng() % 500));
+         if (rng() % 4 == 0)
+         {
+            batch.del(first, buf);
+            expected.erase(buf);
+         }
+         else
+         {
+            batch.put(first, buf, std::to_string(i));
+            expected[buf] = std::to_string(i);
+         }
+      }
+      REQUIRE(batch.apply(txn).ok());
+      REQUIRE(first.entries(txn) == expected.size());
+      std::map<std::string, std::string> actual;
+      REQUIRE(first.scan_range(txn, "a", "z~", [&actual](std::string_view k, std::string_view v) { actual.emplace(k, v); }).ok());
+      REQUIRE(actual == expected);
+   }
+   SECTION("Test batch_t apply() method with a MDB_DUPSORT store")
+   {
+      store_t dups(env);
+      REQUIRE(dups.create(txn, "batch3.dbm", MDB_DUPSORT).ok());
+      REQUIRE(dups.put(txn, "k", "a").ok());
+      REQUIRE(dups.put(txn, "k", "b").ok());
+      REQUIRE(dups.put(txn, "m", "a").ok());
+      // every value put is kept, and a delete removes all the values of a key
+      batch.put(dups, "x", "1");
+      batch.put(dups, "x", "2");
+      batch.put(dups, "x", "1");
+      batch.del(dups, "k");
+      batch.put(dups, "m", "b");
+      batch.del(dups, "m");
+      batch.put(dups, "m", "c");
+      batch.put(dups, "z", "1");
+      batch.put(dups, "z", "2");
+      REQUIRE(batch.apply(txn).ok());
+      std::vector<std::pair<std::string, std::string>> entries;
+      MDB_cursor* cursor{ nullptr };
+      MDB_val k, v;
+      REQUIRE(mdb_cursor_open(txn.handle(), dups.handle(), &cursor) == MDB_SUCCESS);
+      while (mdb_cursor_get(cursor, &k, &v, MDB_NEXT) == MDB_SUCCESS)
+      {
+         entries.emplace_back(std::string((const char*)k.mv_data, k.mv_size), std::string((const char*)v.mv_data, v.mv_size));
+      }
+      mdb_cursor_close(cursor);
+      REQUIRE(entries == std::vector<std::pair<std::string, std::string>>{ { "m", "c" }, { "x", "1" }, { "x", "2" }, { "z", "1" }, { "z", "2" } });
+   }
+   SECTION("Test batch_t apply() method with a closed store")
+   {
+      store_t closed(env);
+      batch.put(closed, "a", "a");
+      REQUIRE(batch.apply(txn).error() == MDB_NOT_OPEN);
+      REQUIRE(batch.size() == 1);
+   }
+   txn.abort();
+}
+
+TEST_CASE("lmdbpp.h sequence_t class tests", "[sequence_t]")
+{
+   std::string path(".\\");
+   database_t env;
+   REQUIRE(env.initialize(path).ok());
+   transaction_t txn(env);
+   REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+   store_t counters(env), rows(env);
+   REQUIRE(counters.create(txn, "sequences.dbm").ok());
+   REQUIRE(rows.create(txn, "rows.dbm").ok());
+   REQUIRE(txn.commit().ok());
+
+   SECTION("Test sequence_t next() method")
+   {
+      uint64_t id{ 0 };
+      {
+         sequence_t seq(counters, "orders", 1000);
+         for (uint64_t expected = 1; expected <= 2500; ++expected)
+         {
+            REQUIRE(seq.next(id).ok());
+            REQUIRE(id == expected);
+         }
+         REQUIRE(seq.available() == 500);
+      }
+      // the ids left in the last block are skipped
+      sequence_t seq(counters, "orders", 1000);
+      REQUIRE(seq.available() == 0);
+      REQUIRE(seq.next(id).ok());
+      REQUIRE(id == 3001);
+      sequence_t other(counters, "invoices", 10);
+      REQUIRE(other.next(id).ok());
+      REQUIRE(id == 1);
+   }
+   SECTION("Test sequence_t next() method with a bad counter")
+   {
+      uint64_t id{ 0 };
+      REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+      REQUIRE(counters.put(txn, "broken", "abc").ok());
+      REQUIRE(txn.commit().ok());
+      sequence_t seq(counters, "broken", 1000);
+      REQUIRE(seq.next(id).error() == MDB_BAD_VALSIZE);
+      REQUIRE(seq.available() == 0);
+      // the value is left alone
+      std::string_view value;
+      REQUIRE(txn.begin(transaction_type_t::read_only).ok());
+      REQUIRE(counters.get(txn, "broken", value).ok());
+      REQUIRE(value == "abc");
+      REQUIRE(txn.commit().ok());
+   }
+   SECTION("Test sequence_t from many threads")
+   {
+      sequence_t seq(counters, "orders", 64);
+      std::vector<std::vector<uint64_t>> ids(4);
+      std::vector<std::thread> workers;
+      for (size_t t = 0; t < ids.size(); ++t)
+      {
+         workers.emplace_back([&, t]()
+         {
+            uint64_t id;
+            for (int i = 0; i < 500 && seq.next(id).ok(); ++i)
+            {
+               ids[t].push_back(id);
+            }
+         });
+      }
+      for (std::thread& worker : workers)
+      {
+         worker.join();
+      }
+      std::vector<uint64_t> all;
+      for (auto& list : ids)
+      {
+         REQUIRE(list.size() == 500);
+         REQUIRE(std::is_sorted(list.begin(), list.end()));
+         all.insert(all.end(), list.begin(), list.end());
+      }
+      std::sort(all.begin(), all.end());
+      REQUIRE(std::adjacent_find(all.begin(), all.end()) == all.end());
+      REQUIRE(all.front() == 1);
+      REQUIRE(all.back() <= 2000 + 64 * ids.size());
+   }
+   SECTION("Test sequence_t key() with store_t append() method")
+   {
+      constexpr auto key = sequence_t::key(258);
+      static_assert(key[6] == 1 && key[7] == 2);
+      REQUIRE(sequence_t::id(std::string_view(key.data(), key.size())) == 258);
+      sequence_t seq(counters, "rows");
+      REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+      for (uint64_t id : { 300, 1, 2, 1000, 20 })
+      {
+         auto k = sequence_t::key(id);
+         REQUIRE(rows.append(txn, std::string_view(k.data(), k.size()), std::to_string(id)).ok());
+      }
+      auto k = sequence_t::key(2);
+      REQUIRE(rows.append(txn, std::string_view(k.data(), k.size()), "two").ok());
+      std::vector<uint64_t> order;
+      {
+         cursor_t cursor(txn, rows);
+         std::string ck, cv;
+         for (status_t status = cursor.first(ck, cv); status.ok(); status = cursor.next(ck, cv))
+         {
+            order.push_back(sequence_t::id(ck));
+         }
+      }
+      REQUIRE(order == std::vector<uint64_t>{ 1, 2, 20, 300, 1000 });
+      std::string_view value;
+      REQUIRE(rows.get(txn, std::string_view(k.data(), k.size()), value).ok());
+      REQUIRE(value == "two");
+      REQUIRE(txn.commit().ok());
+   }
+   REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+   REQUIRE(counters.drop(txn).ok());
+   REQUIRE(rows.drop(txn).ok());
+   REQUIRE(txn.commit().ok());
+}
+
+TEST_CASE("lmdbpp.h optimistic_transaction_t class tests", "[optimistic_transaction_t]")
+{
+   std::string path(".\\");
+   database_t env;
+   REQUIRE(env.initialize(path).ok());
+   transaction_t txn(env);
+   REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+   store_t tb(env);
+   REQUIRE(tb.create(txn, "optimistic.dbm").ok());
+   REQUIRE(tb.put(txn, "counter", "0").ok());
+   REQUIRE(txn.commit().ok());
+   optimistic_transaction_t update(env);
+   std::string value;
+
+   SECTION("Test optimistic_transaction_t get() sees its own writes")
+   {
+      std::string_view v;
+      REQUIRE(update.begin().ok());
+      REQUIRE(update.get(tb, "counter", v).ok());
+      REQUIRE(v == "0");
+      update.put(tb, "counter", "1");
+      update.put(tb, "other", "x");
+      update.del(tb, "other");
+      REQUIRE(update.get(tb, "counter", v).ok());
+      REQUIRE(v == "1");
+      REQUIRE(update.get(tb, "other", v).error() == MDB_NOTFOUND);
+      REQUIRE(update.commit().ok());
+      REQUIRE(update.commit().error() == MDB_TRANSACTION_HANDLE_NULL);
+      REQUIRE(txn.begin(transaction_type_t::read_only).ok());
+      REQUIRE(tb.get(txn, "counter", v).ok());
+      REQUIRE(v == "1");
+      REQUIRE(tb.get(txn, "other", v).error() == MDB_NOTFOUND);
+      txn.abort();
+   }
+   SECTION("Test optimistic_transaction_t with a MDB_DUPSORT store")
+   {
+      store_t dups(env);
+      std::string_view v;
+      REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+      REQUIRE(dups.create(txn, "optimistic-dups.dbm", MDB_DUPSORT).ok());
+      REQUIRE(dups.put(txn, "k", "a").ok());
+      REQUIRE(txn.commit().ok());
+      // the values of a key can't be read through the batch, but they can be written
+      REQUIRE(update.begin().ok());
+      REQUIRE(update.get(dups, "k", v).error() == MDB_INCOMPATIBLE);
+      update.put(dups, "k", "b");
+      REQUIRE(update.commit().ok());
+      REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+      REQUIRE(dups.entries(txn) == 2);
+      REQUIRE(dups.drop(txn).ok());
+      REQUIRE(txn.commit().ok());
+   }
+   SECTION("Test optimistic_transaction_t commit() conflicts")
+   {
+      // a value read changes
+      REQUIRE(update.begin().ok());
+      REQUIRE(update.get(tb, "counter", value).ok());
+      update.put(tb, "counter", "from update");
+      REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+      REQUIRE(tb.put(txn, "counter", "from txn").ok());
+      REQUIRE(txn.commit().ok());
+      REQUIRE(update.commit().error() == MDB_CONFLICT);
+      // a key read as missing is added
+      REQUIRE(update.begin().ok());
+      REQUIRE(update.get(tb, "missing", value).error() == MDB_NOTFOUND);
+      update.put(tb, "counter", "from update");
+      REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+      REQUIRE(tb.put(txn, "missing", "added").ok());
+      REQUIRE(txn.commit().ok());
+      REQUIRE(update.commit().error() == MDB_CONFLICT);
+      // a write to a key not read doesn't conflict
+      REQUIRE(update.begin().ok());
+      REQUIRE(update.get(tb, "counter", value).ok());
+      update.put(tb, "counter", "from update");
+      REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+      REQUIRE(tb.put(txn, "unrelated", "value").ok());
+      REQUIRE(txn.commit().ok());
+      REQUIRE(update.commit().ok());
+      std::string_view v;
+      REQUIRE(txn.begin(transaction_type_t::read_only).ok());
+      REQUIRE(tb.get(txn, "counter", v).ok());
+      REQUIRE(v == "from update");
+      txn.abort();
+   }
+   SECTION("Test optimistic_transaction_t run() method")
+   {
+      std::atomic<size_t> failed{ 0 };
+      std::vector<std::thread> workers;
+      for (int t = 0; t < 4; ++t)
+      {
+         workers.emplace_back([&]()
+         {
+            optimistic_transaction_t increment(env);
+            for (int i = 0; i < 50; ++i)
+            {
+               status_t status = increment.run([&](optimistic_transaction_t& update)
+               {
+                  std::string count;
+                  status_t status = update.get(tb, "counter", count);
+                  if (status.ok())
+                  {
+                     std::this_thread::yield();
+                     update.put(tb, "counter", std::to_string(std::stoi(count) + 1));
+                  }
+                  return status;
+               }, 1000);
+               failed += status.nok();
+            }
+         });
+      }
+      for (std::thread& worker : workers)
+      {
+         worker.join();
+      }
+      REQUIRE(failed == 0);
+      std::string_view v;
+      REQUIRE(txn.begin(transaction_type_t::read_only).ok());
+      REQUIRE(tb.get(txn, "counter", v).ok());
+      REQUIRE(v == "200");
+      txn.abort();
+      REQUIRE(update.run([&](optimistic_transaction_t&) { return status_t(MDB_NOTFOUND); }).error() == MDB_NOTFOUND);
+   }
+   REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+   REQUIRE(tb.drop(txn).ok());
+   REQUIRE(txn.commit().ok());
+}
+
+TEST_CASE("lmdbpp.h dump_t class tests", "[dump_t]")
+{
+   auto contents = [](transaction_t& txn, store_t& store)
+   {
+      std::vector<std::pair<std::string, std::string>> entries;
+      MDB_cursor* cursor{ nullptr };
+      MDB_val k, v;
+      REQUIRE(mdb_cursor_open(txn.handle(), store.handle(), &cursor) == MDB_SUCCESS);
+      while (mdb_cursor_get(cursor, &k, &v, MDB_NEXT) == MDB_SUCCESS)
+      {
+         entries.emplace_back(std::string((const char*)k.mv_data, k.mv_size), std::string((const char*)v.mv_data, v.mv_size));
+      }
+      mdb_cursor_close(cursor);
+      return entries;
+   };
+   std::filesystem::remove_all("dump-source");
+   std::filesystem::remove_all("dump-target");
+   std::filesystem::remove_all("dump-files");
+   std::filesystem::create_directories("dump-source");
+   std::filesystem::create_directories("dump-target");
+   database_t source;
+   REQUIRE(source.initialize("dump-source").ok());
+   const char* names[] = { "plain", "dups", "counted", "empty" };
+   unsigned int flags[] = { 0, MDB_DUPSORT, MDB_COUNTED, 0 };
+   transaction_t txn(source);
+   REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+   for (size_t i = 0; i < 4; ++i)
+   {
+      store_t store(source);
+      REQUIRE(store.create(txn, names[i], flags[i]).ok());
+      for (unsigned int j = 0; j < (i == 3 ? 0u : 3000u); ++j)
+      {
+         char key[32];
+         std::snprintf(key, sizeof(key), "key-%06u", i == 1 ? j / 20 : j);
+         // every 100th value spills onto overflow pages, but duplicates are limited to the key size
+         std::string value = j % 100 == 0 && i != 1 ? std::string(5000, char('a' + j % 26)) : "value-" + std::to_string(j);
+         REQUIRE(store.put(txn, key, value).ok());
+      }
+   }
+   REQUIRE(txn.commit().ok());
+
+   SECTION("Test dump_t save() and load() methods")
+   {
+      dump_t dump(source);
+      dump_stats_t saved, loaded;
+      dump_options_t options;
+      options.threads = 4;
+      options.parts = 3;
+      REQUIRE(dump.save("dump-files", saved, options).ok());
+      REQUIRE(saved.stores == 4);
+      REQUIRE(saved.files > 4);
+      REQUIRE(saved.entries == 9000);
+      database_t target;
+      REQUIRE(target.initialize("dump-target").ok());
+      dump_t loader(target);
+      // commit often to carry duplicates across transactions
+      options.commit_bytes = 16 * 1024;
+      REQUIRE(loader.load("dump-files", loaded, options).ok());
+      REQUIRE(loaded.stores == saved.stores);
+      REQUIRE(loaded.files == saved.files);
+      REQUIRE(loaded.entries == saved.entries);
+      REQUIRE(loaded.bytes == saved.bytes);
+      transaction_t from(source), to(target);
+      REQUIRE(from.begin(transaction_type_t::read_only).ok());
+      REQUIRE(to.begin(transaction_type_t::read_only).ok());
+      for (size_t i = 0; i < 4; ++i)
+      {
+         store_t a(source), b(target);
+         unsigned int fa{ 0 }, fb{ 0 };
+         REQUIRE(a.open(from, names[i]).ok());
+         REQUIRE(b.open(to, names[i]).ok());
+         REQUIRE(mdb_dbi_flags(from.handle(), a.handle(), &fa) == MDB_SUCCESS);
+         REQUIRE(mdb_dbi_flags(to.handle(), b.handle(), &fb) == MDB_SUCCESS);
+         REQUIRE(fa == fb);
+         REQUIRE(contents(from, a) == contents(to, b));
+      }
+      store_t counted(target);
+      size_t n{ 0 };
+      REQUIRE(counted.open(to, "counted").ok());
+      REQUIRE(counted.count(to, "key-001000", "key-002000", n).ok());
+      REQUIRE(n == 1000);
+   }
+   SECTION("Test dump_t save() and load() methods with a custom order")
+   {
+      struct shortest_first_t
+      {
+         int operator()(const std::string_view& a, const std::string_view& b) const noexcept
+         {
+            return a.size() != b.size() ? (a.size() < b.size() ? -1 : 1) : a.compare(b);
+         }
+      };
+      using shortest_store_t = ordered_store_t<shortest_first_t>;
+      shortest_store_t shortest(source);
+      REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+      REQUIRE(shortest.create(txn, "shortest").ok());
+      for (unsigned int j = 0; j < 2000; ++j)
+      {
+         REQUIRE(shortest.put(txn, std::to_string(j), "value-" + std::to_string(j)).ok());
+      }
+      REQUIRE(txn.commit().ok());
+      dump_t dump(source);
+      dump_stats_t saved, loaded;
+      dump_options_t options;
+      options.parts = 3;
+      options.orders["shortest"] = shortest_store_t::comparator();
+      REQUIRE(dump.save("dump-files", saved, options).ok());
+      REQUIRE(saved.entries == 11000);
+      database_t target;
+      REQUIRE(target.initialize("dump-target").ok());
+      dump_t loader(target);
+      // in the default order the keys aren't sorted, and MDB_APPEND rejects them
+      dump_options_t plain = options;
+      plain.orders.clear();
+      REQUIRE(loader.load("dump-files", loaded, plain).error() == MDB_KEYEXIST);
+      REQUIRE(loader.load("dump-files", loaded, options).ok());
+      REQUIRE(loaded.entries == saved.entries);
+      transaction_t from(source), to(target);
+      REQUIRE(from.begin(transaction_type_t::read_only).ok());
+      REQUIRE(to.begin(transaction_type_t::read_only).ok());
+      shortest_store_t copy(target);
+      REQUIRE(copy.open(to, "shortest").ok());
+      REQUIRE(contents(from, shortest) == contents(to, copy));
+      std::string_view value;
+      REQUIRE(copy.get(to, "1000", value).ok());
+      REQUIRE(value == "value-1000");
+      from.abort();
+      REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+      REQUIRE(shortest.drop(txn).ok());
+      REQUIRE(txn.commit().ok());
+   }
+   SECTION("Test dump_t save() method without compression")
+   {
+      dump_t dump(source);
+      dump_stats_t compressed, plain;
+      dump_options_t options;
+      options.threads = 2;
+      REQUIRE(dump.save("dump-files", compressed, options).ok());
+      options.compress = false;
+      REQUIRE(dump.save("dump-files", plain, options).ok());
+      REQUIRE(plain.entries == compressed.entries);
+      REQUIRE(plain.bytes > compressed.bytes);
+      database_t target;
+      REQUIRE(target.initialize("dump-target").ok());
+      dump_t loader(target);
+      dump_stats_t loaded;
+      REQUIRE(loader.load("dump-files", loaded, options).ok());
+      REQUIRE(loaded.entries == plain.entries);
+      transaction_t from(source), to(target);
+      REQUIRE(from.begin(transaction_type_t::read_only).ok());
+      REQUIRE(to.begin(transaction_type_t::read_only).ok());
+      store_t a(source), b(target);
+      REQUIRE(a.open(from, "dups").ok());
+      REQUIRE(b.open(to, "dups").ok());
+      REQUIRE(contents(from, a) == contents(to, b));
+   }
+   SECTION("Test dump_t load() method with damaged dumps")
+   {
+      dump_t dump(source);
+      dump_stats_t stats;
+      dump_options_t options;
+      options.parts = 2;
+      REQUIRE(dump.save("dump-files", stats, options).ok());
+      std::filesystem::path part("dump-files/s00000-p00001.lmdump");
+      REQUIRE(std::filesystem::exists(part));
+      std::filesystem::resize_file(part, std::filesystem::file_size(part) - 1);
+      database_t target;
+      REQUIRE(target.initialize("dump-target").ok());
+      dump_t loader(target);
+      REQUIRE(loader.load("dump-files", stats, options).error() == MDB_BAD_DUMP);
+      std::filesystem::remove(part);
+      REQUIRE(loader.load("dump-files", stats, options).error() == MDB_BAD_DUMP);
+   }
+   source.cleanup();
+   std::filesystem::remove_all("dump-source");
+   std::filesystem::remove_all("dump-target");
+   std::filesystem::remove_all("dump-files");
+}
+
+TEST_CASE("lmdbpp.h analyzer_t class tests", "[analyzer_t]")
+{
+   std::filesystem::remove_all("analyze-test");
+   std::filesystem::create_directories("analyze-test");
+   database_t env;
+   REQUIRE(env.initialize("analyze-test", DEFAULT_MAXSTORES, 64 * 1024 * 1024).ok());
+   const char* names[] = { "big", "dups", "random", "sequential" };
+   unsigned int flags[] = { 0, MDB_DUPSORT, 0, 0 };
+   std::vector<unsigned int> order(20000);
+   for (unsigned int j = 0; j < order.size(); ++j)
+   {
+      order[j] = j;
+   }
+   std::shuffle(order.begin(), order.end(), std::mt19937(42));
+   transaction_t txn(env);
+   REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+   for (size_t i = 0; i < 4; ++i)
+   {
+      store_t store(env);
+      REQUIRE(store.create(txn, names[i], flags[i]).ok());
+      for (unsigned int j = 0; j < (i == 0 ? 100u : 20000u); ++j)
+      {
+         char key[32];
+         std::snprintf(key, sizeof(key), "key-%08u", i == 1 ? j / 1000 : i == 2 ? order[j] : j);
+         std::string value = i == 0 ? std::string(5000, 'x') : "value-" + std::to_string(j);
+         REQUIRE(store.put(txn, key, value).ok());
+      }
+   }
+   REQUIRE(txn.commit().ok());
+   // free some pages
+   REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+   store_t random(env);
+   REQUIRE(random.open(txn, "random").ok());
+   size_t deleted{ 0 };
+   REQUIRE(random.delete_range(txn, "key-00005000", "key-00015000", deleted).ok());
+   REQUIRE(deleted == 10000);
+   REQUIRE(txn.commit().ok());
+
+   SECTION("Test analyzer_t run() method")
+   {
+      analyzer_t analyzer(env);
+      analysis_t analysis;
+      analyze_options_t options;
+      options.threads = 4;
+      REQUIRE(analyzer.run(analysis, options).ok());
+      REQUIRE(analysis.page_size > 0);
+      REQUIRE(analysis.stores.size() == 4);
+      for (size_t i = 0; i < 4; ++i)
+      {
+         const page_stats_t& stats = analysis.stores[i];
+         REQUIRE(stats.name == names[i]);
+         REQUIRE(stats.page_size == analysis.page_size);
+         REQUIRE(stats.depth >= 1);
+         size_t branches{ 0 }, leaves{ 0 };
+         for (size_t b = 0; b < page_stats_t::FILL_BUCKETS; ++b)
+         {
+            branches += stats.branch_fill[b];
+            leaves += stats.leaf_fill[b];
+         }
+         REQUIRE(branches == stats.branch_pages);
+         REQUIRE(leaves == stats.leaf_pages);
+         REQUIRE(stats.leaf_fill_factor() > 0.0);
+         REQUIRE(stats.leaf_fill_factor() <= 1.0);
+      }
+      // each 5000 byte value takes two pages, the rest of the second is lost
+      const page_stats_t& big = analysis.stores[0];
+      REQUIRE(big.entries == 100);
+      REQUIRE(big.overflow_chains == 100);
+      REQUIRE(big.overflow_pages == 200);
+      REQUIRE(big.overflow_waste > 100 * (analysis.page_size * 2 - 5000 - 64));
+      REQUIRE(big.overflow_waste < 100 * (analysis.page_size * 2 - 5000));
+      const page_stats_t& dups = analysis.stores[1];
+      REQUIRE(dups.entries == 20000);
+      REQUIRE(dups.dup_pages > 0);
+      REQUIRE(dups.dup_depth >= 1);
+      REQUIRE(dups.overflow_pages == 0);
+      // keys put in order fill their pages, keys put at random split them half way
+      const page_stats_t& shuffled = analysis.stores[2];
+      const page_stats_t& sequential = analysis.stores[3];
+      REQUIRE(shuffled.entries == 10000);
+      REQUIRE(sequential.entries == 20000);
+      REQUIRE(sequential.leaf_fill_factor() > 0.9);
+      REQUIRE(shuffled.leaf_fill_factor() < sequential.leaf_fill_factor());
+      // the deleted range freed pages
+      const freelist_stats_t& freelist = analysis.freelist;
+      REQUIRE(freelist.records > 0);
+      REQUIRE(freelist.pages > 0);
+      REQUIRE(freelist.runs > 0);
+      REQUIRE(freelist.runs <= freelist.pages);
+      REQUIRE(freelist.longest_run <= freelist.pages);
+      size_t runs{ 0 };
+      for (size_t count : freelist.run_lengths)
+      {
+         runs += count;
+      }
+      REQUIRE(runs == freelist.runs);
+      // every page of the file is a meta page, in a tree or free
+      REQUIRE(2 + analysis.total().pages() + freelist.pages == analysis.file_pages);
+   }
+   txn.abort();
+   env.cleanup();
+   std::filesystem::remove_all("analyze-test");
+}
+
+TEST_CASE("lmdbpp.h timeseries_store_t class tests", "[timeseries_store_t]")
+{
+   std::string path(".\\");
+   database_t env;
+   REQUIRE(env.initialize(path).ok());
+   transaction_t txn(env);
+   REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+   timeseries_store_t ts(env);
+   REQUIRE(ts.create(txn, "metrics.dbm").ok());
+   std::vector<ts_sample_t> samples, found;
+
+   SECTION("Test timeseries_store_t append() and query() methods with regular samples")
+   {
+      // a day of samples every ten seconds, with a little jitter and slowly changing values
+      std::mt19937 rng(61);
+      int64_t time = 1700000000000;
+      double value = 20.0;
+      for (int i = 0; i < 8640; ++i)
+      {
+         time += 10000 + (rng() % 10 == 0 ? int64_t(rng() % 50) : 0);
+         if (rng() % 4 == 0)
+         {
+            value += (int(rng() % 3) - 1) * 0.5;
+         }
+         samples.push_back(ts_sample_t{ time, value });
+      }
+      REQUIRE(ts.append(txn, "cpu", std::vector<ts_sample_t>(samples.begin(), samples.begin() + 4000)).ok());
+      for (size_t i = 4000; i < samples.size(); ++i)
+      {
+         REQUIRE(ts.append(txn, "cpu", samples[i].time, samples[i].value).ok());
+      }
+      REQUIRE(ts.append(txn, "cpu2", 0, 1.0).ok());
+      REQUIRE(txn.commit().ok());
+      REQUIRE(txn.begin(transaction_type_t::read_only).ok());
+      REQUIRE(ts.query(txn, "cpu", samples.front().time, samples.back().time + 1, found).ok());
+      REQUIRE(found.size() == samples.size());
+      for (size_t i = 0; i < samples.size(); ++i)
+      {
+         REQUIRE(found[i].time == samples[i].time);
+         REQUIRE(found[i].value == samples[i].value);
+      }
+      // one block per two hour bucket, plus the one of cpu2
+      size_t buckets = size_t(samples.back().time / ts.bucket_width() - samples.front().time / ts.bucket_width()) + 1;
+      REQUIRE(ts.blocks(txn) == buckets + 1);
+      size_t bytes{ 0 };
+      REQUIRE(ts.store().scan_prefix(txn, std::string("cpu", 4), [&bytes](std::string_view, std::string_view block) { bytes += block.size(); }).ok());
+      // sixteen bytes per sample uncompressed
+      REQUIRE(bytes * 8 < samples.size() * 16);
+
+      // a range inside one block, and one spanning blocks
+      REQUIRE(ts.query(txn, "cpu", samples[100].time, samples[200].time, found).ok());
+      REQUIRE(found.size() == 100);
+      REQUIRE(found.front().time == samples[100].time);
+      REQUIRE(ts.query(txn, "cpu", samples[700].time - 1, samples[5000].time + 1, found).ok());
+      REQUIRE(found.size() == 4301);
+      REQUIRE(found.back().time == samples[5000].time);
+      REQUIRE(ts.query(txn, "cpu", samples[200].time, samples[100].time, found).ok());
+      REQUIRE(found.empty());
+      size_t n{ 0 };
+      REQUIRE(ts.query(txn, "cpu", 0, samples.back().time + 1, [&n](int64_t, double) { return ++n < 10; }).ok());
+      REQUIRE(n == 10);
+      txn.abort();
+      REQUIRE(txn.begin(transaction_type_t::read_write).ok());
+   }
+   SECTION("Test timeseries_store_t append() and query() methods with irregular samples")
+   {
+      std::mt19937_64 rng(610);
+      std::uniform_real_distribution<double> dist(-1e6, 1e6);
+      int64_t time = -100000000;
+      for (int i = 0; i < 3000; ++i)
+      {
+         // gaps from nothing to days, and repeated timestamps
+         int64_t gap = rng() % 5 == 0 ? 0 : int64_t(rng() % (rng() % 2 ? 1000 : 200000000));
+         time += gap;
+         samples.push_back(ts_sample_t{ time, rng() % 7 == 0 ? 0.0 : dist(rng) });
+      }
+      REQUIRE(ts.append(txn, "random", samples).ok());
+      REQUIRE(ts.query(txn, "random", samples.front().time, samples.back().time + 1, found).ok());
+      REQUIRE(found.size() == samples.size());
+      for (size_t i = 0; i < samples.size(); ++i)
+      {
+         REQUIRE(found[i].time == samples[i].time);
+         REQUIRE(found[i].value == samples[i].value);
+      }
+   }
+   SECTION("Test timeseries_store_t append() method out of order")
+   {
+      REQUIRE(ts.append(txn, "s", 5000, 1.0).ok());
+      REQUIRE(ts.append(txn, "s", 4000, 1.0).error() == MDB_TS_OUT_OF_ORDER);
+      // an earlier bucket is a block of its own
+      REQUIRE(ts.append(txn, "s", -5000, 2.0).ok());
+      REQUIRE(ts.append(txn, "s", 5000, 3.0).ok());
+      REQUIRE(ts.query(txn, "s", -10000, 10000, found).ok());
+      REQUIRE(found.size() == 3);
+      REQUIRE(found[0].value == 2.0);
+      REQUIRE(found[2].value == 3.0);
+      REQUIRE(ts.append(txn, std::string("bad\0name", 8), 0, 0.0).error() == EINVAL);
+   }
+   REQUIRE(ts.drop(txn).ok());
+   REQUIRE(txn.commit().ok());
+}
@@ -31,7 +31,38 @@
 #include <string_view>
 #include <utility>
 #include <stdexcept>
+#include <cstdio>
 #include <cstring>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <limits>
+#include <random>
+#include <shared_mutex>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+// with MDB_USE_SDT defined, as for mdb.c, the wrapper fires USDT probes of provider lmdbpp for
+// perf and bpftrace. Without it the probes and their arguments compile to nothing
+#ifdef MDB_USE_SDT
+#include <sys/sdt.h>
+#define LMDBPP_PROBE2(name, a, b) DTRACE_PROBE2(lmdbpp, name, a, b)
+#define LMDBPP_PROBE3(name, a, b, c) DTRACE_PROBE3(lmdbpp, name, a, b, c)
+#else
+#define LMDBPP_PROBE2(name, a, b) ((void)0)
+#define LMDBPP_PROBE3(name, a, b, c) ((void)0)
+#endif
 
 namespace lmdb {
    
@@ -41,12 +72,271 @@ namespace lmdb {
    constexpr size_t DEFAULT_MMAPSIZE = 10485760;
 
    enum class transaction_type_t { read_write, read_only, none };
+   enum class scan_direction_t { forward, reverse };
+   enum class range_bounds_t { closed, open, closed_open, open_closed };
+
+   // where the time of a commit went, see transaction_t::commit(commit_stats_t&)
+   struct commit_stats_t
+   {
+      std::chrono::nanoseconds total{ 0 };
+      std::chrono::nanoseconds update_stores{ 0 };
+      std::chrono::nanoseconds freelist_save{ 0 };
+      std::chrono::nanoseconds page_flush{ 0 };
+      std::chrono::nanoseconds sync{ 0 };
+      std::chrono::nanoseconds write_meta{ 0 };
+      size_t dirty_pages{ 0 };
+      size_t written_pages{ 0 };
+      size_t written_bytes{ 0 };
+      size_t freelist_pages{ 0 };
+   };
+
+   // approximate size of a key range, see store_t::estimate()
+   struct range_estimate_t
+   {
+      size_t entries{ 0 };
+      size_t bytes{ 0 };
+   };
+
+   // count, sum, minimum and maximum of numeric values, see store_t::aggregate()
+   template <typename T>
+   struct aggregate_t
+   {
+      static_assert(std::is_arithmetic_v<T>, "aggregate_t needs a numeric type");
+
+      using sum_type = std::conditional_t<std::is_floating_point_v<T>, double, std::conditional_t<std::is_signed_v<T>, int64_t, uint64_t>>;
+
+      size_t count{ 0 };
+      sum_type sum{ 0 };
+      T minimum{ std::numeric_limits<T>::max() };
+      T maximum{ std::numeric_limits<T>::lowest() };
+
+      // fold in n values stored back to back, which need not be aligned. Each of the LANES
+      // partial results only depends on every LANES-th value, so the compiler can keep them
+      // in vector registers
+      void add(const void* values, size_t n) noexcept
+      {
+         constexpr size_t LANES = 8;
+         const unsigned char* p = static_cast<const unsigned char*>(values);
+         sum_type sums[LANES];
+         T lows[LANES], highs[LANES];
+         for (size_t j = 0; j < LANES; ++j)
+         {
+            sums[j] = 0;
+            lows[j] = minimum;
+            highs[j] = maximum;
+         }
+         size_t i{ 0 };
+         for (; i + LANES <= n; i += LANES)
+         {
+            for (size_t j = 0; j < LANES; ++j)
+            {
+               T value;
+               std::memcpy(&value, p + (i + j) * sizeof(T), sizeof(T));
+               sums[j] += value;
+               lows[j] = value < lows[j] ? value : lows[j];
+               highs[j] = value > highs[j] ? value : highs[j];
+            }
+         }
+         for (; i < n; ++i)
+         {
+            T value;
+            std::memcpy(&value, p + i * sizeof(T), sizeof(T));
+            sums[0] += value;
+            lows[0] = value < lows[0] ? value : lows[0];
+            highs[0] = value > highs[0] ? value : highs[0];
+         }
+         for (size_t j = 0; j < LANES; ++j)
+         {
+            sum += sums[j];
+            minimum = lows[j] < minimum ? lows[j] : minimum;
+            maximum = highs[j] > maximum ? highs[j] : maximum;
+         }
+         count += n;
+      }
+
+      void merge(const aggregate_t& other) noexcept
+      {
+         count += other.count;
+         sum += other.sum;
+         minimum = other.minimum < minimum ? other.minimum : minimum;
+         maximum = other.maximum > maximum ? other.maximum : maximum;
+      }
+
+      double mean() const noexcept
+      {
+         return count ? static_cast<double>(sum) / count : 0.0;
+      }
+   };
+
+   // one sample of a time series, see timeseries_store_t
+   struct ts_sample_t
+   {
+      int64_t time{ 0 };
+      double value{ 0.0 };
+   };
+
+   // options of dump_t::save() and dump_t::load()
+   struct dump_options_t
+   {
+      // threads to use, the calling thread included
+      size_t threads{ std::max<size_t>(1, std::thread::hardware_concurrency()) };
+      // parts each store is split into by save(), 0 for one per thread
+      size_t parts{ 0 };
+      // write each key as the length it shares with the previous key and the rest of it
+      bool compress{ true };
+      // load() commits whenever this many bytes were written since the last commit
+      size_t commit_bytes{ 64 * 1024 * 1024 };
+      // the key comparison of each store with a custom order, by name, see
+      // ordered_store_t::comparator(). Both save() and load() need it
+      std::unordered_map<std::string, MDB_cmp_func*> orders;
+   };
+
+   // options of database_t::start_trace()
+   struct trace_options_t
+   {
+      // events kept for each thread, the oldest are overwritten
+      size_t events_per_thread{ 64 * 1024 };
+      // cursor scans of a store_t taking less than this are not recorded
+      std::chrono::microseconds min_scan{ 1000 };
+   };
+
+   // what dump_t::save() wrote or dump_t::load() read
+   struct dump_stats_t
+   {
+      size_t stores{ 0 };
+      size_t files{ 0 };
+      size_t entries{ 0 };
+      size_t bytes{ 0 };
+   };
+
+   // options of analyzer_t::run()
+   struct analyze_options_t
+   {
+      // threads to use, the calling thread included
+      size_t threads{ std::max<size_t>(1, std::thread::hardware_concurrency()) };
+   };
+
+   // the pages of one tree, see analyzer_t. Branch and leaf pages are counted in FILL_BUCKETS
+   // buckets by the share of the page in use, bucket i for [i, i + 1) / FILL_BUCKETS
+   struct page_stats_t
+   {
+      static constexpr size_t FILL_BUCKETS = 10;
+
+      std::string name;
+      size_t page_size{ 0 };
+      size_t entries{ 0 };
+      size_t depth{ 0 };
+      // deepest sorted-duplicate subtree of a MDB_DUPSORT store
+      size_t dup_depth{ 0 };
+      size_t branch_pages{ 0 };
+      size_t leaf_pages{ 0 };
+      // branch and leaf pages of sorted-duplicate subtrees, also counted above
+      size_t dup_pages{ 0 };
+      size_t overflow_chains{ 0 };
+      size_t overflow_pages{ 0 };
+      // bytes in use on branch and leaf pages, the page headers included
+      uint64_t branch_bytes{ 0 };
+      uint64_t leaf_bytes{ 0 };
+      // bytes after the end of the values on overflow pages
+      uint64_t overflow_waste{ 0 };
+      std::array<size_t, FILL_BUCKETS> branch_fill{};
+      std::array<size_t, FILL_BUCKETS> leaf_fill{};
+
+      size_t pages() const noexcept
+      {
+         return branch_pages + leaf_pages + overflow_pages;
+      }
+
+      // bytes in use on branch pages over their size, 0 without branch pages
+      double branch_fill_factor() const noexcept
+      {
+         return branch_pages ? double(branch_bytes) / (double(branch_pages) * double(page_size)) : 0.0;
+      }
+
+      double leaf_fill_factor() const noexcept
+      {
+         return leaf_pages ? double(leaf_bytes) / (double(leaf_pages) * double(page_size)) : 0.0;
+      }
+
+      // add the pages of other, keeping the deeper of the two depths
+      void merge(const page_stats_t& other) noexcept
+      {
+         page_size = std::max(page_size, other.page_size);
+         entries += other.entries;
+         depth = std::max(depth, other.depth);
+         dup_depth = std::max(dup_depth, other.dup_depth);
+         branch_pages += other.branch_pages;
+         leaf_pages += other.leaf_pages;
+         dup_pages += other.dup_pages;
+         overflow_chains += other.overflow_chains;
+         overflow_pages += other.overflow_pages;
+         branch_bytes += other.branch_bytes;
+         leaf_bytes += other.leaf_bytes;
+         overflow_waste += other.overflow_waste;
+         for (size_t i = 0; i < FILL_BUCKETS; ++i)
+         {
+            branch_fill[i] += other.branch_fill[i];
+            leaf_fill[i] += other.leaf_fill[i];
+         }
+      }
+   };
+
+   // the free pages of a snapshot, see analyzer_t. Runs of consecutive free pages are counted
+   // in RUN_BUCKETS buckets by length, bucket i for [2^i, 2^(i + 1)), the last one for longer
+   struct freelist_stats_t
+   {
+      static constexpr size_t RUN_BUCKETS = 16;
+
+      // records of the freelist, one for each commit that freed pages not yet reused
+      size_t records{ 0 };
+      size_t pages{ 0 };
+      size_t runs{ 0 };
+      size_t longest_run{ 0 };
+      std::array<size_t, RUN_BUCKETS> run_lengths{};
+   };
+
+   // what analyzer_t::run() found
+   struct analysis_t
+   {
+      size_t page_size{ 0 };
+      // id of the snapshot walked
+      size_t snapshot{ 0 };
+      // pages in the data file up to the last one in use, the two meta pages included
+      size_t file_pages{ 0 };
+      // the named stores, by name
+      std::vector<page_stats_t> stores;
+      // the main store, which holds the records of the named stores and any plain entries
+      page_stats_t main;
+      // the pages holding the freelist itself
+      page_stats_t freelist_tree;
+      freelist_stats_t freelist;
+
+      // every tree together: the stores, the main store and the freelist tree
+      page_stats_t total() const noexcept
+      {
+         page_stats_t sum;
+         for (const page_stats_t& store : stores)
+         {
+            sum.merge(store);
+         }
+         sum.merge(main);
+         sum.merge(freelist_tree);
+         return sum;
+      }
+   };
 
    constexpr int MDB_ALREADY_OPEN = MDB_LAST_ERRCODE + 1;
    constexpr int MDB_NOT_OPEN = MDB_LAST_ERRCODE + 2;
    constexpr int MDB_TRANSACTION_HANDLE_NULL = MDB_LAST_ERRCODE + 3;
    constexpr int MDB_TRANSACTION_ALREADY_STARTED = MDB_LAST_ERRCODE + 4;
    constexpr int MDB_INVALID_TRANSACTION_TYPE = MDB_LAST_ERRCODE + 5;
+   constexpr int MDB_SYNC_TIMEOUT = MDB_LAST_ERRCODE + 6;
+   constexpr int MDB_SYNC_NOT_STARTED = MDB_LAST_ERRCODE + 7;
+   constexpr int MDB_TS_OUT_OF_ORDER = MDB_LAST_ERRCODE + 8;
+   constexpr int MDB_BAD_DUMP = MDB_LAST_ERRCODE + 9;
+   constexpr int MDB_CONFLICT = MDB_LAST_ERRCODE + 10;
+   constexpr int MDB_TRACE_NOT_STARTED = MDB_LAST_ERRCODE + 11;
+   constexpr int MDB_STORE_PENDING = MDB_LAST_ERRCODE + 12;
 
    class status_t
    {
@@ -94,6 +384,13 @@ namespace lmdb {
          case MDB_TRANSACTION_HANDLE_NULL: return "Transaction handle not initialized";
          case MDB_TRANSACTION_ALREADY_STARTED: return "Transaction already started";
          case MDB_INVALID_TRANSACTION_TYPE: return "Invalid transaction type";
+         case MDB_SYNC_TIMEOUT: return "Timed out waiting for transaction to become durable";
+         case MDB_SYNC_NOT_STARTED: return "Periodic sync not started";
+         case MDB_TS_OUT_OF_ORDER: return "Sample is older than the last sample of its time bucket";
+         case MDB_BAD_DUMP: return "Dump file is invalid or incomplete";
+         case MDB_CONFLICT: return "A value read by the transaction changed before it committed";
+         case MDB_TRACE_NOT_STARTED: return "Trace not started";
+         case MDB_STORE_PENDING: return "Store opened by a write transaction that has not ended";
          }
          return mdb_strerror(error_);
       }
@@ -113,11 +410,338 @@ namespace lmdb {
       status_t status() const { return status_; }
    };
 
+   // records timed events of transactions and store scans into a ring buffer per thread, which
+   // only its thread writes to, and writes them in the Chrome trace event format, for
+   // chrome://tracing or ui.perfetto.dev. Events are complete events with a start and a
+   // duration, so a ring that wrapped around has no unmatched begin or end
+   class tracer_t
+   {
+      struct event_t
+      {
+         const char* name;
+         const char* arg_name;
+         uint64_t start;
+         uint64_t duration;
+         uint64_t arg;
+      };
+
+      // one event of a ring. seq is odd while event n is written and 2 * n + 2 once it is, so
+      // write() can copy a slot while its thread records and drop the copy if seq changed
+      struct slot_t
+      {
+         std::atomic<uint64_t> seq{ 0 };
+         std::atomic<const char*> name{ nullptr };
+         std::atomic<const char*> arg_name{ nullptr };
+         std::atomic<uint64_t> start{ 0 };
+         std::atomic<uint64_t> duration{ 0 };
+         std::atomic<uint64_t> arg{ 0 };
+      };
+
+      struct ring_t
+      {
+         std::unique_ptr<slot_t[]> slots;
+         std::atomic<uint64_t> count{ 0 };
+         std::thread::id owner;
+         size_t thread{ 0 };
+      };
+
+      inline static std::atomic<uint64_t> next_id_{ 1 };
+      const uint64_t id_;
+      const size_t capacity_;
+      const uint64_t min_scan_;
+      const std::chrono::steady_clock::time_point origin_;
+      std::atomic<bool> enabled_{ true };
+      std::mutex mutex_;
+      std::vector<std::unique_ptr<ring_t>> rings_;
+
+   public:
+      explicit tracer_t(const trace_options_t& options)
+         : id_{ next_id_++ }
+         , capacity_{ std::max<size_t>(1, options.events_per_thread) }
+         , min_scan_{ static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(options.min_scan).count()) }
+         , origin_{ std::chrono::steady_clock::now() }
+      {}
+
+      // nanoseconds since the tracer was created
+      uint64_t now() const noexcept
+      {
+         return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - origin_).count());
+      }
+
+      bool enabled() const noexcept
+      {
+         return enabled_.load(std::memory_order_relaxed);
+      }
+
+      void stop() noexcept
+      {
+         enabled_ = false;
+      }
+
+      uint64_t min_scan() const noexcept
+      {
+         return min_scan_;
+      }
+
+      // record an event of the calling thread that started at start, see now(), and lasted
+      // duration nanoseconds. name and arg_name must outlive the tracer, e.g. string literals
+      void record(const char* name, uint64_t start, uint64_t duration, const char* arg_name = nullptr, uint64_t arg = 0) noexcept
+      {
+         ring_t* ring;
+         if (!enabled() || (ring = thread_ring()) == nullptr)
+         {
+            return;
+         }
+         uint64_t n = ring->count.load(std::memory_order_relaxed);
+         slot_t& slot = ring->slots[n % capacity_];
+         slot.seq.store(2 * n + 1, std::memory_order_relaxed);
+         std::atomic_thread_fence(std::memory_order_release);
+         slot.name.store(name, std::memory_order_relaxed);
+         slot.arg_name.store(arg_name, std::memory_order_relaxed);
+         slot.start.store(start, std::memory_order_relaxed);
+         slot.duration.store(duration, std::memory_order_relaxed);
+         slot.arg.store(arg, std::memory_order_relaxed);
+         slot.seq.store(2 * n + 2, std::memory_order_release);
+         ring->count.store(n + 1, std::memory_order_release);
+      }
+
+      // the events kept, at most events_per_thread for each thread
+      size_t events() noexcept
+      {
+         size_t total{ 0 };
+         std::lock_guard<std::mutex> lock(mutex_);
+         for (const auto& ring : rings_)
+         {
+            total += static_cast<size_t>(std::min<uint64_t>(ring->count, capacity_));
+         }
+         return total;
+      }
+
+      // write the events kept as a JSON trace. The threads are numbered in the order they
+      // recorded their first event. Threads may go on recording meanwhile: an event that is
+      // overwritten while it is copied is left out
+      status_t write(const std::string& path)
+      {
+         std::ofstream out(path, std::ios::binary | std::ios::trunc);
+         if (!out)
+         {
+            return status_t(errno ? errno : EIO);
+         }
+         std::lock_guard<std::mutex> lock(mutex_);
+         const char* separator = "";
+         char line[256];
+         out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+         for (const auto& ring : rings_)
+         {
+            std::snprintf(line, sizeof(line), "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%zu,\"args\":{\"name\":\"thread %zu\"}}",
+               separator, ring->thread, ring->thread);
+            out << line;
+            separator = ",";
+            uint64_t count = ring->count.load(std::memory_order_acquire);
+            for (uint64_t i = count > capacity_ ? count - capacity_ : 0; i < count; ++i)
+            {
+               event_t e;
+               if (!read(ring->slots[i % capacity_], i, e))
+               {
+                  continue;
+               }
+               int n = std::snprintf(line, sizeof(line), ",\n{\"name\":\"%s\",\"cat\":\"lmdb\",\"ph\":\"X\",\"pid\":1,\"tid\":%zu,\"ts\":%llu.%03llu,\"dur\":%llu.%03llu",
+                  e.name, ring->thread, (unsigned long long)(e.start / 1000), (unsigned long long)(e.start % 1000),
+                  (unsigned long long)(e.duration / 1000), (unsigned long long)(e.duration % 1000));
+               if (e.arg_name && n > 0 && static_cast<size_t>(n) < sizeof(line))
+               {
+                  std::snprintf(line + n, sizeof(line) - n, ",\"args\":{\"%s\":%llu}", e.arg_name, (unsigned long long)e.arg);
+               }
+               out << line << '}';
+            }
+         }
+         out << "\n]}\n";
+         out.close();
+         return status_t(out ? MDB_SUCCESS : EIO);
+      }
+
+   private:
+      // copy event i out of its slot, false if it was overwritten or is being written
+      static bool read(const slot_t& slot, uint64_t i, event_t& e) noexcept
+      {
+         uint64_t seq = slot.seq.load(std::memory_order_acquire);
+         if (seq != 2 * i + 2)
+         {
+            return false;
+         }
+         e.name = slot.name.load(std::memory_order_relaxed);
+         e.arg_name = slot.arg_name.load(std::memory_order_relaxed);
+         e.start = slot.start.load(std::memory_order_relaxed);
+         e.duration = slot.duration.load(std::memory_order_relaxed);
+         e.arg = slot.arg.load(std::memory_order_relaxed);
+         std::atomic_thread_fence(std::memory_order_acquire);
+         return slot.seq.load(std::memory_order_relaxed) == seq;
+      }
+
+      // the ring of the calling thread, created on its first event. The last ring used is
+      // cached per thread, and found again under the lock when several tracers are in use
+      ring_t* thread_ring() noexcept
+      {
+         thread_local uint64_t cached_id{ 0 };
+         thread_local ring_t* cached_ring{ nullptr };
+         if (cached_id == id_)
+         {
+            return cached_ring;
+         }
+         std::thread::id self = std::this_thread::get_id();
+         std::lock_guard<std::mutex> lock(mutex_);
+         ring_t* ring{ nullptr };
+         for (const auto& r : rings_)
+         {
+            if (r->owner == self)
+            {
+               ring = r.get();
+               break;
+            }
+         }
+         if (!ring)
+         {
+            try
+            {
+               auto created = std::make_unique<ring_t>();
+               created->slots = std::make_unique<slot_t[]>(capacity_);
+               created->owner = self;
+               created->thread = rings_.size() + 1;
+               rings_.push_back(std::move(created));
+               ring = rings_.back().get();
+            }
+            catch (const std::exception&)
+            {
+               return nullptr;
+            }
+         }
+         cached_id = id_;
+         cached_ring = ring;
+         return ring;
+      }
+   };
+
+   // background thread that syncs an environment opened with MDB_NOSYNC every interval, or
+   // sooner once enough bytes were committed, and tracks the last transaction known durable
+   class periodic_sync_t
+   {
+      MDB_env* envptr_;
+      std::chrono::milliseconds interval_;
+      size_t bytes_;
+      std::mutex mutex_;
+      std::condition_variable wakeup_;
+      std::condition_variable synced_;
+      size_t pending_bytes_{ 0 };
+      size_t durable_txnid_{ 0 };
+      int error_{ MDB_SUCCESS };
+      bool stop_{ false };
+      std::thread thread_;
+
+   public:
+      periodic_sync_t(MDB_env* envptr, std::chrono::milliseconds interval, size_t bytes, size_t durable_txnid)
+         : envptr_{ envptr }
+         , interval_{ interval }
+         , bytes_{ bytes }
+         , durable_txnid_{ durable_txnid }
+      {
+         thread_ = std::thread([this]() { run(); });
+      }
+
+      ~periodic_sync_t() noexcept
+      {
+         {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+         }
+         wakeup_.notify_one();
+         thread_.join();
+      }
+
+      void committed(size_t bytes) noexcept
+      {
+         bool wake{ false };
+         {
+            std::lock_guard<std::mutex> lock(mutex_);
+            pending_bytes_ += bytes;
+            wake = bytes_ > 0 && pending_bytes_ >= bytes_;
+         }
+         if (wake)
+         {
+            wakeup_.notify_one();
+         }
+      }
+
+      size_t durable_txnid() noexcept
+      {
+         std::lock_guard<std::mutex> lock(mutex_);
+         return durable_txnid_;
+      }
+
+      status_t wait(size_t txnid, std::chrono::milliseconds timeout) noexcept
+      {
+         std::unique_lock<std::mutex> lock(mutex_);
+         if (!synced_.wait_for(lock, timeout, [&]() { return durable_txnid_ >= txnid || error_ != MDB_SUCCESS; }))
+         {
+            return status_t(MDB_SYNC_TIMEOUT);
+         }
+         return status_t(durable_txnid_ >= txnid ? MDB_SUCCESS : error_);
+      }
+
+   private:
+      void run() noexcept
+      {
+         std::unique_lock<std::mutex> lock(mutex_);
+         while (!stop_)
+         {
+            wakeup_.wait_for(lock, interval_, [this]() { return stop_ || (bytes_ > 0 && pending_bytes_ >= bytes_); });
+            // anything committed up to here has been written to the file, or the map
+            // with MDB_WRITEMAP, so the sync below makes it durable
+            MDB_envinfo info;
+            mdb_env_info(envptr_, &info);
+            size_t txnid = static_cast<size_t>(info.me_last_txnid);
+            pending_bytes_ = 0;
+            if (txnid <= durable_txnid_)
+            {
+               continue;
+            }
+            lock.unlock();
+            LMDBPP_PROBE2(sync__start, envptr_, txnid);
+            int rc = mdb_env_sync(envptr_, 1);
+            LMDBPP_PROBE3(sync__done, envptr_, txnid, rc);
+            lock.lock();
+            if (rc == MDB_SUCCESS)
+            {
+               durable_txnid_ = txnid;
+               error_ = MDB_SUCCESS;
+            }
+            else
+            {
+               error_ = rc;
+            }
+            synced_.notify_all();
+         }
+      }
+   };
+
    class database_t
    {
+      // named store handles, opened once and shared by every store_t, see open_catalog()
+      struct catalog_t
+      {
+         std::shared_mutex mutex;
+         std::unordered_map<std::string, MDB_dbi> handles;
+         std::vector<std::pair<std::string, MDB_dbi>> ids;
+         // stores first opened by a write transaction that has not ended, and that
+         // transaction. Their handles are closed if it aborts
+         std::unordered_map<std::string, MDB_txn*> pending;
+      };
+
       MDB_env* envptr_{ nullptr };
       size_t max_store_{ 0 };
       size_t mmap_size_{ 0 };
+      std::unique_ptr<periodic_sync_t> sync_;
+      std::unique_ptr<catalog_t> catalog_;
+      std::unique_ptr<tracer_t> tracer_;
 
    public:
       database_t() = default;
@@ -141,6 +765,9 @@ namespace lmdb {
          : envptr_{ other.envptr_ }
          , max_store_{ other.max_store_ }
          , mmap_size_{ other.mmap_size_ }
+         , sync_{ std::move(other.sync_) }
+         , catalog_{ std::move(other.catalog_) }
+         , tracer_{ std::move(other.tracer_) }
       {
          other.envptr_ = nullptr;
          other.max_store_ = 0;
@@ -151,6 +778,9 @@ namespace lmdb {
       {
          if (this != &other)
          {
+            sync_ = std::move(other.sync_);
+            catalog_ = std::move(other.catalog_);
+            tracer_ = std::move(other.tracer_);
             envptr_ = other.envptr_;
             other.envptr_ = nullptr;
             max_store_ = other.max_store_;
@@ -186,11 +816,15 @@ namespace lmdb {
          }
          max_store_ = max_stores;
          mmap_size_ = mmap_size;
+         catalog_ = std::make_unique<catalog_t>();
          return status;
       }
 
       void cleanup() noexcept
       {
+         stop_periodic_sync();
+         catalog_.reset();
+         tracer_.reset();
          if (envptr_)
          {
             mdb_env_close(envptr_);
@@ -202,7 +836,7 @@ namespace lmdb {
       int check() noexcept
       {
          int dead{ 0 };
-         if (!envptr_ && (mdb_reader_check(envptr_, &dead) >= 0))
+         if (envptr_ && (mdb_reader_check(envptr_, &dead) >= 0))
          {
             return dead;
          }
@@ -215,69 +849,437 @@ namespace lmdb {
          return status_t(mdb_env_sync(envptr_, 0));
       }
 
-      std::string path() const noexcept
+      // let write transactions of this process retry the writer lock up to spins times before
+      // sleeping on it, 0 to always sleep. Pays off with many threads running short write txns
+      status_t set_writer_spin(unsigned int spins) noexcept
       {
-         const char* ptr{ nullptr };
-         if (envptr_)
+         return status_t(mdb_env_set_writespin(envptr_, spins));
+      }
+
+      // let commits return without syncing, and sync in the background every interval or once
+      // bytes were committed since the last sync, if bytes is not 0. At most one interval's worth
+      // of transactions can be lost by a system crash; durable_txnid() tells which
+      status_t start_periodic_sync(std::chrono::milliseconds interval, size_t bytes = 0) noexcept
+      {
+         status_t status;
+         MDB_envinfo info;
+         // the sync thread would never wait
+         if (interval.count() <= 0)
          {
-            int rc = mdb_env_get_path(envptr_, &ptr);
-            if (rc != MDB_SUCCESS)
-            {
-               return std::string();
-            }
+            return status_t(EINVAL);
          }
-         return std::string(ptr ? ptr : "");
+         stop_periodic_sync();
+         if (status = mdb_env_sync(envptr_, 1); status.nok())
+         {
+            return status;
+         }
+         if (status = mdb_env_info(envptr_, &info); status.nok())
+         {
+            return status;
+         }
+         if (status = mdb_env_set_flags(envptr_, MDB_NOSYNC, 1); status.nok())
+         {
+            return status;
+         }
+         try
+         {
+            sync_ = std::make_unique<periodic_sync_t>(envptr_, interval, bytes, static_cast<size_t>(info.me_last_txnid));
+         }
+         catch (const std::exception&)
+         {
+            mdb_env_set_flags(envptr_, MDB_NOSYNC, 0);
+            return status_t(ENOMEM);
+         }
+         return status;
       }
 
-      size_t max_readers() const noexcept
+      // stop the background sync, sync once more and return to syncing on every commit
+      status_t stop_periodic_sync() noexcept
       {
-         unsigned int readers{ 0 };
-         if (int rc = mdb_env_get_maxreaders(envptr_, &readers); rc != MDB_SUCCESS)
+         if (!sync_)
          {
-            return 0;
+            return status_t(MDB_SYNC_NOT_STARTED);
          }
-         return readers;
+         sync_.reset();
+         mdb_env_set_flags(envptr_, MDB_NOSYNC, 0);
+         return status_t(mdb_env_sync(envptr_, 1));
       }
 
-      size_t max_stores() const noexcept
+      // record transactions, their commit phases and long store scans of every thread, see
+      // write_trace(). Starting discards the events of an earlier trace, and like stopping must
+      // not be done while other threads use the database
+      status_t start_trace(const trace_options_t& options = trace_options_t()) noexcept
       {
-         return max_store_;
+         try
+         {
+            tracer_ = std::make_unique<tracer_t>(options);
+         }
+         catch (const std::exception&)
+         {
+            return status_t(ENOMEM);
+         }
+         return status_t();
       }
 
-      size_t mmap_size() const noexcept
+      // stop recording, keeping the events for write_trace()
+      status_t stop_trace() noexcept
       {
-         return mmap_size_;
+         if (!tracer_)
+         {
+            return status_t(MDB_TRACE_NOT_STARTED);
+         }
+         tracer_->stop();
+         return status_t();
       }
 
-      size_t max_keysize() const noexcept
+      // write the events recorded by the last trace in the Chrome trace event format. It may
+      // run while the trace records, but it leaves out events overwritten during the copy
+      status_t write_trace(const std::string& path) noexcept
       {
-         int count{ 0 };
-         if (envptr_)
+         if (!tracer_)
          {
-            count = mdb_env_get_maxkeysize(envptr_);
+            return status_t(MDB_TRACE_NOT_STARTED);
+         }
+         try
+         {
+            return tracer_->write(path);
+         }
+         catch (const std::exception&)
+         {
+            return status_t(ENOMEM);
          }
-         return size_t(count);
       }
 
-      MDB_env* handle() noexcept
+      // the tracer while a trace is recording, else nullptr
+      tracer_t* tracer() noexcept
       {
-         return envptr_;
+         return tracer_ && tracer_->enabled() ? tracer_.get() : nullptr;
       }
-   }; // class environment_t
 
-   class transaction_t
-   {
-      database_t& env_;
-      MDB_txn* txnptr_{ nullptr };
-      transaction_type_t type_{ transaction_type_t::none };
+      // the last transaction id known to be on disk, with periodic sync running
+      size_t durable_txnid() noexcept
+      {
+         return sync_ ? sync_->durable_txnid() : 0;
+      }
 
-   public:
-      transaction_t() = delete;
-      transaction_t(const transaction_t&) = delete;
-      transaction_t& operator=(const transaction_t&) = delete;
+      // wait until transaction txnid, see transaction_t::id(), has been synced to disk
+      status_t wait_durable(size_t txnid, std::chrono::milliseconds timeout) noexcept
+      {
+         if (!sync_)
+         {
+            return status_t(MDB_SYNC_NOT_STARTED);
+         }
+         return sync_->wait(txnid, timeout);
+      }
 
-      explicit transaction_t(database_t& env) noexcept
-         : env_{ env }
+      // called by transaction_t after each commit
+      void committed(size_t bytes) noexcept
+      {
+         if (sync_)
+         {
+            sync_->committed(bytes);
+         }
+      }
+
+      bool periodic_sync() const noexcept
+      {
+         return sync_ != nullptr;
+      }
+
+      // open every named store once, so that store_t::open() finds its handle here instead of
+      // calling mdb_dbi_open(). The stores named in ids must exist and can then be opened by
+      // their position in ids. Call at startup, from a thread without a read-only transaction
+      status_t open_catalog(const std::vector<std::string>& ids = std::vector<std::string>())
+      {
+         std::vector<std::string> names;
+         std::vector<std::pair<std::string, MDB_dbi>> opened;
+         MDB_txn* txnptr{ nullptr };
+         status_t status;
+         if (!catalog_)
+         {
+            return status_t(EINVAL);
+         }
+         std::unique_lock<std::shared_mutex> lock(catalog_->mutex);
+         if (status = mdb_txn_begin(envptr_, nullptr, MDB_RDONLY, &txnptr); status.nok())
+         {
+            return status;
+         }
+         if (status = list_stores(txnptr, names); status.ok())
+         {
+            names.insert(names.end(), ids.begin(), ids.end());
+            for (const std::string& name : names)
+            {
+               MDB_dbi dbi{ 0 };
+               // the main store also holds plain entries, which won't open as a store
+               if (int rc = mdb_dbi_open(txnptr, name.c_str(), 0, &dbi); rc == MDB_SUCCESS)
+               {
+                  opened.emplace_back(name, dbi);
+               }
+               else if (rc != MDB_INCOMPATIBLE || std::find(ids.begin(), ids.end(), name) != ids.end())
+               {
+                  status = rc;
+                  break;
+               }
+            }
+         }
+         if (status.nok())
+         {
+            mdb_txn_abort(txnptr);
+            return status;
+         }
+         // a read-only commit keeps the handles open for every transaction
+         if (status = mdb_txn_commit(txnptr); status.nok())
+         {
+            return status;
+         }
+         for (const auto& [name, dbi] : opened)
+         {
+            catalog_->handles[name] = dbi;
+         }
+         catalog_->ids.clear();
+         for (const std::string& name : ids)
+         {
+            catalog_->ids.emplace_back(name, catalog_->handles[name]);
+         }
+         return status;
+      }
+
+      // the handle of store name. A store not yet in the catalog is opened in a read-only
+      // transaction of its own, so the calling thread must not have one open. Fails with
+      // MDB_STORE_PENDING while a write transaction that opened the store has not ended
+      status_t open_store(const std::string& name, MDB_dbi& dbi)
+      {
+         MDB_txn* txnptr{ nullptr };
+         status_t status;
+         if (find_store(name, dbi))
+         {
+            return status;
+         }
+         if (!catalog_)
+         {
+            return status_t(EINVAL);
+         }
+         std::unique_lock<std::shared_mutex> lock(catalog_->mutex);
+         if (auto it = catalog_->handles.find(name); it != catalog_->handles.end())
+         {
+            dbi = it->second;
+            return status;
+         }
+         if (catalog_->pending.count(name))
+         {
+            return status_t(MDB_STORE_PENDING);
+         }
+         if (status = mdb_txn_begin(envptr_, nullptr, MDB_RDONLY, &txnptr); status.nok())
+         {
+            return status;
+         }
+         if (status = mdb_dbi_open(txnptr, name.c_str(), 0, &dbi); status.nok())
+         {
+            mdb_txn_abort(txnptr);
+            return status;
+         }
+         if (status = mdb_txn_commit(txnptr); status.ok())
+         {
+            catalog_->handles[name] = dbi;
+         }
+         return status;
+      }
+
+      // mdb_dbi_open() in txn, never at the same time as another call in this process. The
+      // handle joins the catalog when txn commits, see transaction_t. Until a write txn
+      // ends, other transactions can't open the store
+      status_t open_store(MDB_txn* txnptr, const std::string& name, unsigned int flags, MDB_dbi& dbi, bool write)
+      {
+         status_t status;
+         if (!catalog_)
+         {
+            return status_t(mdb_dbi_open(txnptr, name.c_str(), flags, &dbi));
+         }
+         std::unique_lock<std::shared_mutex> lock(catalog_->mutex);
+         if (auto it = catalog_->pending.find(name); it != catalog_->pending.end() && it->second != txnptr)
+         {
+            return status_t(MDB_STORE_PENDING);
+         }
+         if (status = mdb_dbi_open(txnptr, name.c_str(), flags, &dbi); status.ok() && write && !catalog_->handles.count(name))
+         {
+            catalog_->pending[name] = txnptr;
+         }
+         return status;
+      }
+
+      bool find_store(const std::string& name, MDB_dbi& dbi)
+      {
+         if (!catalog_)
+         {
+            return false;
+         }
+         std::shared_lock<std::shared_mutex> lock(catalog_->mutex);
+         if (auto it = catalog_->handles.find(name); it != catalog_->handles.end())
+         {
+            dbi = it->second;
+            return true;
+         }
+         return false;
+      }
+
+      // the store at position id of the ids given to open_catalog(). Takes no lock, the ids
+      // don't change after startup
+      bool find_store(size_t id, std::string& name, MDB_dbi& dbi) const noexcept
+      {
+         if (!catalog_ || id >= catalog_->ids.size())
+         {
+            return false;
+         }
+         name = catalog_->ids[id].first;
+         dbi = catalog_->ids[id].second;
+         return true;
+      }
+
+      // called by transaction_t for the stores opened by a transaction that committed
+      void catalog(const std::vector<std::pair<std::string, MDB_dbi>>& opened)
+      {
+         if (!catalog_ || opened.empty())
+         {
+            return;
+         }
+         std::unique_lock<std::shared_mutex> lock(catalog_->mutex);
+         for (const auto& [name, dbi] : opened)
+         {
+            catalog_->handles[name] = dbi;
+            catalog_->pending.erase(name);
+         }
+      }
+
+      // called by transaction_t to abort a write transaction, or after a failed commit
+      // aborted it, with the stores it opened. Aborting closes their handles, so it can't
+      // run while another thread opens a store
+      void abort(MDB_txn* txnptr, const std::vector<std::pair<std::string, MDB_dbi>>& opened)
+      {
+         if (!catalog_ || opened.empty())
+         {
+            if (txnptr)
+            {
+               mdb_txn_abort(txnptr);
+            }
+            return;
+         }
+         std::unique_lock<std::shared_mutex> lock(catalog_->mutex);
+         if (txnptr)
+         {
+            mdb_txn_abort(txnptr);
+         }
+         for (const auto& [name, dbi] : opened)
+         {
+            catalog_->pending.erase(name);
+         }
+      }
+
+      // called by store_t::drop(), which closes the handle
+      void uncatalog(const std::string& name)
+      {
+         if (!catalog_)
+         {
+            return;
+         }
+         std::unique_lock<std::shared_mutex> lock(catalog_->mutex);
+         catalog_->handles.erase(name);
+      }
+
+      // the names of the entries of the main store, where named stores are recorded
+      static status_t list_stores(MDB_txn* txnptr, std::vector<std::string>& names) noexcept
+      {
+         MDB_dbi main;
+         MDB_cursor* cursor{ nullptr };
+         MDB_val k, v;
+         int rc;
+         if (rc = mdb_dbi_open(txnptr, nullptr, 0, &main); rc != MDB_SUCCESS)
+         {
+            return status_t(rc);
+         }
+         if (rc = mdb_cursor_open(txnptr, main, &cursor); rc != MDB_SUCCESS)
+         {
+            return status_t(rc);
+         }
+         while ((rc = mdb_cursor_get(cursor, &k, &v, MDB_NEXT)) == MDB_SUCCESS)
+         {
+            // mdb_dbi_open() takes a C string
+            if (!std::memchr(k.mv_data, '\0', k.mv_size))
+            {
+               names.emplace_back(static_cast<const char*>(k.mv_data), k.mv_size);
+            }
+         }
+         mdb_cursor_close(cursor);
+         return status_t(rc == MDB_NOTFOUND ? MDB_SUCCESS : rc);
+      }
+
+      std::string path() const noexcept
+      {
+         const char* ptr{ nullptr };
+         if (envptr_)
+         {
+            int rc = mdb_env_get_path(envptr_, &ptr);
+            if (rc != MDB_SUCCESS)
+            {
+               return std::string();
+            }
+         }
+         return std::string(ptr ? ptr : "");
+      }
+
+      size_t max_readers() const noexcept
+      {
+         unsigned int readers{ 0 };
+         if (int rc = mdb_env_get_maxreaders(envptr_, &readers); rc != MDB_SUCCESS)
+         {
+            return 0;
+         }
+         return readers;
+      }
+
+      size_t max_stores() const noexcept
+      {
+         return max_store_;
+      }
+
+      size_t mmap_size() const noexcept
+      {
+         return mmap_size_;
+      }
+
+      size_t max_keysize() const noexcept
+      {
+         int count{ 0 };
+         if (envptr_)
+         {
+            count = mdb_env_get_maxkeysize(envptr_);
+         }
+         return size_t(count);
+      }
+
+      MDB_env* handle() noexcept
+      {
+         return envptr_;
+      }
+   }; // class environment_t
+
+   class transaction_t
+   {
+      database_t& env_;
+      MDB_txn* txnptr_{ nullptr };
+      transaction_type_t type_{ transaction_type_t::none };
+      // store handles opened by this transaction, for the catalog once it commits
+      std::vector<std::pair<std::string, MDB_dbi>> opened_;
+      // when the transaction began, see tracer_t::now(), if it began while tracing
+      uint64_t trace_start_{ 0 };
+      bool traced_{ false };
+
+   public:
+      transaction_t() = delete;
+      transaction_t(const transaction_t&) = delete;
+      transaction_t& operator=(const transaction_t&) = delete;
+
+      explicit transaction_t(database_t& env) noexcept
+         : env_{ env }
       {}
 
       transaction_t(database_t& env, transaction_type_t type)
@@ -298,9 +1300,13 @@ namespace lmdb {
          : env_{ other.env_ }
          , txnptr_{ other.txnptr_ }
          , type_{ other.type_ }
+         , opened_{ std::move(other.opened_) }
+         , trace_start_{ other.trace_start_ }
+         , traced_{ other.traced_ }
       {
          other.txnptr_ = nullptr;
          other.type_ = transaction_type_t::none;
+         other.traced_ = false;
       }
 
       transaction_t& operator=(transaction_t&& other) noexcept
@@ -311,6 +1317,10 @@ namespace lmdb {
             other.txnptr_ = nullptr;
             type_ = other.type_;
             other.type_ = transaction_type_t::none;
+            opened_ = std::move(other.opened_);
+            trace_start_ = other.trace_start_;
+            traced_ = other.traced_;
+            other.traced_ = false;
          }
          return *this;
       }
@@ -323,17 +1333,35 @@ namespace lmdb {
          }
          if (txnptr_)
          {
+            size_t txnid = id();
             if (status_t status(mdb_txn_commit(txnptr_));  status.nok())
             {
+                failed();
                 return status;
             }
+            trace_end(trace_name(), txnid);
             type_ = transaction_type_t::none;
+            committed();
          }
+         tracer_t* tracer = env_.tracer();
+         uint64_t start = tracer ? tracer->now() : 0;
          if (int rc = mdb_txn_begin(env_.handle(), nullptr, get_type(type), &txnptr_); rc != MDB_SUCCESS)
          {
             return status_t(rc);
          }
          type_ = type;
+         if (tracer)
+         {
+            // a write transaction is traced from when it holds the writer lock, and the wait
+            // for the lock separately
+            traced_ = true;
+            trace_start_ = start;
+            if (type == transaction_type_t::read_write)
+            {
+               trace_start_ = tracer->now();
+               tracer->record("writer lock", start, trace_start_ - start, "txnid", id());
+            }
+         }
          return status_t();
       }
 
@@ -343,12 +1371,68 @@ namespace lmdb {
          {
             return status_t(MDB_TRANSACTION_HANDLE_NULL);
          }
+         if (env_.periodic_sync() || traced_)
+         {
+            // the background sync needs to know how much was written, the trace the phases
+            commit_stats_t stats;
+            return commit(stats);
+         }
          if (int rc = mdb_txn_commit(txnptr_); rc != MDB_SUCCESS)
          {
+            failed();
+            return status_t(rc);
+         }
+         txnptr_ = nullptr;
+         type_ = transaction_type_t::none;
+         committed();
+         return status_t();
+      }
+
+      // commit, timing each phase of the commit
+      status_t commit(commit_stats_t& stats) noexcept
+      {
+         MDB_commit_stat cs;
+         if (!txnptr_)
+         {
+            return status_t(MDB_TRANSACTION_HANDLE_NULL);
+         }
+         stats = commit_stats_t();
+         size_t txnid = id();
+         tracer_t* tracer = traced_ ? env_.tracer() : nullptr;
+         uint64_t start = tracer ? tracer->now() : 0;
+         if (int rc = mdb_txn_commit_stat(txnptr_, &cs); rc != MDB_SUCCESS)
+         {
+            failed();
             return status_t(rc);
          }
+         if (tracer && type_ == transaction_type_t::read_write)
+         {
+            tracer->record("commit", start, cs.cs_total_ns, "dirty pages", cs.cs_dirty_pages);
+            // the phases one after the other, from the start of the commit
+            std::pair<const char*, uint64_t> phases[] = { { "update stores", cs.cs_dbs_ns },
+               { "save freelist", cs.cs_freelist_ns }, { "flush pages", cs.cs_flush_ns },
+               { "sync", cs.cs_sync_ns }, { "write meta", cs.cs_meta_ns } };
+            for (const auto& [name, duration] : phases)
+            {
+               tracer->record(name, start, duration);
+               start += duration;
+            }
+         }
+         trace_end(trace_name(), txnid);
          txnptr_ = nullptr;
          type_ = transaction_type_t::none;
+         committed();
+         stats.total = std::chrono::nanoseconds(cs.cs_total_ns);
+         stats.update_stores = std::chrono::nanoseconds(cs.cs_dbs_ns);
+         stats.freelist_save = std::chrono::nanoseconds(cs.cs_freelist_ns);
+         stats.page_flush = std::chrono::nanoseconds(cs.cs_flush_ns);
+         stats.sync = std::chrono::nanoseconds(cs.cs_sync_ns);
+         stats.write_meta = std::chrono::nanoseconds(cs.cs_meta_ns);
+         stats.dirty_pages = static_cast<size_t>(cs.cs_dirty_pages);
+         stats.written_pages = static_cast<size_t>(cs.cs_written_pages);
+         stats.written_bytes = static_cast<size_t>(cs.cs_written_bytes);
+         stats.freelist_pages = static_cast<size_t>(cs.cs_freelist_pages);
+         env_.committed(stats.written_bytes);
          return status_t();
       }
 
@@ -358,7 +1442,21 @@ namespace lmdb {
          {
             return status_t(MDB_TRANSACTION_HANDLE_NULL);
          }
-         mdb_txn_abort(txnptr_);
+         size_t txnid = id();
+         if (type_ == transaction_type_t::read_only && !opened_.empty())
+         {
+            // ending a read-only transaction with a commit keeps the store handles it opened
+            if (mdb_txn_commit(txnptr_) == MDB_SUCCESS)
+            {
+               env_.catalog(opened_);
+            }
+         }
+         else
+         {
+            env_.abort(txnptr_, opened_);
+         }
+         trace_end(type_ == transaction_type_t::read_only ? "read txn" : "aborted write txn", txnid);
+         opened_.clear();
          txnptr_ = nullptr;
          type_ = transaction_type_t::none;
          return status_t();
@@ -369,11 +1467,85 @@ namespace lmdb {
          return txnptr_ != nullptr;
       }
 
+      // id of the started transaction. Once a read-write transaction commits, this id
+      // can be passed to database_t::wait_durable()
+      size_t id() noexcept
+      {
+         return txnptr_ ? static_cast<size_t>(mdb_txn_id(txnptr_)) : 0;
+      }
+
       transaction_type_t type() const noexcept
       {
          return type_;
       }
 
+      // call fn(txnptr, i) for every i < n on up to threads threads, this one included. In a
+      // read-only transaction each worker thread opens its own read transaction; a worker that
+      // lands on a newer snapshot takes no work, and work that fails on a worker is run again
+      // here, so every call sees the snapshot of this transaction. Otherwise all calls run here
+      template <typename F>
+      status_t parallel(size_t n, size_t threads, F&& fn)
+      {
+         status_t status;
+         if (!txnptr_)
+         {
+            return status_t(MDB_TRANSACTION_HANDLE_NULL);
+         }
+         threads = std::min(threads, n);
+         if (threads < 2 || type_ != transaction_type_t::read_only)
+         {
+            for (size_t i = 0; i < n && status.ok(); ++i)
+            {
+               status = fn(txnptr_, i);
+            }
+            return status;
+         }
+         MDB_env* env = env_.handle();
+         mdb_size_t snapshot = mdb_txn_id(txnptr_);
+         std::atomic<size_t> next{ 0 };
+         std::atomic<bool> stop{ false };
+         // not std::vector<bool>, the workers write their flags concurrently
+         std::vector<char> redo(n, 0);
+         std::vector<std::thread> workers;
+         workers.reserve(threads - 1);
+         for (size_t t = 1; t < threads; ++t)
+         {
+            workers.emplace_back([&]()
+            {
+               MDB_txn* reader{ nullptr };
+               if (mdb_txn_begin(env, nullptr, MDB_RDONLY, &reader) != MDB_SUCCESS)
+               {
+                  return;
+               }
+               if (mdb_txn_id(reader) == snapshot)
+               {
+                  for (size_t i = next++; i < n && !stop; i = next++)
+                  {
+                     redo[i] = fn(reader, i).nok();
+                  }
+               }
+               mdb_txn_abort(reader);
+            });
+         }
+         for (size_t i = next++; i < n && status.ok(); i = next++)
+         {
+            status = fn(txnptr_, i);
+         }
+         stop = status.nok();
+         for (std::thread& worker : workers)
+         {
+            worker.join();
+         }
+         for (size_t i = 0; i < n && status.ok(); ++i)
+         {
+            if (redo[i])
+            {
+               status = fn(txnptr_, i);
+            }
+         }
+         return status;
+      }
+
       MDB_txn* handle() noexcept
       {
          return txnptr_;
@@ -384,22 +1556,62 @@ namespace lmdb {
          return env_;
       }
 
+      // called by store_t after mdb_dbi_open() in this transaction
+      void opened(const std::string& name, MDB_dbi dbi)
+      {
+         opened_.emplace_back(name, dbi);
+      }
+
    private:
-      int get_type(transaction_type_t type) const noexcept
+      void committed() noexcept
       {
-         switch (type)
-         {
-         case transaction_type_t::none: return MDB_RDONLY;
-         case transaction_type_t::read_write: return 0;
-         case transaction_type_t::read_only: return MDB_RDONLY;
-         }
-         return 0;
+         env_.catalog(opened_);
+         opened_.clear();
       }
-   }; // class transaction_t
 
-   class data_t
-   {
-      MDB_val data_{};
+      // a failed commit aborts the transaction and frees it
+      void failed() noexcept
+      {
+         env_.abort(nullptr, opened_);
+         opened_.clear();
+         txnptr_ = nullptr;
+         type_ = transaction_type_t::none;
+      }
+
+      const char* trace_name() const noexcept
+      {
+         return type_ == transaction_type_t::read_only ? "read txn" : "write txn";
+      }
+
+      // record the transaction from begin() until now, if it began while tracing
+      void trace_end(const char* name, size_t txnid) noexcept
+      {
+         if (!traced_)
+         {
+            return;
+         }
+         traced_ = false;
+         if (tracer_t* tracer = env_.tracer(); tracer)
+         {
+            tracer->record(name, trace_start_, tracer->now() - trace_start_, "txnid", txnid);
+         }
+      }
+
+      int get_type(transaction_type_t type) const noexcept
+      {
+         switch (type)
+         {
+         case transaction_type_t::none: return MDB_RDONLY;
+         case transaction_type_t::read_write: return 0;
+         case transaction_type_t::read_only: return MDB_RDONLY;
+         }
+         return 0;
+      }
+   }; // class transaction_t
+
+   class data_t
+   {
+      MDB_val data_{};
 
    public:
       using value_type = std::string;
@@ -460,7 +1672,8 @@ namespace lmdb {
       {
          if (data_.mv_size > 0)
          {
-            sv = std::move(std::string_view((std::string_view::pointer)data_.mv_data, data_.mv_size));
+            sv = std::string_view((std::string_view::pointer)data_.mv_data, data_.mv_size);
+            return;
          }
          sv = std::string_view();
       }
@@ -488,8 +1701,486 @@ namespace lmdb {
       }
    };
 
+   // a value format whose fields are read in place, without decoding the rest of the value.
+   // Fields are numbers, enums, trivially copyable structs or std::string_view, stored in native
+   // byte order. A 4 byte header holds the number of fields written, followed by a slot for
+   // each field at an offset fixed at compile time; a std::string_view slot holds the offset and
+   // length of its bytes in the variable part at the end of the value. Layouts grow by appending
+   // fields: older values read as T{} for the fields they lack, and older readers never look
+   // past the fields they know
+   template <typename... Fields>
+   class layout_t
+   {
+      static_assert(sizeof...(Fields) > 0, "a layout needs at least one field");
+      static_assert(((std::is_trivially_copyable_v<Fields> || std::is_same_v<Fields, std::string_view>) && ...), "fields must be trivially copyable or std::string_view");
+
+      template <typename T>
+      static constexpr bool is_variable = std::is_same_v<T, std::string_view>;
+
+   public:
+      template <size_t I>
+      using field_type = std::tuple_element_t<I, std::tuple<Fields...>>;
+
+      static constexpr size_t FIELDS = sizeof...(Fields);
+      static constexpr size_t HEADER_SIZE = sizeof(uint32_t);
+
+      // OFFSETS[i] is where field i starts, OFFSETS[FIELDS] where the variable part starts
+      static constexpr std::array<size_t, FIELDS + 1> OFFSETS = []() constexpr
+      {
+         std::array<size_t, FIELDS + 1> offsets{};
+         size_t sizes[] = { (is_variable<Fields> ? 2 * sizeof(uint32_t) : sizeof(Fields))... };
+         offsets[0] = HEADER_SIZE;
+         for (size_t i = 0; i < FIELDS; ++i)
+         {
+            offsets[i + 1] = offsets[i] + sizes[i];
+         }
+         return offsets;
+      }();
+
+      // typed access to the fields of an encoded value, e.g. one returned by store_t::get()
+      // straight from the memory map. Only the fields asked for are read
+      class view_t
+      {
+         std::string_view bytes_;
+         size_t fields_{ 0 };
+         bool valid_{ false };
+
+      public:
+         view_t() noexcept = default;
+
+         explicit view_t(const std::string_view& bytes) noexcept
+            : bytes_{ bytes }
+         {
+            uint32_t n{ 0 };
+            if (bytes_.size() < HEADER_SIZE)
+            {
+               return;
+            }
+            std::memcpy(&n, bytes_.data(), sizeof(n));
+            // a value from a newer layout carries more fields than this one knows
+            size_t known = std::min<size_t>(n, FIELDS);
+            if (OFFSETS[known] > bytes_.size())
+            {
+               return;
+            }
+            fields_ = known;
+            valid_ = true;
+         }
+
+         // field I, or field_type<I>{} when the value was written before field I was added
+         template <size_t I>
+         field_type<I> get() const noexcept
+         {
+            static_assert(I < FIELDS, "field index out of range");
+            using T = field_type<I>;
+            if (I >= fields_)
+            {
+               return T{};
+            }
+            if constexpr (is_variable<T>)
+            {
+               uint32_t slot[2];
+               std::memcpy(slot, bytes_.data() + OFFSETS[I], sizeof(slot));
+               if (slot[0] > bytes_.size() || slot[1] > bytes_.size() - slot[0])
+               {
+                  return T{};
+               }
+               return bytes_.substr(slot[0], slot[1]);
+            }
+            else
+            {
+               T value;
+               std::memcpy(&value, bytes_.data() + OFFSETS[I], sizeof(T));
+               return value;
+            }
+         }
+
+         // true when the value was written with field I
+         template <size_t I>
+         bool has() const noexcept
+         {
+            return I < fields_;
+         }
+
+         // number of fields of this layout present in the value
+         size_t fields() const noexcept
+         {
+            return fields_;
+         }
+
+         bool valid() const noexcept
+         {
+            return valid_;
+         }
+
+         std::string_view bytes() const noexcept
+         {
+            return bytes_;
+         }
+      };
+
+      // a value holding every field of the layout
+      static std::string encode(const Fields&... fields)
+      {
+         size_t size = OFFSETS[FIELDS];
+         ((size += variable_size(fields)), ...);
+         std::string value(size, '\0');
+         uint32_t n = static_cast<uint32_t>(FIELDS);
+         std::memcpy(&value[0], &n, sizeof(n));
+         size_t tail = OFFSETS[FIELDS];
+         encode_fields(value, tail, std::index_sequence_for<Fields...>{}, fields...);
+         return value;
+      }
+
+      // overwrite fixed size field I of an encoded value. Returns false when the value
+      // doesn't hold field I
+      template <size_t I>
+      static bool set(std::string& value, const field_type<I>& field) noexcept
+      {
+         static_assert(!is_variable<field_type<I>>, "only fixed size fields can be overwritten");
+         if (view_t view(value); !view.template has<I>())
+         {
+            return false;
+         }
+         std::memcpy(&value[OFFSETS[I]], &field, sizeof(field));
+         return true;
+      }
+
+   private:
+      template <typename T>
+      static size_t variable_size(const T& field) noexcept
+      {
+         if constexpr (is_variable<T>)
+         {
+            return field.size();
+         }
+         else
+         {
+            return 0;
+         }
+      }
+
+      template <size_t... I>
+      static void encode_fields(std::string& value, size_t& tail, std::index_sequence<I...>, const Fields&... fields) noexcept
+      {
+         (encode_field(value, tail, OFFSETS[I], fields), ...);
+      }
+
+      template <typename T>
+      static void encode_field(std::string& value, size_t& tail, size_t offset, const T& field) noexcept
+      {
+         if constexpr (is_variable<T>)
+         {
+            uint32_t slot[2] = { static_cast<uint32_t>(tail), static_cast<uint32_t>(field.size()) };
+            std::memcpy(&value[offset], slot, sizeof(slot));
+            if (!field.empty())
+            {
+               std::memcpy(&value[tail], field.data(), field.size());
+            }
+            tail += field.size();
+         }
+         else
+         {
+            std::memcpy(&value[offset], &field, sizeof(T));
+         }
+      }
+   };
+
+
+   // marks a part of a key_codec_t that sorts in descending order
+   template <typename T>
+   struct descending_t
+   {
+      using type = T;
+   };
+
+   // encodes keys whose bytes sort with memcmp(), LMDB's default order, as their parts sort one
+   // after the other, so compound keys need no custom comparator. Numbers are stored big-endian:
+   // signed integers with the sign bit flipped, float and double with every bit flipped when
+   // negative and the sign bit flipped otherwise. A string ends with 0x00 0x01 and escapes a zero
+   // byte as 0x00 0xff, so it sorts before the longer strings it is a prefix of. Every byte of a
+   // descending_t<T> part is flipped. Keys of numbers only have a fixed size and can be encoded
+   // at compile time
+   template <typename... Parts>
+   class key_codec_t
+   {
+      template <typename P>
+      struct part_traits
+      {
+         using type = P;
+         static constexpr bool descending = false;
+      };
+
+      template <typename T>
+      struct part_traits<descending_t<T>>
+      {
+         using type = T;
+         static constexpr bool descending = true;
+      };
+
+      template <typename P>
+      using part_type = typename part_traits<P>::type;
+
+      template <typename T>
+      static constexpr bool is_string = std::is_same_v<T, std::string_view> || std::is_same_v<T, std::string>;
+
+      template <typename T>
+      static constexpr bool is_number = std::is_integral_v<T> || std::is_same_v<T, float> || std::is_same_v<T, double>;
+
+      static_assert(sizeof...(Parts) > 0, "a key needs at least one part");
+      static_assert(((is_number<part_type<Parts>> || is_string<part_type<Parts>>) && ...), "key parts must be integers, float, double or strings");
+
+      template <typename T>
+      static constexpr size_t width = is_string<T> ? 0 : sizeof(T);
+
+      template <typename T>
+      using bits_t = std::conditional_t<sizeof(T) == 1, uint8_t, std::conditional_t<sizeof(T) == 2, uint16_t,
+         std::conditional_t<sizeof(T) == 4, uint32_t, uint64_t>>>;
+
+   public:
+      // what a part is passed as, and decoded into
+      template <typename P>
+      using argument_t = std::conditional_t<is_string<part_type<P>>, std::string_view, part_type<P>>;
+      using values_t = std::tuple<std::conditional_t<is_string<part_type<Parts>>, std::string, part_type<Parts>>...>;
+
+      static constexpr size_t PARTS = sizeof...(Parts);
+      static constexpr bool FIXED = (!is_string<part_type<Parts>> && ...);
+      // the size of every key when FIXED, else the bytes taken by the numbers
+      static constexpr size_t SIZE = (width<part_type<Parts>> + ...);
+
+      static std::string encode(const argument_t<Parts>&... parts)
+      {
+         std::string key;
+         append(key, parts...);
+         return key;
+      }
+
+      // append the encoded parts to key
+      static void append(std::string& key, const argument_t<Parts>&... parts)
+      {
+         size_t size = SIZE;
+         ((size += string_size<Parts>(parts)), ...);
+         key.reserve(key.size() + size);
+         (append_part<Parts>(key, parts), ...);
+      }
+
+      // the fast path for keys of numbers only: no allocation, and usable in constant expressions
+      static constexpr std::array<char, SIZE> encode_fixed(const argument_t<Parts>&... parts) noexcept
+      {
+         static_assert(FIXED, "encode_fixed() takes keys of numbers only");
+         std::array<char, SIZE> key{};
+         size_t pos = 0;
+         (write_number<Parts>(key.data(), pos, parts), ...);
+         return key;
+      }
+
+      // the encoding of the first sizeof...(Args) parts, which begins every key starting with
+      // them, to position a cursor or bound a scan
+      template <typename... Args>
+      static std::string prefix(const Args&... first)
+      {
+         static_assert(sizeof...(Args) <= PARTS, "more values than parts");
+         std::string key;
+         append_prefix(key, std::index_sequence_for<Args...>{}, first...);
+         return key;
+      }
+
+      // returns false when key is not an encoding of this codec
+      static bool decode(const std::string_view& key, values_t& values)
+      {
+         size_t pos = 0;
+         // a fixed size key needs one size check instead of one per part
+         if constexpr (FIXED)
+         {
+            if (key.size() != SIZE)
+            {
+               return false;
+            }
+         }
+         return decode_parts(key, pos, values, std::index_sequence_for<Parts...>{}) && pos == key.size();
+      }
+
+   private:
+      template <typename T>
+      static constexpr bits_t<T> to_ordered(T value) noexcept
+      {
+         using U = bits_t<T>;
+         constexpr U sign = U(U(1) << (sizeof(U) * 8 - 1));
+         if constexpr (std::is_same_v<T, bool>)
+         {
+            return value ? 1 : 0;
+         }
+         else if constexpr (std::is_floating_point_v<T>)
+         {
+            U u = std::bit_cast<U>(value);
+            return (u & sign) ? U(~u) : U(u | sign);
+         }
+         else if constexpr (std::is_signed_v<T>)
+         {
+            return U(U(value) ^ sign);
+         }
+         else
+         {
+            return U(value);
+         }
+      }
+
+      template <typename T>
+      static constexpr T from_ordered(bits_t<T> u) noexcept
+      {
+         using U = bits_t<T>;
+         constexpr U sign = U(U(1) << (sizeof(U) * 8 - 1));
+         if constexpr (std::is_same_v<T, bool>)
+         {
+            return u != 0;
+         }
+         else if constexpr (std::is_floating_point_v<T>)
+         {
+            return std::bit_cast<T>((u & sign) ? U(u ^ sign) : U(~u));
+         }
+         else if constexpr (std::is_signed_v<T>)
+         {
+            return T(U(u ^ sign));
+         }
+         else
+         {
+            return T(u);
+         }
+      }
+
+      template <typename P>
+      static constexpr void write_number(char* out, size_t& pos, const argument_t<P>& value) noexcept
+      {
+         using T = part_type<P>;
+         constexpr uint8_t flip = part_traits<P>::descending ? 0xff : 0;
+         auto u = to_ordered<T>(value);
+         for (size_t i = sizeof(T); i-- > 0;)
+         {
+            out[pos++] = static_cast<char>(static_cast<uint8_t>(u >> (8 * i)) ^ flip);
+         }
+      }
+
+      template <typename P>
+      static size_t string_size(const argument_t<P>& value) noexcept
+      {
+         if constexpr (is_string<part_type<P>>)
+         {
+            return value.size() + 2;
+         }
+         else
+         {
+            return 0;
+         }
+      }
+
+      template <typename P>
+      static void append_part(std::string& key, const argument_t<P>& value)
+      {
+         if constexpr (is_string<part_type<P>>)
+         {
+            constexpr char flip = part_traits<P>::descending ? char(0xff) : char(0);
+            for (size_t pos = 0; pos <= value.size();)
+            {
+               size_t end = std::min(value.find('\0', pos), value.size());
+               if constexpr (part_traits<P>::descending)
+               {
+                  for (size_t i = pos; i < end; ++i)
+                  {
+                     key.push_back(char(value[i] ^ flip));
+                  }
+               }
+               else
+               {
+                  key.append(value.data() + pos, end - pos);
+               }
+               key.push_back(flip);
+               key.push_back(end < value.size() ? char(0xff ^ flip) : char(0x01 ^ flip));
+               pos = end + 1;
+            }
+         }
+         else
+         {
+            char bytes[sizeof(part_type<P>)];
+            size_t pos = 0;
+            write_number<P>(bytes, pos, value);
+            key.append(bytes, sizeof(bytes));
+         }
+      }
+
+      template <size_t... I, typename... Args>
+      static void append_prefix(std::string& key, std::index_sequence<I...>, const Args&... first)
+      {
+         (append_part<std::tuple_element_t<I, std::tuple<Parts...>>>(key,
+            static_cast<argument_t<std::tuple_element_t<I, std::tuple<Parts...>>>>(first)), ...);
+      }
+
+      template <size_t... I>
+      static bool decode_parts(const std::string_view& key, size_t& pos, values_t& values, std::index_sequence<I...>)
+      {
+         return (decode_part<std::tuple_element_t<I, std::tuple<Parts...>>>(key, pos, std::get<I>(values)) && ...);
+      }
+
+      template <typename P, typename V>
+      static bool decode_part(const std::string_view& key, size_t& pos, V& value)
+      {
+         if constexpr (is_string<part_type<P>>)
+         {
+            constexpr char flip = part_traits<P>::descending ? char(0xff) : char(0);
+            value.clear();
+            for (;;)
+            {
+               size_t end = key.find(flip, pos);
+               if (end == std::string_view::npos || end + 1 >= key.size())
+               {
+                  return false;
+               }
+               if constexpr (part_traits<P>::descending)
+               {
+                  for (size_t i = pos; i < end; ++i)
+                  {
+                     value.push_back(char(key[i] ^ flip));
+                  }
+               }
+               else
+               {
+                  value.append(key.data() + pos, end - pos);
+               }
+               pos = end + 2;
+               if (char next = char(key[end + 1] ^ flip); next == char(0x01))
+               {
+                  return true;
+               }
+               else if (next != char(0xff))
+               {
+                  return false;
+               }
+               value.push_back('\0');
+            }
+         }
+         else
+         {
+            using T = part_type<P>;
+            constexpr uint8_t flip = part_traits<P>::descending ? 0xff : 0;
+            // the size of a FIXED key was checked up front
+            if (!FIXED && key.size() - pos < sizeof(T))
+            {
+               return false;
+            }
+            bits_t<T> u = 0;
+            for (size_t i = 0; i < sizeof(T); ++i)
+            {
+               u = bits_t<T>((u << 8) | (static_cast<uint8_t>(key[pos++]) ^ flip));
+            }
+            value = from_ordered<T>(u);
+            return true;
+         }
+      }
+   };
+
    class store_t
    {
+      static constexpr int OPEN_RETRIES = 8;
+
       database_t& env_;
       MDB_dbi id_{ 0 };
       bool opened_{ false };
@@ -532,14 +2223,47 @@ namespace lmdb {
          return *this;
       }
 
-      status_t create(transaction_t& txn, const std::string& name) noexcept
+      // flags are passed on to mdb_dbi_open(), e.g. MDB_COUNTED to enable rank() and select()
+      status_t create(transaction_t& txn, const std::string& name, unsigned int flags = 0) noexcept
       {
-         return open_or_create(txn, name, true);
+         return open_or_create(txn, name, flags | MDB_CREATE);
       }
 
-      status_t open(transaction_t& txn, const std::string& name) noexcept
+      status_t open(transaction_t& txn, const std::string& name, unsigned int flags = 0) noexcept
+      {
+         return open_or_create(txn, name, flags);
+      }
+
+      // open by name without a transaction, from the catalog of the database, see
+      // database_t::open_catalog()
+      status_t open(const std::string& name) noexcept
+      {
+         status_t status;
+         if (opened_)
+         {
+            return status_t(MDB_ALREADY_OPEN);
+         }
+         if (status = env_.open_store(name, id_); status.ok())
+         {
+            opened_ = true;
+            name_ = name;
+         }
+         return status;
+      }
+
+      // open by position in the ids given to database_t::open_catalog()
+      status_t open(size_t id) noexcept
       {
-         return open_or_create(txn, name, false);
+         if (opened_)
+         {
+            return status_t(MDB_ALREADY_OPEN);
+         }
+         if (!env_.find_store(id, name_, id_))
+         {
+            return status_t(MDB_NOTFOUND);
+         }
+         opened_ = true;
+         return status_t();
       }
 
       status_t close(transaction_t&) noexcept
@@ -558,11 +2282,32 @@ namespace lmdb {
          {
             return status;
          }
+         env_.uncatalog(name_);
          opened_ = false;
          name_.clear();
          return status;
       }
 
+      // delete every key but keep the store open
+      status_t truncate(transaction_t& txn) noexcept
+      {
+         if (!opened_)
+         {
+            return status_t(MDB_NOT_OPEN);
+         }
+         return status_t(mdb_drop(txn.handle(), id_, 0));
+      }
+
+      // exchange the contents of two stores without copying. Readers see the exchange when txn commits
+      status_t swap(transaction_t& txn, store_t& other) noexcept
+      {
+         if (!opened_ || !other.opened_)
+         {
+            return status_t(MDB_NOT_OPEN);
+         }
+         return status_t(mdb_dbi_swap(txn.handle(), id_, other.id_));
+      }
+
       status_t get(transaction_t& txn, const std::string_view& target_key, std::string& key, std::string& value) noexcept
       {
          status_t status{ MDB_NOT_OPEN };
@@ -580,18 +2325,23 @@ namespace lmdb {
          return status;
       }
 
-      status_t put(transaction_t& txn, const std::string_view& key, const std::string_view& value) noexcept
+      // value points into the memory map and stays valid until txn ends or writes to the store
+      status_t get(transaction_t& txn, const std::string_view& key, std::string_view& value) noexcept
       {
+         status_t status{ MDB_NOT_OPEN };
          if (!opened_)
          {
-            return status_t(MDB_NOT_OPEN);
+            return status;
          }
-         data_t k(key);
-         data_t v(value);
-         return status_t(mdb_put(txn.handle(), id_, k.data(), v.data(), 0));
+         data_t k(key), v;
+         if (status = mdb_get(txn.handle(), id_, k.data(), v.data()); status.ok())
+         {
+            v.get(value);
+         }
+         return status;
       }
 
-      status_t del(transaction_t& txn, const std::string_view& key, const std::string_view& value) noexcept
+      status_t put(transaction_t& txn, const std::string_view& key, const std::string_view& value) noexcept
       {
          if (!opened_)
          {
@@ -599,329 +2349,2915 @@ namespace lmdb {
          }
          data_t k(key);
          data_t v(value);
-         return status_t(mdb_del(txn.handle(), id_, k.data(), v.data()));
+         return status_t(mdb_put(txn.handle(), id_, k.data(), v.data(), 0));
       }
 
-      size_t entries(transaction_t& txn) noexcept
+      // put() for keys that mostly arrive in order: a key after the last key of the store is
+      // appended with MDB_APPEND, without searching the tree, any other key is put as usual
+      status_t append(transaction_t& txn, const std::string_view& key, const std::string_view& value) noexcept
       {
-         MDB_stat stat;
-         status_t status;
-         size_t retval{ 0 };
-         if (status = mdb_stat(txn.handle(), id_, &stat); status.ok())
+         if (!opened_)
          {
-            retval = stat.ms_entries;
+            return status_t(MDB_NOT_OPEN);
          }
-         return retval;
-      }
-
-      std::string name() const noexcept
-      {
-         return name_;
-      }
-
-      MDB_dbi handle() const noexcept
-      {
-         return id_;
+         data_t k(key);
+         data_t v(value);
+         if (int rc = mdb_put(txn.handle(), id_, k.data(), v.data(), MDB_APPEND); rc != MDB_KEYEXIST)
+         {
+            return status_t(rc);
+         }
+         return status_t(mdb_put(txn.handle(), id_, k.data(), v.data(), 0));
       }
 
-      database_t& database() noexcept
+      status_t del(transaction_t& txn, const std::string_view& key, const std::string_view& value) noexcept
       {
-         return env_;
+         if (!opened_)
+         {
+            return status_t(MDB_NOT_OPEN);
+         }
+         data_t k(key);
+         data_t v(value);
+         return status_t(mdb_del(txn.handle(), id_, k.data(), v.data()));
       }
 
-   private:
-      status_t open_or_create(transaction_t& txn, const std::string& name, bool create) noexcept
+      // delete every key between lo and hi. Subtrees inside the range are unlinked and their pages
+      // freed in bulk, only the keys at the edges are deleted one by one. Open cursors on the store are reset
+      status_t delete_range(transaction_t& txn, const std::string_view& lo, const std::string_view& hi, size_t& n, range_bounds_t bounds = range_bounds_t::closed_open) noexcept
       {
+         bool lo_inclusive = bounds == range_bounds_t::closed || bounds == range_bounds_t::closed_open;
+         bool hi_inclusive = bounds == range_bounds_t::closed || bounds == range_bounds_t::open_closed;
+         MDB_val lo_key = *data_t(lo).data();
+         MDB_val hi_key = *data_t(hi).data();
+         MDB_val* first{ &lo_key };
+         MDB_val* last{ &hi_key };
+         std::string lo_next, hi_next;
+         bool found{ false };
+         mdb_size_t count{ 0 };
          status_t status;
-         if (opened_)
+         n = 0;
+         if (!opened_)
          {
-            return status_t(MDB_ALREADY_OPEN);
+            return status_t(MDB_NOT_OPEN);
          }
-         if (status = mdb_dbi_open(txn.handle(), name.c_str(), make_mode(create), &id_); status.nok())
+         // the engine deletes [first, last): move open and closed bounds to the next key
+         if (!lo_inclusive)
          {
-            return status;
+            if (status = key_after(txn, lo, lo_next, found); status.nok() || !found)
+            {
+               return status;
+            }
+            lo_key = *data_t(lo_next).data();
          }
-         opened_ = true;
-         return status;
-      }
-
-      status_t close() noexcept
-      {
-         if (!opened_)
+         if (hi_inclusive)
          {
-            return status_t(MDB_NOT_OPEN);
+            if (status = key_after(txn, hi, hi_next, found); status.nok())
+            {
+               return status;
+            }
+            hi_key = *data_t(hi_next).data();
+            last = found ? &hi_key : nullptr;
          }
-         opened_ = false;
-         name_.clear();
-         return status_t();
-      }
-
-      unsigned int make_mode(bool create) const noexcept
-      {
-         return create ? MDB_CREATE : 0;
+         if (last && mdb_cmp(txn.handle(), id_, first, last) >= 0)
+         {
+            return status;
+         }
+         status = mdb_del_range(txn.handle(), id_, first, last, &count);
+         n = static_cast<size_t>(count);
+         return status;
       }
 
-   }; // class table_base_t
-
-   class cursor_t
-   {
-      MDB_cursor* cursor_{ nullptr };
-      store_t& table_;
-
-   public:
-      using key_type = std::string;
-      using key_reference = key_type&;
-      using key_const_reference = const std::string_view&;
-      using value_type = std::string;
-      using value_reference = value_type&;
-      using value_const_reference = const std::string_view&;
-
-      cursor_t() = delete;
-      cursor_t(const cursor_t&) = delete;
-      cursor_t& operator=(cursor_t&& other) = delete;
-      cursor_t& operator=(const cursor_t&) = delete;
-
-      ~cursor_t() noexcept
+      status_t delete_range(transaction_t& txn, const std::string_view& lo, const std::string_view& hi, range_bounds_t bounds = range_bounds_t::closed_open) noexcept
       {
-         close();
+         size_t n{ 0 };
+         return delete_range(txn, lo, hi, n, bounds);
       }
 
-      explicit cursor_t(store_t& table) noexcept
-         : table_{ table }
-      {}
-
-      cursor_t(transaction_t& txn, store_t& table)
-         : table_{ table }
+      size_t entries(transaction_t& txn) noexcept
       {
-         if (status_t status = open(txn); status.nok())
+         MDB_stat stat;
+         status_t status;
+         size_t retval{ 0 };
+         if (status = mdb_stat(txn.handle(), id_, &stat); status.ok())
          {
-            throw error_t(status);
+            retval = stat.ms_entries;
          }
+         return retval;
       }
 
-      status_t open(transaction_t& txn) noexcept
+      // visit every key starting with prefix; fn(key, value) receives views into the memory map
+      // and may return false to stop early. limit of 0 means no limit
+      template <typename F>
+      status_t scan_prefix(transaction_t& txn, const std::string_view& prefix, F&& fn, scan_direction_t direction = scan_direction_t::forward, size_t limit = 0)
       {
-         status_t status{ MDB_ALREADY_OPEN };
-         if (cursor_)
+         auto in_range = [&prefix](const MDB_val& k) noexcept
          {
-            return status;
+            return k.mv_size >= prefix.size() && std::memcmp(k.mv_data, prefix.data(), prefix.size()) == 0;
+         };
+         if (direction == scan_direction_t::forward)
+         {
+            return scan(txn, [&prefix](MDB_cursor* cursor, MDB_val& k, MDB_val& v) noexcept
+            {
+               k = *data_t(prefix).data();
+               return status_t(mdb_cursor_get(cursor, &k, &v, MDB_SET_RANGE));
+            }, in_range, fn, direction, limit);
          }
-         if (status = mdb_cursor_open(txn.handle(), table_.handle(), &cursor_); status.nok())
+         // position on the last key before the first key past the prefix
+         std::string upper{ prefix };
+         while (!upper.empty() && static_cast<unsigned char>(upper.back()) == 0xff)
          {
-            return status;
+            upper.pop_back();
          }
-         return status;
+         if (!upper.empty())
+         {
+            upper.back() = char(static_cast<unsigned char>(upper.back()) + 1);
+         }
+         return scan(txn, [&upper](MDB_cursor* cursor, MDB_val& k, MDB_val& v) noexcept
+         {
+            if (!upper.empty())
+            {
+               k = *data_t(upper).data();
+               if (int rc = mdb_cursor_get(cursor, &k, &v, MDB_SET_RANGE); rc != MDB_NOTFOUND)
+               {
+                  return status_t(rc == MDB_SUCCESS ? mdb_cursor_get(cursor, &k, &v, MDB_PREV) : rc);
+               }
+            }
+            return status_t(mdb_cursor_get(cursor, &k, &v, MDB_LAST));
+         }, in_range, fn, direction, limit);
       }
 
-      status_t close() noexcept
+      // visit every key between lo and hi, comparing bounds with the store comparator
+      template <typename F>
+      status_t scan_range(transaction_t& txn, const std::string_view& lo, const std::string_view& hi, F&& fn, range_bounds_t bounds = range_bounds_t::closed_open, scan_direction_t direction = scan_direction_t::forward, size_t limit = 0)
       {
-         if (cursor_)
+         MDB_txn* txnptr = txn.handle();
+         MDB_dbi dbi = id_;
+         MDB_val lo_key = *data_t(lo).data();
+         MDB_val hi_key = *data_t(hi).data();
+         bool lo_inclusive = bounds == range_bounds_t::closed || bounds == range_bounds_t::closed_open;
+         bool hi_inclusive = bounds == range_bounds_t::closed || bounds == range_bounds_t::open_closed;
+         auto in_range = [&](const MDB_val& k) noexcept
          {
-            mdb_cursor_close(cursor_);
-            cursor_ = nullptr;
+            int lc = mdb_cmp(txnptr, dbi, &k, &lo_key);
+            int hc = mdb_cmp(txnptr, dbi, &k, &hi_key);
+            return (lc > 0 || (lc == 0 && lo_inclusive)) && (hc < 0 || (hc == 0 && hi_inclusive));
+         };
+         if (direction == scan_direction_t::forward)
+         {
+            return scan(txn, [&](MDB_cursor* cursor, MDB_val& k, MDB_val& v) noexcept
+            {
+               k = lo_key;
+               int rc = mdb_cursor_get(cursor, &k, &v, MDB_SET_RANGE);
+               if (rc == MDB_SUCCESS && !lo_inclusive && mdb_cmp(txnptr, dbi, &k, &lo_key) == 0)
+               {
+                  rc = mdb_cursor_get(cursor, &k, &v, MDB_NEXT);
+               }
+               return status_t(rc);
+            }, in_range, fn, direction, limit);
          }
-         return status_t();
+         return scan(txn, [&](MDB_cursor* cursor, MDB_val& k, MDB_val& v) noexcept
+         {
+            k = hi_key;
+            int rc = mdb_cursor_get(cursor, &k, &v, MDB_SET_RANGE);
+            if (rc == MDB_NOTFOUND)
+            {
+               return status_t(mdb_cursor_get(cursor, &k, &v, MDB_LAST));
+            }
+            if (rc == MDB_SUCCESS)
+            {
+               if (int c = mdb_cmp(txnptr, dbi, &k, &hi_key); c > 0 || (c == 0 && !hi_inclusive))
+               {
+                  rc = mdb_cursor_get(cursor, &k, &v, MDB_PREV);
+               }
+            }
+            return status_t(rc);
+         }, in_range, fn, direction, limit);
       }
 
-      status_t current(key_reference key, value_reference value) noexcept
+      // number of keys between lo and hi in O(log n). Requires a store created with MDB_COUNTED
+      status_t count(transaction_t& txn, const std::string_view& lo, const std::string_view& hi, size_t& n, range_bounds_t bounds = range_bounds_t::closed_open) noexcept
       {
-         return get(key, value, MDB_GET_CURRENT);
+         bool lo_inclusive = bounds == range_bounds_t::closed || bounds == range_bounds_t::closed_open;
+         bool hi_inclusive = bounds == range_bounds_t::closed || bounds == range_bounds_t::open_closed;
+         size_t first{ 0 }, last{ 0 };
+         n = 0;
+         return with_cursor(txn, [&](MDB_cursor* cursor) noexcept
+         {
+            status_t status;
+            if (status = counted(txn); status.nok())
+            {
+               return status;
+            }
+            if (status = lower_rank(txn, cursor, lo, !lo_inclusive, first); status.nok())
+            {
+               return status;
+            }
+            if (status = lower_rank(txn, cursor, hi, hi_inclusive, last); status.nok())
+            {
+               return status;
+            }
+            n = last > first ? last - first : 0;
+            return status;
+         });
       }
 
-      status_t current(key_reference key) noexcept
+      // number of keys sorting before key. Requires a store created with MDB_COUNTED
+      status_t rank(transaction_t& txn, const std::string_view& key, size_t& position) noexcept
       {
-         return get(key, MDB_GET_CURRENT);
+         position = 0;
+         return with_cursor(txn, [&](MDB_cursor* cursor) noexcept
+         {
+            status_t status = counted(txn);
+            return status.ok() ? lower_rank(txn, cursor, key, false, position) : status;
+         });
       }
 
-      status_t first(key_reference key, value_reference value) noexcept
+      // the key and value at position in key order. Requires a store created with MDB_COUNTED
+      status_t select(transaction_t& txn, size_t position, std::string& key, std::string& value) noexcept
       {
-         return get(key, value, MDB_FIRST);
+         return with_cursor(txn, [&](MDB_cursor* cursor) noexcept
+         {
+            data_t k, v;
+            status_t status;
+            if (status = mdb_cursor_select(cursor, position, k.data(), v.data()); status.ok())
+            {
+               k.get(key);
+               v.get(value);
+            }
+            return status;
+         });
       }
 
-      status_t first(key_reference key) noexcept
+      // approximate number of keys and leaf bytes in [lo, hi), from two descents of the B-tree
+      status_t estimate(transaction_t& txn, const std::string_view& lo, const std::string_view& hi, range_estimate_t& est) noexcept
       {
-         return get(key, MDB_FIRST);
+         MDB_stat stat;
+         double flo{ 0.0 }, fhi{ 0.0 };
+         status_t status;
+         est = range_estimate_t();
+         status = with_cursor(txn, [&](MDB_cursor* cursor) noexcept
+         {
+            status_t status = fraction(cursor, lo, flo);
+            return status.ok() ? fraction(cursor, hi, fhi) : status;
+         });
+         if (status.nok())
+         {
+            return status;
+         }
+         if (status = mdb_stat(txn.handle(), id_, &stat); status.ok() && fhi > flo)
+         {
+            est.entries = static_cast<size_t>((fhi - flo) * stat.ms_entries + 0.5);
+            est.bytes = static_cast<size_t>((fhi - flo) * (stat.ms_leaf_pages + stat.ms_overflow_pages) * stat.ms_psize + 0.5);
+         }
+         return status;
       }
 
-      status_t first() noexcept
+      // up to n keys that split the store into n + 1 parts of about the same number of keys
+      status_t split(transaction_t& txn, size_t n, std::vector<std::string>& keys) noexcept
       {
-         key_type k;
-         return first(k);
+         keys.clear();
+         return with_cursor(txn, [&](MDB_cursor* cursor) noexcept
+         {
+            return split(cursor, 0.0, 1.0, n, keys);
+         });
       }
 
-      status_t last(key_reference key, value_reference value) noexcept
+      // up to n keys strictly inside (lo, hi) that split the range into n + 1 parts
+      status_t split(transaction_t& txn, const std::string_view& lo, const std::string_view& hi, size_t n, std::vector<std::string>& keys) noexcept
       {
-         return get(key, value, MDB_LAST);
+         keys.clear();
+         return with_cursor(txn, [&](MDB_cursor* cursor) noexcept
+         {
+            double flo{ 0.0 }, fhi{ 0.0 };
+            status_t status;
+            if (status = fraction(cursor, lo, flo); status.ok())
+            {
+               status = fraction(cursor, hi, fhi);
+            }
+            if (status.ok())
+            {
+               status = split(cursor, flo, fhi, n, keys);
+            }
+            // the estimate may land on or outside the bounds
+            MDB_val lo_key = *data_t(lo).data(), hi_key = *data_t(hi).data();
+            std::vector<std::string>::iterator last = std::remove_if(keys.begin(), keys.end(), [&](const std::string& key) noexcept
+            {
+               MDB_val k = *data_t(key).data();
+               return mdb_cmp(txn.handle(), id_, &k, &lo_key) <= 0 || mdb_cmp(txn.handle(), id_, &k, &hi_key) >= 0;
+            });
+            keys.erase(last, keys.end());
+            return status;
+         });
       }
 
-      status_t last(key_reference key) noexcept
+      // visit n randomly chosen entries, drawn with replacement. Exactly uniform in a store created
+      // with MDB_COUNTED, otherwise near uniform by descending the B-tree weighted by estimated size
+      template <typename URBG, typename F>
+      status_t sample(transaction_t& txn, size_t n, URBG& rng, F&& fn)
       {
-         return get(key, MDB_LAST);
+         status_t status;
+         MDB_cursor* cursor{ nullptr };
+         unsigned int flags{ 0 };
+         if (!opened_)
+         {
+            return status_t(MDB_NOT_OPEN);
+         }
+         if (status = mdb_dbi_flags(txn.handle(), id_, &flags); status.nok())
+         {
+            return status;
+         }
+         size_t total = entries(txn);
+         if (total == 0)
+         {
+            return status;
+         }
+         if (status = mdb_cursor_open(txn.handle(), id_, &cursor); status.nok())
+         {
+            return status;
+         }
+         std::uniform_int_distribution<size_t> rank(0, total - 1);
+         std::uniform_real_distribution<double> fraction(0.0, 1.0);
+         MDB_val k{}, v{};
+         for (size_t i = 0; i < n; ++i)
+         {
+            if (flags & MDB_COUNTED)
+            {
+               status = mdb_cursor_select(cursor, rank(rng), &k, &v);
+            }
+            else
+            {
+               status = mdb_cursor_sample(cursor, fraction(rng), &k, &v);
+            }
+            if (status.nok())
+            {
+               break;
+            }
+            std::string_view key((const char*)k.mv_data, k.mv_size);
+            std::string_view value((const char*)v.mv_data, v.mv_size);
+            if constexpr (std::is_void_v<std::invoke_result_t<F, std::string_view, std::string_view>>)
+            {
+               fn(key, value);
+            }
+            else if (!fn(key, value))
+            {
+               break;
+            }
+         }
+         mdb_cursor_close(cursor);
+         return status;
       }
 
-      status_t last() noexcept
+      // count, sum, minimum and maximum of the values between lo and hi, each read as a T straight
+      // from the memory map. A store created with MDB_DUPSORT | MDB_DUPFIXED is reduced a page of
+      // values at a time. With threads > 1 and a read-only transaction, the range is split and
+      // the parts reduced in parallel, all on the snapshot of txn
+      template <typename T>
+      status_t aggregate(transaction_t& txn, const std::string_view& lo, const std::string_view& hi, aggregate_t<T>& result, range_bounds_t bounds = range_bounds_t::closed_open, size_t threads = 1)
       {
-         key_type k;
-         return last(k);
+         result = aggregate_t<T>();
+         return reduce<T>(txn, lo, hi, bounds, threads, result, [](aggregate_t<T>& part, const void* values, size_t n) noexcept
+         {
+            part.add(values, n);
+         }, [](aggregate_t<T>& total, const aggregate_t<T>& part) noexcept
+         {
+            total.merge(part);
+         });
       }
 
-      status_t next(key_reference key, value_reference value) noexcept
+      // number of values between lo and hi, read as a T, for which pred(value) is true. With
+      // threads > 1 pred is called from several threads at once
+      template <typename T, typename Pred>
+      status_t count_if(transaction_t& txn, const std::string_view& lo, const std::string_view& hi, Pred&& pred, size_t& n, range_bounds_t bounds = range_bounds_t::closed_open, size_t threads = 1)
       {
-         return get(key, value, MDB_NEXT);
+         n = 0;
+         return reduce<T>(txn, lo, hi, bounds, threads, n, [&pred](size_t& part, const void* values, size_t count)
+         {
+            const unsigned char* p = static_cast<const unsigned char*>(values);
+            size_t hits{ 0 };
+            for (size_t i = 0; i < count; ++i)
+            {
+               T value;
+               std::memcpy(&value, p + i * sizeof(T), sizeof(T));
+               hits += pred(value) ? 1 : 0;
+            }
+            part += hits;
+         }, [](size_t& total, size_t part) noexcept
+         {
+            total += part;
+         });
       }
 
-      status_t next(key_reference key) noexcept
+      std::string name() const noexcept
       {
-         return get(key, MDB_NEXT);
+         return name_;
       }
 
-      status_t next() noexcept
+      bool is_open() const noexcept
       {
-         key_type k;
-         return next(k);
+         return opened_;
       }
 
-      status_t prior(key_reference key, value_reference value) noexcept
+      MDB_dbi handle() const noexcept
       {
-         return get(key, value, MDB_PREV);
+         return id_;
       }
 
-      status_t prior(key_reference key) noexcept
+      database_t& database() noexcept
       {
-         return get(key, MDB_PREV);
+         return env_;
       }
 
-      status_t prior() noexcept
+      // begin the read-only txn and open every named store on its snapshot. The handles are
+      // opened in a read transaction of their own, which must commit to keep them, so the names
+      // are read again in txn and the whole thing retried if a store came or went in between
+      static status_t open_all(database_t& env, transaction_t& txn, std::vector<store_t>& stores)
       {
-         key_type k;
-         return prior(k);
+         status_t status;
+         for (int attempt = 0; attempt < OPEN_RETRIES; ++attempt)
+         {
+            std::vector<std::string> names, current;
+            transaction_t lister(env);
+            stores.clear();
+            if (status = lister.begin(transaction_type_t::read_only); status.nok())
+            {
+               return status;
+            }
+            if (status = database_t::list_stores(lister.handle(), names); status.nok())
+            {
+               return status;
+            }
+            for (const std::string& name : names)
+            {
+               store_t store(env);
+               // the main store also holds plain entries, which won't open as a store
+               if (status = store.open(lister, name); status.ok())
+               {
+                  stores.push_back(std::move(store));
+               }
+               else if (status.error() != MDB_INCOMPATIBLE)
+               {
+                  return status;
+               }
+            }
+            if (status = lister.commit(); status.nok())
+            {
+               return status;
+            }
+            if (status = txn.begin(transaction_type_t::read_only); status.nok())
+            {
+               return status;
+            }
+            if (status = database_t::list_stores(txn.handle(), current); status.nok() || current == names)
+            {
+               return status;
+            }
+            txn.abort();
+         }
+         return status_t(MDB_BAD_TXN);
       }
 
-      status_t seek(key_const_reference target_key, value_reference value) noexcept
+   private:
+      // position the cursor with position(), then step in direction while in_range() holds.
+      // Keys and values are handed to fn() as views into the memory map, nothing is copied
+      template <typename Position, typename InRange, typename F>
+      status_t scan(transaction_t& txn, Position&& position, InRange&& in_range, F&& fn, scan_direction_t direction, size_t limit)
       {
-         key_type k{ target_key };
-         if (status_t status = get(k, value, MDB_SET); status.nok())
+         status_t status;
+         MDB_cursor* cursor{ nullptr };
+         if (!opened_)
+         {
+            return status_t(MDB_NOT_OPEN);
+         }
+         if (status = mdb_cursor_open(txn.handle(), id_, &cursor); status.nok())
+         {
+            return status;
+         }
+         MDB_val k{}, v{};
+         MDB_cursor_op step = direction == scan_direction_t::forward ? MDB_NEXT : MDB_PREV;
+         size_t count{ 0 };
+         tracer_t* tracer = env_.tracer();
+         uint64_t start = tracer ? tracer->now() : 0;
+         for (status = position(cursor, k, v); status.ok() && in_range(k); status = mdb_cursor_get(cursor, &k, &v, step))
+         {
+            std::string_view key((const char*)k.mv_data, k.mv_size);
+            std::string_view value((const char*)v.mv_data, v.mv_size);
+            if constexpr (std::is_void_v<std::invoke_result_t<F, std::string_view, std::string_view>>)
+            {
+               fn(key, value);
+            }
+            else if (!fn(key, value))
+            {
+               break;
+            }
+            if (++count == limit)
+            {
+               break;
+            }
+         }
+         mdb_cursor_close(cursor);
+         if (tracer)
+         {
+            if (uint64_t duration = tracer->now() - start; duration >= tracer->min_scan())
+            {
+               tracer->record("scan", start, duration, "keys", count);
+            }
+         }
+         return status.error() == MDB_NOTFOUND ? status_t() : status;
+      }
+
+      template <typename F>
+      status_t with_cursor(transaction_t& txn, F&& fn) noexcept
+      {
+         status_t status;
+         MDB_cursor* cursor{ nullptr };
+         if (!opened_)
+         {
+            return status_t(MDB_NOT_OPEN);
+         }
+         if (status = mdb_cursor_open(txn.handle(), id_, &cursor); status.nok())
+         {
+            return status;
+         }
+         status = fn(cursor);
+         mdb_cursor_close(cursor);
+         return status;
+      }
+
+      // the first key sorting after key; found is false when key is at or past the last key
+      status_t key_after(transaction_t& txn, const std::string_view& key, std::string& next, bool& found) noexcept
+      {
+         found = false;
+         return with_cursor(txn, [&](MDB_cursor* cursor) noexcept
+         {
+            MDB_val target = *data_t(key).data();
+            MDB_val k = target, v;
+            int rc = key.empty() ? mdb_cursor_get(cursor, &k, &v, MDB_FIRST) : mdb_cursor_get(cursor, &k, &v, MDB_SET_RANGE);
+            if (rc == MDB_SUCCESS && !key.empty() && mdb_cmp(txn.handle(), id_, &k, &target) == 0)
+            {
+               rc = mdb_cursor_get(cursor, &k, &v, MDB_NEXT);
+            }
+            if (rc == MDB_NOTFOUND)
+            {
+               return status_t();
+            }
+            if (rc == MDB_SUCCESS)
+            {
+               next.assign(static_cast<const char*>(k.mv_data), k.mv_size);
+               found = true;
+            }
+            return status_t(rc);
+         });
+      }
+
+      // a part of a key range, with bounds as given to scan_range(). An empty lo is the first key
+      struct range_part_t
+      {
+         std::string_view lo;
+         bool lo_inclusive;
+         std::string_view hi;
+         bool hi_inclusive;
+      };
+
+      // cut lo..hi into up to n parts at keys from split(). The parts view lo, hi and keys
+      status_t partition(transaction_t& txn, const std::string_view& lo, const std::string_view& hi, range_bounds_t bounds, size_t n, std::vector<std::string>& keys, std::vector<range_part_t>& parts) noexcept
+      {
+         bool lo_inclusive = bounds == range_bounds_t::closed || bounds == range_bounds_t::closed_open;
+         bool hi_inclusive = bounds == range_bounds_t::closed || bounds == range_bounds_t::open_closed;
+         status_t status;
+         keys.clear();
+         parts.clear();
+         if (n > 1)
+         {
+            if (status = split(txn, lo, hi, n - 1, keys); status.nok())
+            {
+               return status;
+            }
+         }
+         std::string_view from = lo;
+         bool from_inclusive = lo_inclusive;
+         for (const std::string& key : keys)
+         {
+            parts.push_back(range_part_t{ from, from_inclusive, key, false });
+            from = key;
+            from_inclusive = true;
+         }
+         parts.push_back(range_part_t{ from, from_inclusive, hi, hi_inclusive });
+         return status;
+      }
+
+      // reduce the values in lo..hi into result: kernel(partial, values, count) folds in an
+      // array of values, merge(result, partial) combines the results of the parts
+      template <typename T, typename R, typename Kernel, typename Merge>
+      status_t reduce(transaction_t& txn, const std::string_view& lo, const std::string_view& hi, range_bounds_t bounds, size_t threads, R& result, Kernel&& kernel, Merge&& merge)
+      {
+         static_assert(std::is_trivially_copyable_v<T>, "values are copied out of the memory map");
+         std::vector<std::string> keys;
+         std::vector<range_part_t> parts;
+         status_t status;
+         if (!opened_)
+         {
+            return status_t(MDB_NOT_OPEN);
+         }
+         if (status = partition(txn, lo, hi, bounds, txn.type() == transaction_type_t::read_only ? threads : 1, keys, parts); status.nok())
+         {
+            return status;
+         }
+         std::vector<R> partials(parts.size());
+         status = txn.parallel(parts.size(), parts.size(), [&](MDB_txn* txnptr, size_t i)
+         {
+            partials[i] = R{};
+            return reduce_part<T>(txnptr, parts[i], partials[i], kernel);
+         });
+         if (status.ok())
+         {
+            for (const R& partial : partials)
+            {
+               merge(result, partial);
+            }
+         }
+         return status;
+      }
+
+      template <typename T, typename R, typename Kernel>
+      status_t reduce_part(MDB_txn* txnptr, const range_part_t& part, R& partial, Kernel& kernel)
+      {
+         constexpr size_t BATCH = 256;
+         MDB_cursor* cursor{ nullptr };
+         unsigned int flags{ 0 };
+         int rc;
+         if (rc = mdb_dbi_flags(txnptr, id_, &flags); rc != MDB_SUCCESS)
+         {
+            return status_t(rc);
+         }
+         if (rc = mdb_cursor_open(txnptr, id_, &cursor); rc != MDB_SUCCESS)
+         {
+            return status_t(rc);
+         }
+         bool multiple = (flags & (MDB_DUPSORT | MDB_DUPFIXED)) == (MDB_DUPSORT | MDB_DUPFIXED);
+         MDB_val lo_key = *data_t(part.lo).data();
+         MDB_val hi_key = *data_t(part.hi).data();
+         MDB_val k = lo_key, v{};
+         rc = part.lo.empty() ? mdb_cursor_get(cursor, &k, &v, MDB_FIRST) : mdb_cursor_get(cursor, &k, &v, MDB_SET_RANGE);
+         if (rc == MDB_SUCCESS && !part.lo.empty() && !part.lo_inclusive && mdb_cmp(txnptr, id_, &k, &lo_key) == 0)
+         {
+            rc = mdb_cursor_get(cursor, &k, &v, MDB_NEXT_NODUP);
+         }
+         // plain values are gathered into a batch so the kernel always sees an array
+         T batch[BATCH];
+         size_t used{ 0 };
+         for (; rc == MDB_SUCCESS; rc = mdb_cursor_get(cursor, &k, &v, multiple ? MDB_NEXT_NODUP : MDB_NEXT))
+         {
+            if (int c = mdb_cmp(txnptr, id_, &k, &hi_key); c > 0 || (c == 0 && !part.hi_inclusive))
+            {
+               break;
+            }
+            if (v.mv_size != sizeof(T))
+            {
+               rc = MDB_BAD_VALSIZE;
+               break;
+            }
+            if (multiple)
+            {
+               // the duplicates of a key come back a leaf page at a time, already an array
+               for (rc = mdb_cursor_get(cursor, &k, &v, MDB_GET_MULTIPLE); rc == MDB_SUCCESS; rc = mdb_cursor_get(cursor, &k, &v, MDB_NEXT_MULTIPLE))
+               {
+                  kernel(partial, v.mv_data, v.mv_size / sizeof(T));
+               }
+               if (rc != MDB_NOTFOUND)
+               {
+                  break;
+               }
+               continue;
+            }
+            std::memcpy(&batch[used], v.mv_data, sizeof(T));
+            if (++used == BATCH)
+            {
+               kernel(partial, batch, used);
+               used = 0;
+            }
+         }
+         if (used > 0 && (rc == MDB_SUCCESS || rc == MDB_NOTFOUND))
+         {
+            kernel(partial, batch, used);
+         }
+         mdb_cursor_close(cursor);
+         return status_t(rc == MDB_NOTFOUND ? MDB_SUCCESS : rc);
+      }
+
+      // estimated position of the first key not less than key, from 0.0 to 1.0
+      status_t fraction(MDB_cursor* cursor, const std::string_view& key, double& frac) noexcept
+      {
+         MDB_val k = *data_t(key).data(), v;
+         frac = 0.0;
+         if (key.empty())
+         {
+            return status_t();
+         }
+         int rc = mdb_cursor_get(cursor, &k, &v, MDB_SET_RANGE);
+         if (rc == MDB_NOTFOUND)
+         {
+            frac = 1.0;
+            return status_t();
+         }
+         return status_t(rc == MDB_SUCCESS ? mdb_cursor_fraction(cursor, &frac) : rc);
+      }
+
+      status_t split(MDB_cursor* cursor, double flo, double fhi, size_t n, std::vector<std::string>& keys) noexcept
+      {
+         MDB_val k, v;
+         for (size_t i = 1; i <= n && fhi > flo; ++i)
+         {
+            int rc = mdb_cursor_seek_fraction(cursor, flo + (fhi - flo) * i / (n + 1), &k, &v);
+            if (rc == MDB_NOTFOUND)
+            {
+               break;
+            }
+            if (rc != MDB_SUCCESS)
+            {
+               return status_t(rc);
+            }
+            // small stores have fewer distinct keys than boundaries
+            std::string_view key((const char*)k.mv_data, k.mv_size);
+            if (keys.empty() || keys.back() != key)
+            {
+               keys.emplace_back(key);
+            }
+         }
+         return status_t();
+      }
+
+      // MDB_INCOMPATIBLE unless the store was created with MDB_COUNTED. lower_rank() only
+      // finds out when it seeks, which an empty key or a key past the end don't do
+      status_t counted(transaction_t& txn) noexcept
+      {
+         unsigned int flags{ 0 };
+         if (int rc = mdb_dbi_flags(txn.handle(), id_, &flags); rc != MDB_SUCCESS)
+         {
+            return status_t(rc);
+         }
+         return status_t((flags & MDB_COUNTED) ? MDB_SUCCESS : MDB_INCOMPATIBLE);
+      }
+
+      // rank of the first key not less than key, or greater than key when after is set
+      status_t lower_rank(transaction_t& txn, MDB_cursor* cursor, const std::string_view& key, bool after, size_t& position) noexcept
+      {
+         MDB_val target = *data_t(key).data();
+         MDB_val k = target, v;
+         mdb_size_t r{ 0 };
+         if (key.empty())
+         {
+            // no key sorts before the empty key, and lmdb won't seek to it
+            position = 0;
+            return status_t();
+         }
+         int rc = mdb_cursor_get(cursor, &k, &v, MDB_SET_RANGE);
+         if (rc == MDB_SUCCESS && after && mdb_cmp(txn.handle(), id_, &k, &target) == 0)
+         {
+            rc = mdb_cursor_get(cursor, &k, &v, MDB_NEXT);
+         }
+         if (rc == MDB_NOTFOUND)
+         {
+            position = entries(txn);
+            return status_t();
+         }
+         if (rc == MDB_SUCCESS)
+         {
+            rc = mdb_cursor_rank(cursor, &r);
+         }
+         position = static_cast<size_t>(r);
+         return status_t(rc);
+      }
+
+      status_t open_or_create(transaction_t& txn, const std::string& name, unsigned int flags) noexcept
+      {
+         status_t status;
+         if (opened_)
+         {
+            return status_t(MDB_ALREADY_OPEN);
+         }
+         // a plain open of a store already in the catalog needs no lookup in the main store
+         if (flags == 0 && env_.find_store(name, id_))
+         {
+            opened_ = true;
+            name_ = name;
+            return status;
+         }
+         if (status = env_.open_store(txn.handle(), name, flags, id_, txn.type() == transaction_type_t::read_write); status.nok())
+         {
+            return status;
+         }
+         txn.opened(name, id_);
+         opened_ = true;
+         name_ = name;
+         return status;
+      }
+
+      status_t close() noexcept
+      {
+         if (!opened_)
+         {
+            return status_t(MDB_NOT_OPEN);
+         }
+         opened_ = false;
+         name_.clear();
+         return status_t();
+      }
+
+   }; // class table_base_t
+
+   // key orders for ordered_store_t. The built-in orders are LMDB flags, for which the engine
+   // searches pages with its own comparison inlined. Any other order is a stateless function
+   // object returning <0, 0 or >0 for two keys, registered with mdb_set_compare()
+   struct lexical_order_t
+   {
+      static constexpr unsigned int FLAGS = 0;
+
+      int operator()(const std::string_view& a, const std::string_view& b) const noexcept
+      {
+         return a.compare(b);
+      }
+   };
+
+   // compares keys from their last byte to their first
+   struct reverse_order_t
+   {
+      static constexpr unsigned int FLAGS = MDB_REVERSEKEY;
+
+      int operator()(const std::string_view& a, const std::string_view& b) const noexcept
+      {
+         size_t n = std::min(a.size(), b.size());
+         for (size_t i = 1; i <= n; ++i)
+         {
+            unsigned char x = a[a.size() - i], y = b[b.size() - i];
+            if (x != y)
+            {
+               return x < y ? -1 : 1;
+            }
+         }
+         return a.size() < b.size() ? -1 : a.size() > b.size();
+      }
+   };
+
+   // keys are native unsigned int or size_t, all of the same size
+   struct integer_order_t
+   {
+      static constexpr unsigned int FLAGS = MDB_INTEGERKEY;
+
+      int operator()(const std::string_view& a, const std::string_view& b) const noexcept
+      {
+         if (a.size() == sizeof(size_t))
+         {
+            return compare<size_t>(a, b);
+         }
+         return compare<unsigned int>(a, b);
+      }
+
+   private:
+      template <typename T>
+      static int compare(const std::string_view& a, const std::string_view& b) noexcept
+      {
+         T x, y;
+         std::memcpy(&x, a.data(), sizeof(T));
+         std::memcpy(&y, b.data(), sizeof(T));
+         return x < y ? -1 : x > y;
+      }
+   };
+
+   // a store whose keys sort in the order of Compare. The order is set every time the store is
+   // opened, so unlike store_t it is only opened in a transaction
+   template <typename Compare = lexical_order_t>
+   class ordered_store_t : public store_t
+   {
+      static constexpr bool BUILTIN = requires { Compare::FLAGS; };
+
+      static_assert(std::is_empty_v<Compare> && std::is_default_constructible_v<Compare>, "the order must be a stateless function object");
+
+      static int compare_keys(const MDB_val* a, const MDB_val* b)
+      {
+         return Compare{}(std::string_view(static_cast<const char*>(a->mv_data), a->mv_size),
+            std::string_view(static_cast<const char*>(b->mv_data), b->mv_size));
+      }
+
+   public:
+      explicit ordered_store_t(database_t& env) noexcept
+         : store_t(env)
+      {}
+
+      status_t create(transaction_t& txn, const std::string& name, unsigned int flags = 0) noexcept
+      {
+         return set_order(txn, store_t::create(txn, name, flags | order_flags()));
+      }
+
+      status_t open(transaction_t& txn, const std::string& name, unsigned int flags = 0) noexcept
+      {
+         return set_order(txn, store_t::open(txn, name, flags | order_flags()));
+      }
+
+      // compare two keys in the order of the store, without a transaction
+      static int compare(const std::string_view& a, const std::string_view& b) noexcept
+      {
+         return Compare{}(a, b);
+      }
+
+      // the function registered with mdb_set_compare(), nullptr for a built-in order. Code
+      // opening the store with mdb_dbi_open(), such as dump_t, has to set it too
+      static constexpr MDB_cmp_func* comparator() noexcept
+      {
+         if constexpr (BUILTIN)
+         {
+            return nullptr;
+         }
+         else
+         {
+            return compare_keys;
+         }
+      }
+
+      // keys sharing a prefix are only next to each other in lexical order. In any other order
+      // store_t::scan_prefix() would stop at the first key without the prefix and miss the rest
+      template <typename F>
+      status_t scan_prefix(transaction_t& txn, const std::string_view& prefix, F&& fn, scan_direction_t direction = scan_direction_t::forward, size_t limit = 0)
+      {
+         static_assert(std::is_same_v<Compare, lexical_order_t>, "scan_prefix() needs lexical_order_t, use scan_range() in other orders");
+         return store_t::scan_prefix(txn, prefix, std::forward<F>(fn), direction, limit);
+      }
+
+   private:
+      static constexpr unsigned int order_flags() noexcept
+      {
+         if constexpr (BUILTIN)
+         {
+            return Compare::FLAGS;
+         }
+         else
+         {
+            return 0;
+         }
+      }
+
+      status_t set_order(transaction_t& txn, status_t status) noexcept
+      {
+         if constexpr (!BUILTIN)
+         {
+            if (status.ok())
+            {
+               status = mdb_set_compare(txn.handle(), handle(), compare_keys);
+            }
+         }
+         return status;
+      }
+   };
+
+   class cursor_t
+   {
+      MDB_cursor* cursor_{ nullptr };
+      store_t& table_;
+
+   public:
+      using key_type = std::string;
+      using key_reference = key_type&;
+      using key_const_reference = const std::string_view&;
+      using value_type = std::string;
+      using value_reference = value_type&;
+      using value_const_reference = const std::string_view&;
+
+      cursor_t() = delete;
+      cursor_t(const cursor_t&) = delete;
+      cursor_t& operator=(cursor_t&& other) = delete;
+      cursor_t& operator=(const cursor_t&) = delete;
+
+      ~cursor_t() noexcept
+      {
+         close();
+      }
+
+      explicit cursor_t(store_t& table) noexcept
+         : table_{ table }
+      {}
+
+      cursor_t(transaction_t& txn, store_t& table)
+         : table_{ table }
+      {
+         if (status_t status = open(txn); status.nok())
+         {
+            throw error_t(status);
+         }
+      }
+
+      status_t open(transaction_t& txn) noexcept
+      {
+         status_t status{ MDB_ALREADY_OPEN };
+         if (cursor_)
+         {
+            return status;
+         }
+         if (status = mdb_cursor_open(txn.handle(), table_.handle(), &cursor_); status.nok())
+         {
+            return status;
+         }
+         return status;
+      }
+
+      status_t close() noexcept
+      {
+         if (cursor_)
+         {
+            mdb_cursor_close(cursor_);
+            cursor_ = nullptr;
+         }
+         return status_t();
+      }
+
+      status_t current(key_reference key, value_reference value) noexcept
+      {
+         return get(key, value, MDB_GET_CURRENT);
+      }
+
+      status_t current(key_reference key) noexcept
+      {
+         return get(key, MDB_GET_CURRENT);
+      }
+
+      status_t first(key_reference key, value_reference value) noexcept
+      {
+         return get(key, value, MDB_FIRST);
+      }
+
+      status_t first(key_reference key) noexcept
+      {
+         return get(key, MDB_FIRST);
+      }
+
+      status_t first() noexcept
+      {
+         key_type k;
+         return first(k);
+      }
+
+      status_t last(key_reference key, value_reference value) noexcept
+      {
+         return get(key, value, MDB_LAST);
+      }
+
+      status_t last(key_reference key) noexcept
+      {
+         return get(key, MDB_LAST);
+      }
+
+      status_t last() noexcept
+      {
+         key_type k;
+         return last(k);
+      }
+
+      status_t next(key_reference key, value_reference value) noexcept
+      {
+         return get(key, value, MDB_NEXT);
+      }
+
+      status_t next(key_reference key) noexcept
+      {
+         return get(key, MDB_NEXT);
+      }
+
+      status_t next() noexcept
+      {
+         key_type k;
+         return next(k);
+      }
+
+      status_t prior(key_reference key, value_reference value) noexcept
+      {
+         return get(key, value, MDB_PREV);
+      }
+
+      status_t prior(key_reference key) noexcept
+      {
+         return get(key, MDB_PREV);
+      }
+
+      status_t prior() noexcept
+      {
+         key_type k;
+         return prior(k);
+      }
+
+      status_t seek(key_const_reference target_key, value_reference value) noexcept
+      {
+         key_type k{ target_key };
+         if (status_t status = get(k, value, MDB_SET); status.nok())
+         {
+            return status;
+         }
+         return status_t();
+      }
+
+      status_t seek(key_const_reference target_key) noexcept
+      {
+         value_type v;
+         return seek(target_key, v);
+      }
+
+      status_t find(key_const_reference& target_key, key_reference key, value_reference value) noexcept
+      {
+         key_type k{ target_key };
+         if (status_t status = get(k, value, MDB_SET_KEY); status.nok())
+         {
+            return status;
+         }
+         key = k;
+         return status_t();
+      }
+
+      status_t search(key_const_reference& target_key, key_reference key, value_reference value) noexcept
+      {
+         key_type k{ target_key };
+         if (status_t status = get(k, value, MDB_SET_RANGE); status.nok())
+         {
+            return status;
+         }
+         key = k;
+         return status_t();
+      }
+
+      status_t put(key_const_reference key, value_const_reference value) noexcept
+      {
+         if (!cursor_)
+         {
+            return status_t(MDB_NOT_OPEN);
+         }
+         return status_t(mdb_cursor_put(cursor_, data_t(key).data(), data_t(value).data(), 0));
+      }
+
+      status_t del() noexcept
+      {
+         if (!cursor_)
+         {
+            return status_t(MDB_NOT_OPEN);
+         }
+         return status_t(mdb_cursor_del(cursor_, 0));
+      }
+
+      database_t& database() noexcept
+      {
+         return table_.database();
+      }
+
+      store_t& store() noexcept
+      {
+         return table_;
+      }
+
+      MDB_cursor* handle() noexcept
+      {
+         return cursor_;
+      }
+
+   private:
+      status_t get(key_reference key, value_reference value, MDB_cursor_op op) noexcept
+      {
+         status_t status{ MDB_NOT_OPEN };
+         data_t k;
+         data_t v;
+         if (!cursor_)
+         {
+            return status;
+         }
+         if (is_set_operation(op))
+         {
+            k.set(key);
+         }
+         if (status = mdb_cursor_get(cursor_, k.data(), v.data(), op); status.nok())
+         {
+            return status;
+         }
+         if (op != MDB_SET)
+         {
+            k.get(key);
+            v.get(value);
+         }
+         return status;
+      }
+
+      status_t get(key_reference key, MDB_cursor_op op) noexcept
+      {
+         status_t status{ MDB_NOT_OPEN };
+         data_t k;
+         data_t v;
+         if (!cursor_)
+         {
+            return status;
+         }
+         if (is_set_operation(op))
+         {
+            k.set(key);
+         }
+         if (status = mdb_cursor_get(cursor_, k.data(), v.data(), op); status.nok())
+         {
+            return status;
+         }
+         if (op != MDB_SET)
+         {
+            k.get(key);
+         }
+         return status;
+      }
+
+      bool is_set_operation(MDB_cursor_op op) noexcept
+      {
+         return (op == MDB_SET || op == MDB_SET_KEY || op == MDB_SET_RANGE);
+      }
+   }; // class cursor_base_t
+
+   // collects puts and deletes for one or more stores, then applies them in key order through one
+   // cursor per store. Only the last operation on each key is applied
+   class batch_t
+   {
+      struct operation_t
+      {
+         store_t* store;
+         std::string key;
+         std::string value;
+         bool del;
+      };
+
+      std::vector<operation_t> ops_;
+
+   public:
+      batch_t() = default;
+      batch_t(const batch_t&) = delete;
+      batch_t& operator=(const batch_t&) = delete;
+      batch_t(batch_t&&) noexcept = default;
+      batch_t& operator=(batch_t&&) noexcept = default;
+
+      void put(store_t& store, const std::string_view& key, const std::string_view& value)
+      {
+         ops_.push_back(operation_t{ &store, std::string(key), std::string(value), false });
+      }
+
+      void del(store_t& store, const std::string_view& key)
+      {
+         ops_.push_back(operation_t{ &store, std::string(key), std::string(), true });
+      }
+
+      size_t size() const noexcept
+      {
+         return ops_.size();
+      }
+
+      bool empty() const noexcept
+      {
+         return ops_.empty();
+      }
+
+      void clear() noexcept
+      {
+         ops_.clear();
+      }
+
+      // find the last operation on key: returns true and sets deleted, and value for a put. In
+      // a MDB_DUPSORT store that put is one of the values the key may hold after apply()
+      bool find(const store_t& store, const std::string_view& key, std::string_view& value, bool& deleted) const noexcept
+      {
+         for (auto op = ops_.rbegin(); op != ops_.rend(); ++op)
+         {
+            if (op->store->handle() == store.handle() && op->key == key)
+            {
+               deleted = op->del;
+               value = deleted ? std::string_view() : std::string_view(op->value);
+               return true;
+            }
+         }
+         return false;
+      }
+
+      // apply the batch within a read-write transaction and clear it. Deleting a key that
+      // doesn't exist is not an error
+      status_t apply(transaction_t& txn) noexcept
+      {
+         status_t status;
+         MDB_txn* txnptr = txn.handle();
+         if (!txnptr)
+         {
+            return status_t(MDB_TRANSACTION_HANDLE_NULL);
+         }
+         for (const operation_t& op : ops_)
+         {
+            if (!op.store->is_open())
+            {
+               return status_t(MDB_NOT_OPEN);
+            }
+         }
+         // stable, so the operations on one key keep their order and the last one wins
+         std::stable_sort(ops_.begin(), ops_.end(), [txnptr](const operation_t& a, const operation_t& b) noexcept
+         {
+            if (a.store->handle() != b.store->handle())
+            {
+               return a.store->handle() < b.store->handle();
+            }
+            MDB_val ka = *data_t(a.key).data(), kb = *data_t(b.key).data();
+            return mdb_cmp(txnptr, a.store->handle(), &ka, &kb) < 0;
+         });
+         MDB_cursor* cursor{ nullptr };
+         std::string last;
+         bool has_last{ false };
+         bool dupsort{ false };
+         for (size_t i = 0; i < ops_.size() && status.ok(); ++i)
+         {
+            const operation_t& op = ops_[i];
+            MDB_dbi dbi = op.store->handle();
+            if (i == 0 || ops_[i - 1].store->handle() != dbi)
+            {
+               unsigned int flags{ 0 };
+               if (status = mdb_dbi_flags(txnptr, dbi, &flags); status.nok())
+               {
+                  break;
+               }
+               dupsort = (flags & MDB_DUPSORT) != 0;
+            }
+            if (i + 1 < ops_.size() && ops_[i + 1].store->handle() == dbi && equal_keys(txnptr, dbi, op.key, ops_[i + 1].key) &&
+               (!dupsort || supersedes(txnptr, dbi, ops_[i + 1], op)))
+            {
+               continue;
+            }
+            if (!cursor || mdb_cursor_dbi(cursor) != dbi)
+            {
+               if (cursor)
+               {
+                  mdb_cursor_close(cursor);
+                  cursor = nullptr;
+               }
+               if (status = mdb_cursor_open(txnptr, dbi, &cursor); status.nok())
+               {
+                  break;
+               }
+               // keys past the current last key can be appended without a search
+               MDB_val lk, v;
+               int rc = mdb_cursor_get(cursor, &lk, &v, MDB_LAST);
+               if (rc != MDB_SUCCESS && rc != MDB_NOTFOUND)
+               {
+                  status = rc;
+                  break;
+               }
+               // copied, as the puts before the first append may move the page
+               has_last = rc == MDB_SUCCESS;
+               last.assign((const char*)lk.mv_data, has_last ? lk.mv_size : 0);
+            }
+            MDB_val k = *data_t(op.key).data();
+            if (op.del)
+            {
+               MDB_val v;
+               int rc = mdb_cursor_get(cursor, &k, &v, MDB_SET);
+               if (rc == MDB_SUCCESS)
+               {
+                  // all the values of the key in a MDB_DUPSORT store
+                  rc = mdb_cursor_del(cursor, MDB_NODUPDATA);
+               }
+               status = rc == MDB_NOTFOUND ? MDB_SUCCESS : rc;
+            }
+            else
+            {
+               MDB_val v = *data_t(op.value).data();
+               MDB_val lk = *data_t(last).data();
+               bool append = !has_last || mdb_cmp(txnptr, dbi, &k, &lk) > 0;
+               if (status = mdb_cursor_put(cursor, &k, &v, append ? MDB_APPEND : 0); status.ok() && append)
+               {
+                  // once one key is appended, all the ones after it can be too, but in a
+                  // MDB_DUPSORT store the next value may be for the same key
+                  has_last = dupsort;
+                  if (dupsort)
+                  {
+                     last = op.key;
+                  }
+               }
+            }
+         }
+         if (cursor)
+         {
+            mdb_cursor_close(cursor);
+         }
+         LMDBPP_PROBE3(batch__apply, txnptr, ops_.size(), status.error());
+         if (status.ok())
+         {
+            ops_.clear();
+         }
+         return status;
+      }
+
+   private:
+      static bool equal_keys(MDB_txn* txnptr, MDB_dbi dbi, const std::string& a, const std::string& b) noexcept
+      {
+         MDB_val ka = *data_t(a).data(), kb = *data_t(b).data();
+         return mdb_cmp(txnptr, dbi, &ka, &kb) == 0;
+      }
+
+      // in a MDB_DUPSORT store a key holds several values, so a later operation on the same key
+      // only makes an earlier one useless if it deletes them all or puts the same value again
+      static bool supersedes(MDB_txn* txnptr, MDB_dbi dbi, const operation_t& later, const operation_t& earlier) noexcept
+      {
+         if (later.del)
+         {
+            return true;
+         }
+         MDB_val va = *data_t(later.value).data(), vb = *data_t(earlier.value).data();
+         return !earlier.del && mdb_dcmp(txnptr, dbi, &va, &vb) == 0;
+      }
+   }; // class batch_t
+
+   // an update that reads from a read-only snapshot and keeps its writes in a batch_t, so the
+   // writer lock is held by commit() only to check that the values read are unchanged and to
+   // apply the writes. When one changed commit() returns MDB_CONFLICT and the update has to run
+   // again, which run() does. Only get() is tracked: a key read as missing conflicts when it is
+   // added, but keys added within a range scanned another way are not seen
+   class optimistic_transaction_t
+   {
+      struct read_t
+      {
+         store_t* store;
+         std::string key;
+         size_t hash;
+         bool found;
+      };
+
+      database_t& env_;
+      transaction_t snapshot_;
+      size_t snapshot_id_{ 0 };
+      std::vector<read_t> reads_;
+      batch_t writes_;
+
+   public:
+      optimistic_transaction_t() = delete;
+      optimistic_transaction_t(const optimistic_transaction_t&) = delete;
+      optimistic_transaction_t& operator=(const optimistic_transaction_t&) = delete;
+
+      explicit optimistic_transaction_t(database_t& env) noexcept
+         : env_{ env }
+         , snapshot_{ env }
+      {}
+
+      // take a new snapshot and forget the reads and writes of the last update
+      status_t begin() noexcept
+      {
+         status_t status;
+         abort();
+         if (status = snapshot_.begin(transaction_type_t::read_only); status.ok())
+         {
+            snapshot_id_ = snapshot_.id();
+         }
+         return status;
+      }
+
+      // read the value of key as written by this update, or else as in the snapshot. value
+      // stays valid until commit() or abort()
+      status_t get(store_t& store, const std::string_view& key, std::string_view& value)
+      {
+         status_t status;
+         bool deleted{ false };
+         unsigned int flags{ 0 };
+         if (!snapshot_.started())
+         {
+            return status_t(MDB_TRANSACTION_HANDLE_NULL);
+         }
+         // a key of a MDB_DUPSORT store holds several values, which the batch can't tell
+         if (status = mdb_dbi_flags(snapshot_.handle(), store.handle(), &flags); status.nok())
+         {
+            return status;
+         }
+         if (flags & MDB_DUPSORT)
+         {
+            return status_t(MDB_INCOMPATIBLE);
+         }
+         if (writes_.find(store, key, value, deleted))
+         {
+            return status_t(deleted ? MDB_NOTFOUND : MDB_SUCCESS);
+         }
+         if (status = store.get(snapshot_, key, value); status.ok() || status.error() == MDB_NOTFOUND)
+         {
+            reads_.push_back(read_t{ &store, std::string(key), status.ok() ? hash(value) : 0, status.ok() });
+         }
+         return status;
+      }
+
+      status_t get(store_t& store, const std::string_view& key, std::string& value)
+      {
+         std::string_view v;
+         status_t status = get(store, key, v);
+         if (status.ok())
+         {
+            value.assign(v);
+         }
+         return status;
+      }
+
+      void put(store_t& store, const std::string_view& key, const std::string_view& value)
+      {
+         writes_.put(store, key, value);
+      }
+
+      void del(store_t& store, const std::string_view& key)
+      {
+         writes_.del(store, key);
+      }
+
+      // end the snapshot, then in a read-write transaction check the values read and apply the
+      // writes. When nothing was committed since the snapshot there is nothing to check
+      status_t commit() noexcept
+      {
+         status_t status;
+         if (!snapshot_.started())
+         {
+            return status_t(MDB_TRANSACTION_HANDLE_NULL);
+         }
+         snapshot_.abort();
+         if (writes_.empty())
+         {
+            reads_.clear();
+            return status;
+         }
+         transaction_t txn(env_);
+         if (status = txn.begin(transaction_type_t::read_write); status.nok())
+         {
+            return status;
+         }
+         if (txn.id() != snapshot_id_ + 1)
+         {
+            for (const read_t& read : reads_)
+            {
+               std::string_view value;
+               if (status = read.store->get(txn, read.key, value); status.nok() && status.error() != MDB_NOTFOUND)
+               {
+                  return status;
+               }
+               if (status.ok() != read.found || (read.found && hash(value) != read.hash))
+               {
+                  LMDBPP_PROBE3(optimistic__conflict, snapshot_id_, txn.id(), reads_.size());
+                  return status_t(MDB_CONFLICT);
+               }
+            }
+         }
+         if (status = writes_.apply(txn); status.ok())
+         {
+            status = txn.commit();
+         }
+         reads_.clear();
+         return status;
+      }
+
+      status_t abort() noexcept
+      {
+         reads_.clear();
+         writes_.clear();
+         if (snapshot_.started())
+         {
+            return snapshot_.abort();
+         }
+         return status_t();
+      }
+
+      // begin(), fn(*this), commit() until the commit doesn't conflict, at most attempts times.
+      // fn returns a status_t; when it fails the update is abandoned and its status returned
+      template <typename F>
+      status_t run(F&& fn, size_t attempts = 16)
+      {
+         status_t status(MDB_CONFLICT);
+         for (size_t i = 0; i < attempts && status.error() == MDB_CONFLICT; ++i)
+         {
+            if (status = begin(); status.nok())
+            {
+               break;
+            }
+            if (status = fn(*this); status.nok())
+            {
+               abort();
+               break;
+            }
+            status = commit();
+         }
+         return status;
+      }
+
+      // id of the snapshot the update reads from
+      size_t id() const noexcept
+      {
+         return snapshot_id_;
+      }
+
+   private:
+      static size_t hash(const std::string_view& value) noexcept
+      {
+         return std::hash<std::string_view>{}(value);
+      }
+   }; // class optimistic_transaction_t
+
+   // hands out increasing ids without a write transaction per id. The next free id is kept under
+   // a key of a store, and ids are reserved from it block ids at a time in a short read-write
+   // transaction; the ids of a block are then taken with a compare-and-swap. The ids left in a
+   // block when the process ends are never used, and when several processes share the sequence
+   // their ids interleave block by block
+   class sequence_t
+   {
+      store_t& store_;
+      std::string name_;
+      uint64_t block_;
+      std::atomic<uint64_t> next_{ 0 };
+      std::atomic<uint64_t> end_{ 0 };
+      std::mutex reserve_;
+
+   public:
+      static constexpr uint64_t DEFAULT_BLOCK = 1000;
+      static constexpr size_t KEY_SIZE = sizeof(uint64_t);
+
+      sequence_t() = delete;
+      sequence_t(const sequence_t&) = delete;
+      sequence_t& operator=(const sequence_t&) = delete;
+
+      // the ids are counted under name in store, which has to be open
+      sequence_t(store_t& store, const std::string_view& name, uint64_t block = DEFAULT_BLOCK)
+         : store_{ store }
+         , name_{ name }
+         , block_{ block > 0 ? block : 1 }
+      {}
+
+      // the first id is 1. When the block is used up this starts a read-write transaction, so it
+      // can't be called by a thread that has one open
+      status_t next(uint64_t& id) noexcept
+      {
+         for (;;)
+         {
+            if (take(id))
+            {
+               return status_t();
+            }
+            std::lock_guard<std::mutex> lock(reserve_);
+            // another thread may have reserved a block while this one waited
+            if (take(id))
+            {
+               return status_t();
+            }
+            if (status_t status = reserve(); status.nok())
+            {
+               return status;
+            }
+         }
+      }
+
+      // the id as a big-endian key, so a store keyed by ids sorts in id order and is filled
+      // with store_t::append()
+      static constexpr std::array<char, KEY_SIZE> key(uint64_t id) noexcept
+      {
+         return key_codec_t<uint64_t>::encode_fixed(id);
+      }
+
+      static uint64_t id(const std::string_view& key) noexcept
+      {
+         key_codec_t<uint64_t>::values_t values{};
+         key_codec_t<uint64_t>::decode(key, values);
+         return std::get<0>(values);
+      }
+
+      // ids left in the reserved block
+      uint64_t available() const noexcept
+      {
+         uint64_t next = next_, end = end_;
+         return next < end ? end - next : 0;
+      }
+
+   private:
+      bool take(uint64_t& id) noexcept
+      {
+         uint64_t next = next_;
+         // end_ is only read after next_: a new block stores next_ first, so an id of the old
+         // block can't be taken against the end of the new one
+         while (next < end_)
+         {
+            if (next_.compare_exchange_weak(next, next + 1))
+            {
+               id = next;
+               return true;
+            }
+         }
+         return false;
+      }
+
+      status_t reserve() noexcept
+      {
+         status_t status;
+         transaction_t txn(store_.database());
+         std::string_view value;
+         uint64_t first{ 1 };
+         if (status = txn.begin(transaction_type_t::read_write); status.nok())
+         {
+            return status;
+         }
+         if (status = store_.get(txn, name_, value); status.ok())
+         {
+            // anything but a counter under the name must not restart the sequence at 1
+            if (value.size() != sizeof(first))
+            {
+               return status_t(MDB_BAD_VALSIZE);
+            }
+            std::memcpy(&first, value.data(), sizeof(first));
+         }
+         else if (status.error() != MDB_NOTFOUND)
          {
             return status;
          }
+         uint64_t end = first + block_;
+         if (status = store_.put(txn, name_, std::string_view(reinterpret_cast<const char*>(&end), sizeof(end))); status.ok())
+         {
+            status = txn.commit();
+         }
+         if (status.ok())
+         {
+            next_ = first;
+            end_ = end;
+         }
+         LMDBPP_PROBE3(sequence__reserve, name_.c_str(), first, status.error());
+         return status;
+      }
+   }; // class sequence_t
+
+   // stores the samples of many time series in compressed blocks, one entry per series and time
+   // bucket. As in Facebook's Gorilla, timestamps are kept as deltas of deltas and values are XORed
+   // with the previous value, so samples taken at a steady rate with slowly changing values need
+   // only a few bits each
+   class timeseries_store_t
+   {
+      // a block is a header_t followed by a bit stream. The header carries the encoder state, so
+      // a sample is appended to a block without decoding it
+      struct header_t
+      {
+         uint32_t count;
+         uint32_t bits;
+         int64_t first_time;
+         int64_t last_time;
+         int64_t last_delta;
+         uint64_t last_value;
+         uint8_t leading;
+         uint8_t trailing;
+         uint8_t reserved[6];
+      };
+
+      static constexpr uint8_t NO_WINDOW = 0xff;
+
+      store_t store_;
+      int64_t bucket_width_;
+      std::vector<int64_t> times_;
+      std::vector<double> values_;
+
+   public:
+      static constexpr int64_t DEFAULT_BUCKET_WIDTH = 2 * 60 * 60 * 1000;
+
+      // bucket_width is in the same unit as the timestamps, milliseconds by default
+      explicit timeseries_store_t(database_t& env, int64_t bucket_width = DEFAULT_BUCKET_WIDTH) noexcept
+         : store_{ env }
+         , bucket_width_{ bucket_width > 0 ? bucket_width : DEFAULT_BUCKET_WIDTH }
+      {}
+
+      timeseries_store_t(const timeseries_store_t&) = delete;
+      timeseries_store_t& operator=(const timeseries_store_t&) = delete;
+
+      status_t create(transaction_t& txn, const std::string& name) noexcept
+      {
+         return store_.create(txn, name);
+      }
+
+      status_t open(transaction_t& txn, const std::string& name) noexcept
+      {
+         return store_.open(txn, name);
+      }
+
+      status_t close(transaction_t& txn) noexcept
+      {
+         return store_.close(txn);
+      }
+
+      status_t drop(transaction_t& txn) noexcept
+      {
+         return store_.drop(txn);
+      }
+
+      // add a sample to a series. Within a bucket, samples must come in time order
+      status_t append(transaction_t& txn, const std::string_view& series, int64_t time, double value) noexcept
+      {
+         ts_sample_t sample{ time, value };
+         return append(txn, series, &sample, 1);
+      }
+
+      // add samples in time order to a series, reading and writing each bucket's block once
+      status_t append(transaction_t& txn, const std::string_view& series, const std::vector<ts_sample_t>& samples) noexcept
+      {
+         return append(txn, series, samples.data(), samples.size());
+      }
+
+      // visit the samples of a series with from <= time < to in time order. fn(time, value) may
+      // return false to stop early
+      template <typename F>
+      status_t query(transaction_t& txn, const std::string_view& series, int64_t from, int64_t to, F&& fn)
+      {
+         if (series.find('\0') != std::string_view::npos)
+         {
+            return status_t(EINVAL);
+         }
+         if (from >= to)
+         {
+            return status_t();
+         }
+         std::string lo = make_key(series, bucket(from));
+         std::string hi = make_key(series, bucket(to - 1));
+         status_t result;
+         status_t status = store_.scan_range(txn, lo, hi, [&](std::string_view, std::string_view block)
+         {
+            if (result = decode(block); result.nok())
+            {
+               return false;
+            }
+            // the samples of a block are sorted by time, so only the ends need trimming
+            size_t first = std::lower_bound(times_.begin(), times_.end(), from) - times_.begin();
+            size_t last = std::lower_bound(times_.begin(), times_.end(), to) - times_.begin();
+            for (size_t i = first; i < last; ++i)
+            {
+               if constexpr (std::is_void_v<std::invoke_result_t<F, int64_t, double>>)
+               {
+                  fn(times_[i], values_[i]);
+               }
+               else if (!fn(times_[i], values_[i]))
+               {
+                  return false;
+               }
+            }
+            return true;
+         }, range_bounds_t::closed);
+         return status.ok() ? result : status;
+      }
+
+      status_t query(transaction_t& txn, const std::string_view& series, int64_t from, int64_t to, std::vector<ts_sample_t>& samples)
+      {
+         samples.clear();
+         return query(txn, series, from, to, [&samples](int64_t time, double value) { samples.push_back(ts_sample_t{ time, value }); });
+      }
+
+      // number of blocks in the store
+      size_t blocks(transaction_t& txn) noexcept
+      {
+         return store_.entries(txn);
+      }
+
+      int64_t bucket_width() const noexcept
+      {
+         return bucket_width_;
+      }
+
+      bool is_open() const noexcept
+      {
+         return store_.is_open();
+      }
+
+      store_t& store() noexcept
+      {
+         return store_;
+      }
+
+   private:
+      int64_t bucket(int64_t time) const noexcept
+      {
+         int64_t start = time / bucket_width_ * bucket_width_;
+         return start > time ? start - bucket_width_ : start;
+      }
+
+      // series name, a zero byte, then the bucket start big-endian with the sign bit flipped, so
+      // the blocks of a series sort by time
+      static std::string make_key(const std::string_view& series, int64_t start)
+      {
+         std::string key;
+         key.reserve(series.size() + 9);
+         key.append(series);
+         key.push_back('\0');
+         uint64_t u = static_cast<uint64_t>(start) ^ (uint64_t(1) << 63);
+         for (int shift = 56; shift >= 0; shift -= 8)
+         {
+            key.push_back(static_cast<char>(u >> shift));
+         }
+         return key;
+      }
+
+      status_t append(transaction_t& txn, const std::string_view& series, const ts_sample_t* samples, size_t n) noexcept
+      {
+         status_t status;
+         if (!store_.is_open())
+         {
+            return status_t(MDB_NOT_OPEN);
+         }
+         if (series.find('\0') != std::string_view::npos)
+         {
+            return status_t(EINVAL);
+         }
+         std::string key, block, ignore;
+         header_t h{};
+         for (size_t i = 0; i < n && status.ok();)
+         {
+            // samples of one bucket in a row share a read and a write of the block
+            int64_t start = bucket(samples[i].time);
+            key = make_key(series, start);
+            block.clear();
+            if (status = store_.get(txn, key, ignore, block); status.ok())
+            {
+               if (block.size() < sizeof(header_t))
+               {
+                  return status_t(MDB_CORRUPTED);
+               }
+               std::memcpy(&h, block.data(), sizeof(h));
+            }
+            else if (status.error() == MDB_NOTFOUND)
+            {
+               status = MDB_SUCCESS;
+               h = header_t{};
+               block.assign(sizeof(header_t), '\0');
+            }
+            else
+            {
+               return status;
+            }
+            for (; i < n && bucket(samples[i].time) == start; ++i)
+            {
+               if (h.count > 0 && samples[i].time < h.last_time)
+               {
+                  return status_t(MDB_TS_OUT_OF_ORDER);
+               }
+               encode(block, h, samples[i]);
+            }
+            std::memcpy(block.data(), &h, sizeof(h));
+            status = store_.put(txn, key, block);
+         }
+         return status;
+      }
+
+      static void write_bits(std::string& block, uint32_t& pos, uint64_t value, unsigned int n)
+      {
+         // most significant bit first
+         while (n > 0)
+         {
+            size_t byte = sizeof(header_t) + pos / 8;
+            if (byte >= block.size())
+            {
+               block.push_back('\0');
+            }
+            unsigned int room = 8 - pos % 8;
+            unsigned int take = std::min(room, n);
+            unsigned int chunk = static_cast<unsigned int>(value >> (n - take)) & ((1u << take) - 1);
+            block[byte] = static_cast<char>(static_cast<uint8_t>(block[byte]) | (chunk << (room - take)));
+            pos += take;
+            n -= take;
+         }
+      }
+
+      static void encode(std::string& block, header_t& h, const ts_sample_t& sample)
+      {
+         uint64_t bits = std::bit_cast<uint64_t>(sample.value);
+         if (h.count == 0)
+         {
+            h.first_time = h.last_time = sample.time;
+            h.last_delta = 0;
+            h.leading = NO_WINDOW;
+            write_bits(block, h.bits, bits, 64);
+         }
+         else
+         {
+            int64_t delta = sample.time - h.last_time;
+            int64_t dod = delta - h.last_delta;
+            if (dod == 0)
+            {
+               write_bits(block, h.bits, 0, 1);
+            }
+            else if (dod >= -64 && dod < 64)
+            {
+               write_bits(block, h.bits, 0b10, 2);
+               write_bits(block, h.bits, static_cast<uint64_t>(dod), 7);
+            }
+            else if (dod >= -256 && dod < 256)
+            {
+               write_bits(block, h.bits, 0b110, 3);
+               write_bits(block, h.bits, static_cast<uint64_t>(dod), 9);
+            }
+            else if (dod >= -2048 && dod < 2048)
+            {
+               write_bits(block, h.bits, 0b1110, 4);
+               write_bits(block, h.bits, static_cast<uint64_t>(dod), 12);
+            }
+            else
+            {
+               write_bits(block, h.bits, 0b1111, 4);
+               write_bits(block, h.bits, static_cast<uint64_t>(dod), 64);
+            }
+            h.last_time = sample.time;
+            h.last_delta = delta;
+
+            uint64_t x = bits ^ h.last_value;
+            if (x == 0)
+            {
+               write_bits(block, h.bits, 0, 1);
+            }
+            else
+            {
+               unsigned int leading = std::min(std::countl_zero(x), 31);
+               unsigned int trailing = std::countr_zero(x);
+               if (h.leading != NO_WINDOW && leading >= h.leading && trailing >= h.trailing)
+               {
+                  // the changed bits fit in the previous window
+                  write_bits(block, h.bits, 0b10, 2);
+                  write_bits(block, h.bits, x >> h.trailing, 64 - h.leading - h.trailing);
+               }
+               else
+               {
+                  unsigned int length = 64 - leading - trailing;
+                  write_bits(block, h.bits, 0b11, 2);
+                  write_bits(block, h.bits, leading, 5);
+                  write_bits(block, h.bits, length - 1, 6);
+                  write_bits(block, h.bits, x >> trailing, length);
+                  h.leading = static_cast<uint8_t>(leading);
+                  h.trailing = static_cast<uint8_t>(trailing);
+               }
+            }
+         }
+         h.last_value = bits;
+         h.count++;
+      }
+
+      class bit_reader_t
+      {
+         const uint8_t* data_;
+         size_t size_;
+         size_t pos_{ 0 };
+
+      public:
+         bit_reader_t(const uint8_t* data, size_t bits) noexcept
+            : data_{ data }
+            , size_{ bits }
+         {}
+
+         bool overrun() const noexcept
+         {
+            return pos_ > size_;
+         }
+
+         uint64_t read(unsigned int n) noexcept
+         {
+            uint64_t value{ 0 };
+            if (pos_ + n > size_)
+            {
+               pos_ = size_ + 1;
+               return 0;
+            }
+            while (n > 0)
+            {
+               unsigned int room = 8 - pos_ % 8;
+               unsigned int take = std::min(room, n);
+               unsigned int chunk = (data_[pos_ / 8] >> (room - take)) & ((1u << take) - 1);
+               value = (value << take) | chunk;
+               pos_ += take;
+               n -= take;
+            }
+            return value;
+         }
+
+         int64_t read_signed(unsigned int n) noexcept
+         {
+            return static_cast<int64_t>(read(n) << (64 - n)) >> (64 - n);
+         }
+      };
+
+      // decode a whole block into times_ and values_
+      status_t decode(std::string_view block)
+      {
+         header_t h;
+         if (block.size() < sizeof(header_t))
+         {
+            return status_t(MDB_CORRUPTED);
+         }
+         std::memcpy(&h, block.data(), sizeof(h));
+         if (block.size() - sizeof(header_t) < (size_t(h.bits) + 7) / 8)
+         {
+            return status_t(MDB_CORRUPTED);
+         }
+         times_.resize(h.count);
+         values_.resize(h.count);
+         bit_reader_t in(reinterpret_cast<const uint8_t*>(block.data()) + sizeof(header_t), h.bits);
+         int64_t time = h.first_time, delta = 0;
+         uint64_t bits{ 0 };
+         unsigned int leading{ 0 }, trailing{ 0 };
+         for (uint32_t i = 0; i < h.count; ++i)
+         {
+            if (i == 0)
+            {
+               bits = in.read(64);
+            }
+            else
+            {
+               if (in.read(1) == 1)
+               {
+                  if (in.read(1) == 0)
+                  {
+                     delta += in.read_signed(7);
+                  }
+                  else if (in.read(1) == 0)
+                  {
+                     delta += in.read_signed(9);
+                  }
+                  else if (in.read(1) == 0)
+                  {
+                     delta += in.read_signed(12);
+                  }
+                  else
+                  {
+                     delta += static_cast<int64_t>(in.read(64));
+                  }
+               }
+               time += delta;
+               if (in.read(1) == 1)
+               {
+                  if (in.read(1) == 1)
+                  {
+                     leading = static_cast<unsigned int>(in.read(5));
+                     trailing = 64 - leading - static_cast<unsigned int>(in.read(6) + 1);
+                  }
+                  bits ^= in.read(64 - leading - trailing) << trailing;
+               }
+            }
+            if (in.overrun())
+            {
+               return status_t(MDB_CORRUPTED);
+            }
+            times_[i] = time;
+            values_[i] = std::bit_cast<double>(bits);
+         }
          return status_t();
       }
+   }; // class timeseries_store_t
 
-      status_t seek(key_const_reference target_key) noexcept
+   // binary dump and load of every named store of an environment. save() writes one file per
+   // part of each store, all parts read on worker threads from the same snapshot; load() parses
+   // the files on worker threads and appends their entries, already in key order, with
+   // MDB_APPEND on the calling thread
+   class dump_t
+   {
+      static constexpr char MAGIC[8] = { 'L', 'M', 'D', 'B', 'P', 'P', 'D', '1' };
+      static constexpr uint32_t COMPRESSED = 1;
+      static constexpr size_t BUFFER_SIZE = 1024 * 1024;
+      static constexpr size_t BATCH_SIZE = 8 * 1024 * 1024;
+      static constexpr size_t QUEUE_DEPTH = 4;
+      static constexpr uint32_t MAX_NAME = 4096;
+
+      // the header of a dump file
+      struct part_file_t
       {
-         value_type v;
-         return seek(target_key);
-      }
+         std::filesystem::path path;
+         std::string store;
+         uint32_t format{ 0 };
+         uint32_t flags{ 0 };
+         uint32_t part{ 0 };
+         uint32_t parts{ 0 };
+      };
 
-      status_t find(key_const_reference& target_key, key_reference key, value_reference value) noexcept
+      // entries parsed from a dump file, ready for the writer
+      struct entry_t
       {
-         key_type k{ target_key };
-         if (status_t status = get(k, value, MDB_SET_KEY); status.nok())
+         size_t key;
+         size_t key_size;
+         size_t value;
+         size_t value_size;
+         bool same_key;
+      };
+
+      struct load_batch_t
+      {
+         std::string arena;
+         std::vector<entry_t> entries;
+      };
+
+      // hands the batches of one file from its parser to the writer
+      struct channel_t
+      {
+         std::mutex mutex;
+         std::condition_variable cv;
+         std::deque<load_batch_t> batches;
+         bool done{ false };
+         status_t status;
+      };
+
+      class file_reader_t
+      {
+         std::ifstream in_;
+         std::string buffer_;
+         size_t pos_{ 0 };
+
+      public:
+         explicit file_reader_t(const std::filesystem::path& path)
+            : in_{ path, std::ios::binary }
+         {}
+
+         bool is_open() const noexcept
+         {
+            return in_.is_open();
+         }
+
+         bool read(void* data, size_t size)
+         {
+            char* p = static_cast<char*>(data);
+            while (size > 0)
+            {
+               if (pos_ == buffer_.size() && !fill())
+               {
+                  return false;
+               }
+               size_t n = std::min(size, buffer_.size() - pos_);
+               std::memcpy(p, buffer_.data() + pos_, n);
+               pos_ += n;
+               p += n;
+               size -= n;
+            }
+            return true;
+         }
+
+         bool append(std::string& str, size_t size)
+         {
+            size_t at = str.size();
+            str.resize(at + size);
+            return size == 0 || read(&str[at], size);
+         }
+
+         bool varint(uint64_t& value)
+         {
+            value = 0;
+            for (int shift = 0; shift < 64; shift += 7)
+            {
+               if (pos_ == buffer_.size() && !fill())
+               {
+                  return false;
+               }
+               uint8_t byte = static_cast<uint8_t>(buffer_[pos_++]);
+               value |= uint64_t(byte & 0x7f) << shift;
+               if (!(byte & 0x80))
+               {
+                  return true;
+               }
+            }
+            return false;
+         }
+
+      private:
+         bool fill()
+         {
+            buffer_.resize(BUFFER_SIZE);
+            in_.read(&buffer_[0], static_cast<std::streamsize>(buffer_.size()));
+            buffer_.resize(static_cast<size_t>(in_.gcount()));
+            pos_ = 0;
+            return !buffer_.empty();
+         }
+      };
+
+      database_t& env_;
+
+   public:
+      explicit dump_t(database_t& env) noexcept
+         : env_{ env }
+      {}
+
+      dump_t(const dump_t&) = delete;
+      dump_t& operator=(const dump_t&) = delete;
+
+      // write every named store to dir, replacing any dump already there. The calling thread
+      // must not have a read-only transaction open
+      status_t save(const std::string& dir, dump_stats_t& stats, const dump_options_t& options = dump_options_t())
+      {
+         std::error_code ec;
+         std::vector<store_t> stores;
+         transaction_t txn(env_);
+         status_t status;
+         stats = dump_stats_t();
+         if (std::filesystem::create_directories(dir, ec); ec)
+         {
+            return status_t(ec.value());
+         }
+         std::vector<std::filesystem::path> stale;
+         for (const auto& entry : std::filesystem::directory_iterator(dir, ec))
+         {
+            if (entry.path().extension() == ".lmdump")
+            {
+               stale.push_back(entry.path());
+            }
+         }
+         for (const std::filesystem::path& path : stale)
+         {
+            std::filesystem::remove(path, ec);
+         }
+         if (ec)
+         {
+            return status_t(ec.value());
+         }
+         if (status = store_t::open_all(env_, txn, stores); status.nok())
          {
             return status;
          }
-         key = k;
-         return status_t();
+         for (store_t& store : stores)
+         {
+            if (auto it = options.orders.find(store.name()); it != options.orders.end())
+            {
+               if (status = mdb_set_compare(txn.handle(), store.handle(), it->second); status.nok())
+               {
+                  return status;
+               }
+            }
+         }
+         size_t threads = std::max<size_t>(1, options.threads);
+         size_t parts = options.parts ? options.parts : threads;
+         std::vector<std::vector<std::string>> keys(stores.size());
+         std::vector<std::pair<size_t, size_t>> jobs;
+         for (size_t i = 0; i < stores.size(); ++i)
+         {
+            if (status = stores[i].split(txn, parts - 1, keys[i]); status.nok())
+            {
+               return status;
+            }
+            for (size_t part = 0; part <= keys[i].size(); ++part)
+            {
+               jobs.emplace_back(i, part);
+            }
+         }
+         std::vector<size_t> entries(jobs.size()), bytes(jobs.size());
+         status = txn.parallel(jobs.size(), threads, [&](MDB_txn* txnptr, size_t j)
+         {
+            auto [i, part] = jobs[j];
+            std::filesystem::path path = std::filesystem::path(dir) / file_name(i, part);
+            return save_part(txnptr, stores[i], keys[i], part, path, options.compress, entries[j], bytes[j]);
+         });
+         if (status.ok())
+         {
+            stats.stores = stores.size();
+            stats.files = jobs.size();
+            for (size_t j = 0; j < jobs.size(); ++j)
+            {
+               stats.entries += entries[j];
+               stats.bytes += bytes[j];
+            }
+         }
+         return status;
       }
 
-      status_t search(key_const_reference& target_key, key_reference key, value_reference value) noexcept
+      // create the stores of the dump in dir and append their entries. Stores that already
+      // exist must have the same flags and hold only keys sorting before the dumped ones, and
+      // stores with a custom order need it in options.orders. The load commits every
+      // options.commit_bytes, so a failed load leaves a partial copy
+      status_t load(const std::string& dir, dump_stats_t& stats, const dump_options_t& options = dump_options_t())
       {
-         key_type k{ target_key };
-         if (status_t status = get(k, value, MDB_SET_RANGE); status.nok())
+         std::vector<part_file_t> files;
+         status_t status;
+         stats = dump_stats_t();
+         if (status = list_files(dir, files); status.nok())
          {
             return status;
          }
-         key = k;
-         return status_t();
+         std::unique_ptr<channel_t[]> channels(new channel_t[files.size()]);
+         std::atomic<size_t> next{ 0 };
+         std::atomic<bool> cancel{ false };
+         std::vector<std::thread> workers;
+         size_t threads = std::min(std::max<size_t>(2, options.threads), files.size() + 1);
+         for (size_t t = 1; t < threads; ++t)
+         {
+            workers.emplace_back([&]()
+            {
+               for (size_t i = next++; i < files.size() && !cancel; i = next++)
+               {
+                  parse_file(files[i], channels[i], cancel);
+               }
+            });
+         }
+         status = write_files(files, channels.get(), stats, options);
+         if (status.nok())
+         {
+            cancel = true;
+            for (size_t i = 0; i < files.size(); ++i)
+            {
+               std::lock_guard<std::mutex> lock(channels[i].mutex);
+               channels[i].cv.notify_all();
+            }
+         }
+         for (std::thread& worker : workers)
+         {
+            worker.join();
+         }
+         return status;
       }
 
-      status_t put(key_const_reference key, value_const_reference value) noexcept
+   private:
+      static std::string file_name(size_t store, size_t part)
       {
-         if (!cursor_)
+         char name[32];
+         std::snprintf(name, sizeof(name), "s%05zu-p%05zu.lmdump", store, part);
+         return name;
+      }
+
+      static void put_varint(std::string& buffer, uint64_t value)
+      {
+         while (value >= 0x80)
          {
-            return status_t(MDB_NOT_OPEN);
+            buffer.push_back(static_cast<char>(value | 0x80));
+            value >>= 7;
          }
-         return status_t(mdb_cursor_put(cursor_, data_t(key).data(), data_t(value).data(), 0));
+         buffer.push_back(static_cast<char>(value));
       }
 
-      status_t del() noexcept
+      static void put_u32(std::string& buffer, uint32_t value)
       {
-         if (!cursor_)
+         buffer.append(reinterpret_cast<const char*>(&value), sizeof(value));
+      }
+
+      // the entries of store from keys[part - 1], or the first key, up to keys[part], or the end
+      static status_t save_part(MDB_txn* txnptr, store_t& store, const std::vector<std::string>& keys, size_t part, const std::filesystem::path& path, bool compress, size_t& entries, size_t& bytes)
+      {
+         MDB_cursor* cursor{ nullptr };
+         unsigned int flags{ 0 };
+         int rc;
+         entries = 0;
+         bytes = 0;
+         if (rc = mdb_dbi_flags(txnptr, store.handle(), &flags); rc != MDB_SUCCESS)
          {
-            return status_t(MDB_NOT_OPEN);
+            return status_t(rc);
          }
-         return status_t(mdb_cursor_del(cursor_, 0));
+         std::ofstream out(path, std::ios::binary | std::ios::trunc);
+         if (!out)
+         {
+            return status_t(EIO);
+         }
+         std::string buffer;
+         buffer.reserve(BUFFER_SIZE + BUFFER_SIZE / 4);
+         buffer.append(MAGIC, sizeof(MAGIC));
+         put_u32(buffer, compress ? COMPRESSED : 0);
+         put_u32(buffer, flags);
+         put_u32(buffer, static_cast<uint32_t>(part));
+         put_u32(buffer, static_cast<uint32_t>(keys.size() + 1));
+         put_u32(buffer, static_cast<uint32_t>(store.name().size()));
+         buffer.append(store.name());
+         if (rc = mdb_cursor_open(txnptr, store.handle(), &cursor); rc != MDB_SUCCESS)
+         {
+            return status_t(rc);
+         }
+         MDB_val k{}, v{}, end{}, prior{};
+         if (part == 0)
+         {
+            rc = mdb_cursor_get(cursor, &k, &v, MDB_FIRST);
+         }
+         else
+         {
+            k = *data_t(keys[part - 1]).data();
+            rc = mdb_cursor_get(cursor, &k, &v, MDB_SET_RANGE);
+         }
+         if (part < keys.size())
+         {
+            end = *data_t(keys[part]).data();
+         }
+         for (; rc == MDB_SUCCESS; rc = mdb_cursor_get(cursor, &k, &v, MDB_NEXT))
+         {
+            if (end.mv_size > 0 && mdb_cmp(txnptr, store.handle(), &k, &end) >= 0)
+            {
+               break;
+            }
+            size_t shared{ 0 };
+            if (compress)
+            {
+               // the previous key is still in the map, read transactions see no writes
+               size_t limit = std::min(k.mv_size, prior.mv_size);
+               const char* a = static_cast<const char*>(k.mv_data);
+               const char* b = static_cast<const char*>(prior.mv_data);
+               while (shared < limit && a[shared] == b[shared])
+               {
+                  ++shared;
+               }
+               put_varint(buffer, shared);
+               prior = k;
+            }
+            put_varint(buffer, k.mv_size - shared);
+            buffer.append(static_cast<const char*>(k.mv_data) + shared, k.mv_size - shared);
+            put_varint(buffer, v.mv_size);
+            buffer.append(static_cast<const char*>(v.mv_data), v.mv_size);
+            ++entries;
+            if (buffer.size() >= BUFFER_SIZE)
+            {
+               out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+               bytes += buffer.size();
+               buffer.clear();
+            }
+         }
+         mdb_cursor_close(cursor);
+         if (rc != MDB_SUCCESS && rc != MDB_NOTFOUND)
+         {
+            return status_t(rc);
+         }
+         // an empty key ends the entries, followed by their number
+         if (compress)
+         {
+            put_varint(buffer, 0);
+         }
+         put_varint(buffer, 0);
+         put_varint(buffer, entries);
+         out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+         bytes += buffer.size();
+         out.flush();
+         return status_t(out.good() ? MDB_SUCCESS : EIO);
       }
 
-      database_t& database() noexcept
+      static bool read_header(file_reader_t& in, part_file_t& file)
       {
-         return table_.database();
+         char magic[sizeof(MAGIC)];
+         uint32_t size{ 0 };
+         if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0)
+         {
+            return false;
+         }
+         if (!in.read(&file.format, 4) || !in.read(&file.flags, 4) || !in.read(&file.part, 4) || !in.read(&file.parts, 4) || !in.read(&size, 4))
+         {
+            return false;
+         }
+         file.store.clear();
+         return (file.format & ~COMPRESSED) == 0 && file.part < file.parts && size <= MAX_NAME && in.append(file.store, size);
       }
 
-      store_t& store() noexcept
+      // the dump files in dir, in the order to load them: by store, then by part
+      static status_t list_files(const std::string& dir, std::vector<part_file_t>& files)
       {
-         return table_;
+         std::error_code ec;
+         for (const auto& entry : std::filesystem::directory_iterator(dir, ec))
+         {
+            if (entry.path().extension() != ".lmdump")
+            {
+               continue;
+            }
+            part_file_t file;
+            file_reader_t in(entry.path());
+            file.path = entry.path();
+            if (!in.is_open() || !read_header(in, file))
+            {
+               return status_t(MDB_BAD_DUMP);
+            }
+            files.push_back(std::move(file));
+         }
+         if (ec)
+         {
+            return status_t(ec.value());
+         }
+         std::sort(files.begin(), files.end(), [](const part_file_t& a, const part_file_t& b)
+         {
+            return a.store != b.store ? a.store < b.store : a.part < b.part;
+         });
+         // every part of every store, once
+         for (size_t i = 0; i < files.size(); ++i)
+         {
+            bool first = i == 0 || files[i].store != files[i - 1].store;
+            uint32_t part = first ? 0 : files[i - 1].part + 1;
+            bool last = i + 1 == files.size() || files[i + 1].store != files[i].store;
+            if (files[i].part != part || (!first && files[i].parts != files[i - 1].parts) || (last && part + 1 != files[i].parts))
+            {
+               return status_t(MDB_BAD_DUMP);
+            }
+         }
+         return status_t();
       }
 
-      MDB_cursor* handle() noexcept
+      // runs on a worker: parse file into batches for the writer, waiting while it is behind
+      static void parse_file(const part_file_t& file, channel_t& channel, const std::atomic<bool>& cancel)
       {
-         return cursor_;
+         file_reader_t in(file.path);
+         part_file_t header;
+         load_batch_t batch;
+         std::string key, prior;
+         uint64_t count{ 0 }, shared{ 0 }, key_size{ 0 }, value_size{ 0 };
+         bool compressed = file.format & COMPRESSED;
+         auto push = [&]()
+         {
+            std::unique_lock<std::mutex> lock(channel.mutex);
+            channel.cv.wait(lock, [&]() { return channel.batches.size() < QUEUE_DEPTH || cancel; });
+            channel.batches.push_back(std::move(batch));
+            channel.cv.notify_all();
+            batch = load_batch_t();
+            return !cancel;
+         };
+         status_t status{ MDB_BAD_DUMP };
+         if (in.is_open() && read_header(in, header))
+         {
+            for (;;)
+            {
+               if ((compressed && !in.varint(shared)) || !in.varint(key_size) || shared > prior.size())
+               {
+                  break;
+               }
+               if (shared + key_size == 0)
+               {
+                  if (in.varint(value_size) && value_size == count)
+                  {
+                     status = status_t();
+                  }
+                  break;
+               }
+               key.assign(prior, 0, static_cast<size_t>(shared));
+               if (!in.append(key, static_cast<size_t>(key_size)) || !in.varint(value_size))
+               {
+                  break;
+               }
+               entry_t entry{ batch.arena.size(), key.size(), batch.arena.size() + key.size(), static_cast<size_t>(value_size), count > 0 && key == prior };
+               batch.arena.append(key);
+               if (!in.append(batch.arena, entry.value_size))
+               {
+                  break;
+               }
+               batch.entries.push_back(entry);
+               key.swap(prior);
+               ++count;
+               if (batch.arena.size() >= BATCH_SIZE && !push())
+               {
+                  return;
+               }
+            }
+         }
+         if (!batch.entries.empty() && status.ok() && !push())
+         {
+            return;
+         }
+         std::lock_guard<std::mutex> lock(channel.mutex);
+         channel.status = status;
+         channel.done = true;
+         channel.cv.notify_all();
       }
 
-   private:
-      status_t get(key_reference key, value_reference value, MDB_cursor_op op) noexcept
+      // runs on the calling thread: append the batches of every file in order
+      status_t write_files(const std::vector<part_file_t>& files, channel_t* channels, dump_stats_t& stats, const dump_options_t& options)
       {
-         status_t status{ MDB_NOT_OPEN };
-         data_t k;
-         data_t v;
-         if (!cursor_)
+         transaction_t txn(env_);
+         MDB_cursor* cursor{ nullptr };
+         MDB_dbi dbi{ 0 };
+         size_t written{ 0 };
+         status_t status;
+         if (status = txn.begin(transaction_type_t::read_write); status.nok())
          {
             return status;
          }
-         if (is_set_operation(op))
+         for (size_t i = 0; i < files.size() && status.ok(); ++i)
          {
-            k.set(key);
+            const part_file_t& file = files[i];
+            if (file.part == 0)
+            {
+               if (cursor)
+               {
+                  mdb_cursor_close(cursor);
+                  cursor = nullptr;
+               }
+               if (status = mdb_dbi_open(txn.handle(), file.store.c_str(), file.flags | MDB_CREATE, &dbi); status.nok())
+               {
+                  break;
+               }
+               // the order has to be set before the first put
+               if (auto it = options.orders.find(file.store); it != options.orders.end())
+               {
+                  if (status = mdb_set_compare(txn.handle(), dbi, it->second); status.nok())
+                  {
+                     break;
+                  }
+               }
+               if (status = mdb_cursor_open(txn.handle(), dbi, &cursor); status.nok())
+               {
+                  break;
+               }
+               ++stats.stores;
+            }
+            for (;;)
+            {
+               load_batch_t batch;
+               {
+                  std::unique_lock<std::mutex> lock(channels[i].mutex);
+                  channels[i].cv.wait(lock, [&]() { return !channels[i].batches.empty() || channels[i].done; });
+                  if (channels[i].batches.empty())
+                  {
+                     status = channels[i].status;
+                     break;
+                  }
+                  batch = std::move(channels[i].batches.front());
+                  channels[i].batches.pop_front();
+                  channels[i].cv.notify_all();
+               }
+               for (const entry_t& entry : batch.entries)
+               {
+                  MDB_val k{ entry.key_size, &batch.arena[entry.key] };
+                  MDB_val v{ entry.value_size, &batch.arena[entry.value] };
+                  // duplicates of the key just written go after it, other keys after the last key
+                  unsigned int flags = entry.same_key && (file.flags & MDB_DUPSORT) ? MDB_CURRENT | MDB_APPENDDUP : MDB_APPEND;
+                  if (status = mdb_cursor_put(cursor, &k, &v, flags); status.nok())
+                  {
+                     break;
+                  }
+                  written += entry.key_size + entry.value_size;
+                  ++stats.entries;
+                  if (written >= options.commit_bytes)
+                  {
+                     if (status = commit(txn, dbi, cursor); status.nok())
+                     {
+                        break;
+                     }
+                     written = 0;
+                  }
+               }
+               if (status.nok())
+               {
+                  break;
+               }
+            }
+            ++stats.files;
+            std::error_code ec;
+            stats.bytes += static_cast<size_t>(std::filesystem::file_size(file.path, ec));
          }
-         if (status = mdb_cursor_get(cursor_, k.data(), v.data(), op); status.nok())
+         if (cursor)
+         {
+            mdb_cursor_close(cursor);
+         }
+         return status.ok() ? txn.commit() : status;
+      }
+
+      // commit and carry on in a new transaction, the cursor back on the last entry written
+      static status_t commit(transaction_t& txn, MDB_dbi dbi, MDB_cursor*& cursor)
+      {
+         status_t status;
+         MDB_val k, v;
+         mdb_cursor_close(cursor);
+         cursor = nullptr;
+         if (status = txn.commit(); status.nok())
          {
             return status;
          }
-         if (op != MDB_SET)
+         if (status = txn.begin(transaction_type_t::read_write); status.nok())
          {
-            k.get(key);
-            v.get(value);
+            return status;
          }
-         return status;
+         if (status = mdb_cursor_open(txn.handle(), dbi, &cursor); status.nok())
+         {
+            return status;
+         }
+         return status_t(mdb_cursor_get(cursor, &k, &v, MDB_LAST));
       }
+   }; // class dump_t
 
-      status_t get(key_reference key, MDB_cursor_op op) noexcept
+   // walk every page of a snapshot to report how full the branch and leaf pages of each store
+   // are, the space lost at the end of overflow pages, the size and contiguity of the freelist
+   // and the depth of every tree. A store whose pages are mostly half empty, or a freelist made
+   // of many short runs, gains from a compacting copy; fill also shows how keys split pages
+   class analyzer_t
+   {
+      static constexpr MDB_dbi FREE_DBI = 0;
+      static constexpr MDB_dbi MAIN_DBI = 1;
+
+      database_t& env_;
+
+   public:
+      explicit analyzer_t(database_t& env) noexcept
+         : env_{ env }
+      {}
+
+      analyzer_t(const analyzer_t&) = delete;
+      analyzer_t& operator=(const analyzer_t&) = delete;
+
+      // walk the stores on up to options.threads threads, all on one snapshot. The calling
+      // thread must not have a read-only transaction open
+      status_t run(analysis_t& analysis, const analyze_options_t& options = analyze_options_t())
       {
-         status_t status{ MDB_NOT_OPEN };
-         data_t k;
-         data_t v;
-         if (!cursor_)
+         std::vector<store_t> stores;
+         transaction_t txn(env_);
+         MDB_envinfo info;
+         status_t status;
+         analysis = analysis_t();
+         if (status = store_t::open_all(env_, txn, stores); status.nok())
          {
             return status;
          }
-         if (is_set_operation(op))
+         if (status = mdb_env_info(env_.handle(), &info); status.nok())
          {
-            k.set(key);
+            return status;
          }
-         if (status = mdb_cursor_get(cursor_, k.data(), v.data(), op); status.nok())
+         analysis.snapshot = txn.id();
+         analysis.file_pages = static_cast<size_t>(info.me_last_pgno) + 1;
+         // the named stores, then the main store, then the freelist
+         std::vector<page_stats_t> trees(stores.size() + 2);
+         status = txn.parallel(trees.size(), std::max<size_t>(1, options.threads), [&](MDB_txn* txnptr, size_t i)
+         {
+            if (i < stores.size())
+            {
+               return walk(txnptr, stores[i].handle(), trees[i]);
+            }
+            if (i == stores.size())
+            {
+               return walk(txnptr, MAIN_DBI, trees[i]);
+            }
+            status_t walked = walk(txnptr, FREE_DBI, trees[i]);
+            return walked.ok() ? read_freelist(txnptr, analysis.freelist) : walked;
+         });
+         if (status.nok())
          {
             return status;
          }
-         if (op != MDB_SET)
+         for (size_t i = 0; i < stores.size(); ++i)
          {
-            k.get(key);
+            trees[i].name = stores[i].name();
+            analysis.stores.push_back(std::move(trees[i]));
          }
+         analysis.main = std::move(trees[stores.size()]);
+         analysis.freelist_tree = std::move(trees[stores.size() + 1]);
+         analysis.page_size = analysis.main.page_size;
          return status;
       }
 
-      bool is_set_operation(MDB_cursor_op op) noexcept
+   private:
+      static status_t walk(MDB_txn* txnptr, MDB_dbi dbi, page_stats_t& stats) noexcept
       {
-         return (op == MDB_SET || op == MDB_SET_KEY || op == MDB_SET_RANGE);
+         MDB_stat stat;
+         status_t status;
+         // a walk may be run again after failing on a worker
+         stats = page_stats_t();
+         if (status = mdb_stat(txnptr, dbi, &stat); status.nok())
+         {
+            return status;
+         }
+         stats.page_size = stat.ms_psize;
+         stats.entries = static_cast<size_t>(stat.ms_entries);
+         stats.depth = stat.ms_depth;
+         return status_t(mdb_page_walk(txnptr, dbi, visit, &stats));
       }
-   }; // class cursor_base_t
+
+      static int visit(const MDB_page_info* info, void* ctx) noexcept
+      {
+         page_stats_t& stats = *static_cast<page_stats_t*>(ctx);
+         if (info->pi_type == MDB_PAGE_OVERFLOW)
+         {
+            ++stats.overflow_chains;
+            stats.overflow_pages += info->pi_pages;
+            stats.overflow_waste += info->pi_size - info->pi_used;
+            return MDB_SUCCESS;
+         }
+         size_t bucket = std::min(page_stats_t::FILL_BUCKETS - 1, info->pi_used * page_stats_t::FILL_BUCKETS / info->pi_size);
+         if (info->pi_dup)
+         {
+            ++stats.dup_pages;
+            stats.dup_depth = std::max<size_t>(stats.dup_depth, info->pi_depth);
+         }
+         if (info->pi_type == MDB_PAGE_BRANCH)
+         {
+            ++stats.branch_pages;
+            stats.branch_bytes += info->pi_used;
+            ++stats.branch_fill[bucket];
+         }
+         else
+         {
+            ++stats.leaf_pages;
+            stats.leaf_bytes += info->pi_used;
+            ++stats.leaf_fill[bucket];
+         }
+         return MDB_SUCCESS;
+      }
+
+      // each record of the freelist is a count followed by that many page numbers
+      static status_t read_freelist(MDB_txn* txnptr, freelist_stats_t& freelist)
+      {
+         MDB_cursor* cursor{ nullptr };
+         MDB_val k, v;
+         std::vector<mdb_size_t> pages;
+         status_t status;
+         freelist = freelist_stats_t();
+         if (status = mdb_cursor_open(txnptr, FREE_DBI, &cursor); status.nok())
+         {
+            return status;
+         }
+         int rc = mdb_cursor_get(cursor, &k, &v, MDB_FIRST);
+         for (; rc == MDB_SUCCESS; rc = mdb_cursor_get(cursor, &k, &v, MDB_NEXT))
+         {
+            mdb_size_t count{ 0 };
+            std::memcpy(&count, v.mv_data, sizeof(count));
+            size_t at = pages.size();
+            pages.resize(at + static_cast<size_t>(count));
+            std::memcpy(pages.data() + at, static_cast<const char*>(v.mv_data) + sizeof(count), static_cast<size_t>(count) * sizeof(count));
+            ++freelist.records;
+         }
+         mdb_cursor_close(cursor);
+         if (rc != MDB_NOTFOUND)
+         {
+            return status_t(rc);
+         }
+         std::sort(pages.begin(), pages.end());
+         freelist.pages = pages.size();
+         for (size_t i = 0, j = 0; i < pages.size(); i = j)
+         {
+            for (j = i + 1; j < pages.size() && pages[j] == pages[j - 1] + 1; ++j)
+            {}
+            size_t length = j - i;
+            size_t bucket = std::min<size_t>(freelist_stats_t::RUN_BUCKETS, std::bit_width(length)) - 1;
+            ++freelist.runs;
+            ++freelist.run_lengths[bucket];
+            freelist.longest_run = std::max(freelist.longest_run, length);
+         }
+         return status;
+      }
+   }; // class analyzer_t
 
 } // namespace lmdb
@@ -213,6 +213,34 @@ union semun {
 #define VGMEMP_DEFINED(a,s)
 #endif
 
+/** @defgroup probes	Static Probes
+ *	With MDB_USE_SDT defined, USDT probes of provider \b lmdb mark
+ *	the transaction and page events below, for perf, bpftrace and
+ *	SystemTap. An unused probe is a single nop. Without MDB_USE_SDT
+ *	the probes and their arguments compile to nothing.
+ *
+ *	Probe | Arguments
+ *	------|----------
+ *	txn__begin | txn, txnid, flags
+ *	txn__commit__start | txn, txnid
+ *	txn__commit__done | txn, txnid, rc
+ *	txn__abort | txn, txnid
+ *	page__get | dbi, pgno, level (as for #mdb_page_get())
+ *	page__split | dbi, pgno, number of keys
+ *	page__spill | txnid, pages spilled
+ *	page__flush | txnid, pages written
+ *	@{
+ */
+#ifdef MDB_USE_SDT
+#include <sys/sdt.h>
+#define MDB_PROBE2(name,a,b)	DTRACE_PROBE2(lmdb, name, a, b)
+#define MDB_PROBE3(name,a,b,c)	DTRACE_PROBE3(lmdb, name, a, b, c)
+#else
+#define MDB_PROBE2(name,a,b)	((void) 0)
+#define MDB_PROBE3(name,a,b,c)	((void) 0)
+#endif
+/** @} */
+
 #ifndef BYTE_ORDER
 # if (defined(_LITTLE_ENDIAN) || defined(_BIG_ENDIAN)) && !(defined(_LITTLE_ENDIAN) && defined(_BIG_ENDIAN))
 /* Solaris just defines one or the other */
@@ -450,6 +478,10 @@ typedef pthread_mutex_t *mdb_mutexref_t;
 	 *	Returns 0 or a code to give #mdb_mutex_failed(), as in #LOCK_MUTEX().
 	 */
 #define LOCK_MUTEX0(mutex)	pthread_mutex_lock(mutex)
+	/** Try to lock the reader or writer mutex without blocking.
+	 *	Returns EBUSY if it is held, else as #LOCK_MUTEX0().
+	 */
+#define TRYLOCK_MUTEX0(mutex)	pthread_mutex_trylock(mutex)
 	/** Unlock the reader or writer mutex.
 	 */
 #define UNLOCK_MUTEX(mutex)	pthread_mutex_unlock(mutex)
@@ -1122,6 +1154,12 @@ typedef struct MDB_node {
 	 */
 #define INDXSIZE(k)	 (NODESIZE + ((k) == NULL ? 0 : (k)->mv_size))
 
+	/** Size of the subtree entry count stored after the key of a
+	 *	branch node in an #MDB_COUNTED database, 0 otherwise.
+	 *	The count sits where a leaf node keeps its data, see #NODEDATA().
+	 */
+#define NODECNTSZ(mc)	 (((mc)->mc_db->md_flags & MDB_COUNTED) ? sizeof(mdb_size_t) : 0)
+
 	/** Size of a node in a leaf page with a given key and data.
 	 *	This is node header plus key plus data size.
 	 */
@@ -1208,7 +1246,7 @@ typedef struct MDB_db {
 #define PERSISTENT_FLAGS	(0xffff & ~(MDB_VALID))
 	/** #mdb_dbi_open() flags */
 #define VALID_FLAGS	(MDB_REVERSEKEY|MDB_DUPSORT|MDB_INTEGERKEY|MDB_DUPFIXED|\
-	MDB_INTEGERDUP|MDB_REVERSEDUP|MDB_CREATE)
+	MDB_INTEGERDUP|MDB_REVERSEDUP|MDB_COUNTED|MDB_CREATE)
 
 	/** Handle for the DB used to track free pages. */
 #define	FREE_DBI	0
@@ -1330,11 +1368,15 @@ struct MDB_txn {
 #define DB_VALID	0x08		/**< DB handle is valid, see also #MDB_VALID */
 #define DB_USRVALID	0x10		/**< As #DB_VALID, but not set for #FREE_DBI */
 #define DB_DUPDATA	0x20		/**< DB is #MDB_DUPSORT data */
+#define DB_COUNTS	0x40		/**< #MDB_COUNTED subtree counts are current */
+#define DB_INITED	0x80		/**< Slot was set up in this txn, see #mdb_dbi_init() */
 /** @} */
 	/** In write txns, array of cursors for each DB */
 	MDB_cursor	**mt_cursors;
 	/** Array of flags for each DB */
 	unsigned char	*mt_dbflags;
+	/** Slots of #mt_dbflags set up in this txn, in the order of first use */
+	MDB_dbi		*mt_dbtouch;
 #ifdef MDB_VL32
 	/** List of read-only pages (actually chunks) */
 	MDB_ID3L	mt_rpages;
@@ -1353,6 +1395,8 @@ struct MDB_txn {
 	 *	don't decrement it when individual DB handles are closed.
 	 */
 	MDB_dbi		mt_numdbs;
+	/** Number of entries in #mt_dbtouch */
+	MDB_dbi		mt_numtouch;
 
 /** @defgroup mdb_txn	Transaction Flags
  *	@ingroup internal
@@ -1529,6 +1573,7 @@ struct MDB_env {
 	unsigned int	*me_dbiseqs;	/**< array of dbi sequence numbers */
 	pthread_key_t	me_txkey;	/**< thread-key for readers */
 	txnid_t		me_pgoldest;	/**< ID of oldest reader last time we looked */
+	unsigned	me_pgpin;		/**< 1 + reader slot which had #me_pgoldest, or 0 */
 	MDB_pgstate	me_pgstate;		/**< state of old pages from freeDB */
 #	define		me_pglast	me_pgstate.mf_pglast
 #	define		me_pghead	me_pgstate.mf_pghead
@@ -1545,6 +1590,8 @@ struct MDB_env {
 	unsigned int	me_maxkey;	/**< max size of a key */
 #endif
 	int		me_live_reader;		/**< have liveness lock in reader table */
+	unsigned int	me_wspin_max;	/**< most tries on the writer mutex before blocking */
+	unsigned int	me_wspin;		/**< tries that recently sufficed, see #mdb_wmutex_lock() */
 #ifdef _WIN32
 	int		me_pidquery;		/**< Used in OpenProcess */
 	OVERLAPPED	*ov;			/**< Used for for overlapping I/O requests */
@@ -1588,9 +1635,15 @@ typedef struct MDB_ntxn {
 	/** max bytes to write in one call */
 #define MAX_WRITE		(0x40000000U >> (sizeof(ssize_t) == 4))
 
-	/** Check \b txn and \b dbi arguments to a function */
+static int mdb_dbi_init(MDB_txn *txn, MDB_dbi dbi);
+
+	/** Check \b txn and \b dbi arguments to a function.
+	 *	Named DB slots are set up on first use, see #mdb_dbi_init().
+	 */
 #define TXN_DBI_EXIST(txn, dbi, validity) \
-	((txn) && (dbi)<(txn)->mt_numdbs && ((txn)->mt_dbflags[dbi] & (validity)))
+	((txn) && (dbi)<(txn)->mt_numdbs && \
+	 (((txn)->mt_dbflags[dbi] & DB_INITED) || mdb_dbi_init(txn, dbi)) && \
+	 ((txn)->mt_dbflags[dbi] & (validity)))
 
 	/** Check for misused \b dbi handles */
 #define TXN_DBI_CHANGED(txn, dbi) \
@@ -1644,7 +1697,7 @@ static void mdb_node_shrink(MDB_page *mp, indx_t indx);
 static int	mdb_node_move(MDB_cursor *csrc, MDB_cursor *cdst, int fromleft);
 static int  mdb_node_read(MDB_cursor *mc, MDB_node *leaf, MDB_val *data);
 static size_t	mdb_leaf_size(MDB_env *env, MDB_val *key, MDB_val *data);
-static size_t	mdb_branch_size(MDB_env *env, MDB_val *key);
+static size_t	mdb_branch_size(MDB_cursor *mc, MDB_val *key);
 
 static int	mdb_rebalance(MDB_cursor *mc);
 static int	mdb_update_key(MDB_cursor *mc, MDB_val *key);
@@ -1668,6 +1721,7 @@ static void	mdb_xcursor_init1(MDB_cursor *mc, MDB_node *node);
 static void	mdb_xcursor_init2(MDB_cursor *mc, MDB_xcursor *src_mx, int force);
 
 static int	mdb_drop0(MDB_cursor *mc, int subs);
+static int	mdb_dbi_recount(MDB_txn *txn, MDB_dbi dbi);
 static void mdb_default_cmp(MDB_txn *txn, MDB_dbi dbi);
 static int mdb_reader_check0(MDB_env *env, int rlocked, int *dead);
 
@@ -1971,7 +2025,7 @@ static void mdb_audit(MDB_txn *txn)
 	count = 0;
 	for (i = 0; i<txn->mt_numdbs; i++) {
 		MDB_xcursor mx;
-		if (!(txn->mt_dbflags[i] & DB_VALID))
+		if (!TXN_DBI_EXIST(txn, i, DB_VALID))
 			continue;
 		mdb_cursor_init(&mc, txn, i, &mx);
 		if (txn->mt_dbs[i].md_root == P_INVALID)
@@ -2305,7 +2359,7 @@ mdb_page_spill(MDB_cursor *m0, MDB_val *key, MDB_val *data)
 	MDB_txn *txn = m0->mc_txn;
 	MDB_page *dp;
 	MDB_ID2L dl = txn->mt_u.dirty_list;
-	unsigned int i, j, need;
+	unsigned int i, j, need, spilled;
 	int rc;
 
 	if (m0->mc_flags & C_SUB)
@@ -2325,6 +2379,14 @@ mdb_page_spill(MDB_cursor *m0, MDB_val *key, MDB_val *data)
 	if (txn->mt_dirty_room > i)
 		return MDB_SUCCESS;
 
+	/* Spilled pages are read back as clean pages, whose subtree
+	 * counts are trusted. Bring them up to date before flushing.
+	 */
+	for (i = 0; i < txn->mt_numtouch; i++) {
+		if ((rc = mdb_dbi_recount(txn, txn->mt_dbtouch[i])) != MDB_SUCCESS)
+			goto done;
+	}
+
 	if (!txn->mt_spill_pgs) {
 		txn->mt_spill_pgs = mdb_midl_alloc(MDB_IDL_UM_MAX);
 		if (!txn->mt_spill_pgs)
@@ -2357,7 +2419,7 @@ mdb_page_spill(MDB_cursor *m0, MDB_val *key, MDB_val *data)
 
 	/* Save the page IDs of all the pages we're flushing */
 	/* flush from the tail forward, this saves a lot of shifting later on. */
-	for (i=dl[0].mid; i && need; i--) {
+	for (i=dl[0].mid, spilled=0; i && spilled < need; i--) {
 		MDB_ID pn = dl[i].mid << 1;
 		dp = dl[i].mptr;
 		if (dp->mp_flags & (P_LOOSE|P_KEEP))
@@ -2381,9 +2443,10 @@ mdb_page_spill(MDB_cursor *m0, MDB_val *key, MDB_val *data)
 		}
 		if ((rc = mdb_midl_append(&txn->mt_spill_pgs, pn)))
 			goto done;
-		need--;
+		spilled++;
 	}
 	mdb_midl_sort(txn->mt_spill_pgs);
+	MDB_PROBE2(page__spill, txn->mt_txnid, spilled);
 
 	/* Flush the spilled part of dirty list */
 	if ((rc = mdb_page_flush(txn, i)) != MDB_SUCCESS)
@@ -2397,22 +2460,36 @@ done:
 	return rc;
 }
 
-/** Find oldest txnid still referenced. Expects txn->mt_txnid > 0. */
+/** Find oldest txnid still referenced. Expects txn->mt_txnid > 0.
+ *	Readers begin at the last committed txn, so none can be older than
+ *	an earlier result: #MDB_env.%me_pgoldest stays a safe lower bound.
+ *	While the reader slot it came from still holds it, it is also exact
+ *	and the scan of the reader table can be skipped.
+ *	Updates #MDB_env.%me_pgoldest and #MDB_env.%me_pgpin.
+ */
 static txnid_t
 mdb_find_oldest(MDB_txn *txn)
 {
-	int i;
+	MDB_env *env = txn->mt_env;
+	int i, pin = -1;
 	txnid_t mr, oldest = txn->mt_txnid - 1;
-	if (txn->mt_env->me_txns) {
-		MDB_reader *r = txn->mt_env->me_txns->mti_readers;
-		for (i = txn->mt_env->me_txns->mti_numreaders; --i >= 0; ) {
+	if (env->me_txns) {
+		MDB_reader *r = env->me_txns->mti_readers;
+		if ((i = (int)env->me_pgpin - 1) >= 0 && r[i].mr_pid &&
+			r[i].mr_txnid == env->me_pgoldest)
+			return env->me_pgoldest;
+		for (i = env->me_txns->mti_numreaders; --i >= 0; ) {
 			if (r[i].mr_pid) {
 				mr = r[i].mr_txnid;
-				if (oldest > mr)
+				if (oldest >= mr) {
 					oldest = mr;
+					pin = i;
+				}
 			}
 		}
 	}
+	env->me_pgoldest = oldest;
+	env->me_pgpin = pin + 1;
 	return oldest;
 }
 
@@ -2547,7 +2624,6 @@ mdb_page_alloc(MDB_cursor *mc, int num, MDB_page **mp)
 		if (oldest <= last) {
 			if (!found_old) {
 				oldest = mdb_find_oldest(txn);
-				env->me_pgoldest = oldest;
 				found_old = 1;
 			}
 			if (oldest <= last)
@@ -2563,7 +2639,6 @@ mdb_page_alloc(MDB_cursor *mc, int num, MDB_page **mp)
 		if (oldest <= last) {
 			if (!found_old) {
 				oldest = mdb_find_oldest(txn);
-				env->me_pgoldest = oldest;
 				found_old = 1;
 			}
 			if (oldest <= last)
@@ -2928,10 +3003,13 @@ mdb_cursors_close(MDB_txn *txn, unsigned merge)
 {
 	MDB_cursor **cursors = txn->mt_cursors, *mc, *next, *bk;
 	MDB_xcursor *mx;
+	MDB_dbi dbi;
 	int i;
 
-	for (i = txn->mt_numdbs; --i >= 0; ) {
-		for (mc = cursors[i]; mc; mc = next) {
+	/* Only DBs set up in this txn can have cursors */
+	for (i = txn->mt_numtouch + CORE_DBS; --i >= 0; ) {
+		dbi = i < CORE_DBS ? (MDB_dbi)i : txn->mt_dbtouch[i - CORE_DBS];
+		for (mc = cursors[dbi]; mc; mc = next) {
 			next = mc->mc_next;
 			if ((bk = mc->mc_backup) != NULL) {
 				if (merge) {
@@ -2954,7 +3032,7 @@ mdb_cursors_close(MDB_txn *txn, unsigned merge)
 			/* Only malloced cursors are permanently tracked. */
 			free(mc);
 		}
-		cursors[i] = NULL;
+		cursors[dbi] = NULL;
 	}
 }
 
@@ -3012,6 +3090,70 @@ mdb_reader_pid(MDB_env *env, enum Pidlock_op op, MDB_PID_T pid)
 #endif
 }
 
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define MDB_SPIN_PAUSE()	__builtin_ia32_pause()
+#elif defined(__GNUC__) && defined(__aarch64__)
+#define MDB_SPIN_PAUSE()	__asm__ __volatile__("yield")
+#else
+#define MDB_SPIN_PAUSE()	((void)0)
+#endif
+
+/** Read and write an unsigned int that threads access without a lock,
+ *	such as #MDB_env.me_wspin, which threads waiting for the writer mutex
+ *	read while its owner updates it. Only the value matters, the accesses
+ *	order nothing else.
+ */
+#if defined(__GNUC__) || defined(__clang__)
+#define MDB_RELAXED_GET(x)	__atomic_load_n(&(x), __ATOMIC_RELAXED)
+#define MDB_RELAXED_SET(x, n)	__atomic_store_n(&(x), (n), __ATOMIC_RELAXED)
+#else
+#define MDB_RELAXED_GET(x)	(*(volatile unsigned int *)&(x))
+#define MDB_RELAXED_SET(x, n)	(*(volatile unsigned int *)&(x) = (n))
+#endif
+
+/** Lock the writer mutex for a write txn.
+ *	If #mdb_env_set_writespin() allowed it, first try to take the mutex
+ *	without blocking for a while, since short write txns from other
+ *	threads often release it sooner than a sleep and wakeup would take.
+ *	As with glibc's adaptive mutexes, the number of tries follows a
+ *	running average of the tries recently needed, within the limit.
+ *	A dead owner is recovered by #mdb_mutex_failed() either way.
+ *	@param[in] env the environment handle
+ *	@return 0 with the mutex held, else an error code.
+ */
+static int
+mdb_wmutex_lock(MDB_env *env)
+{
+	int rc;
+#ifdef MDB_USE_POSIX_MUTEX
+	unsigned int i, avg = MDB_RELAXED_GET(env->me_wspin);
+	unsigned int limit = MDB_RELAXED_GET(env->me_wspin_max);
+
+	if (limit) {
+		if (limit > avg * 2 + 16)
+			limit = avg * 2 + 16;
+		for (i = 0; (rc = TRYLOCK_MUTEX0(env->me_wmutex)) == EBUSY; i++) {
+			if (i == limit)
+				break;
+			MDB_SPIN_PAUSE();
+		}
+		if (rc == EBUSY ? LOCK_MUTEX(rc, env, env->me_wmutex) :
+			rc && (rc = mdb_mutex_failed(env, env->me_wmutex, rc)))
+			return rc;
+		/* We hold the mutex, no other thread of this env updates me_wspin,
+		 * but waiting threads read it. avg may be stale, start from the
+		 * current value.
+		 */
+		avg = MDB_RELAXED_GET(env->me_wspin);
+		MDB_RELAXED_SET(env->me_wspin, avg + ((int)i - (int)avg) / 8);
+		return MDB_SUCCESS;
+	}
+#endif
+	if (LOCK_MUTEX(rc, env, env->me_wmutex))
+		return rc;
+	return MDB_SUCCESS;
+}
+
 /** Common code for #mdb_txn_begin() and #mdb_txn_renew().
  * @param[in] txn the transaction handle to initialize
  * @return 0 on success, non-zero on failure.
@@ -3023,7 +3165,6 @@ mdb_txn_renew0(MDB_txn *txn)
 	MDB_txninfo *ti = env->me_txns;
 	MDB_meta *meta;
 	unsigned int i, nr, flags = txn->mt_flags;
-	uint16_t x;
 	int rc, new_notls = 0;
 
 	if ((flags &= MDB_TXN_RDONLY) != 0) {
@@ -3092,7 +3233,7 @@ mdb_txn_renew0(MDB_txn *txn)
 	} else {
 		/* Not yet touching txn == env->me_txn0, it may be active */
 		if (ti) {
-			if (LOCK_MUTEX(rc, env, env->me_wmutex))
+			if ((rc = mdb_wmutex_lock(env)) != 0)
 				return rc;
 			txn->mt_txnid = ti->mti_txnid;
 			meta = env->me_metas[txn->mt_txnid & 1];
@@ -3115,7 +3256,6 @@ mdb_txn_renew0(MDB_txn *txn)
 		txn->mt_free_pgs[0] = 0;
 		txn->mt_spill_pgs = NULL;
 		env->me_txn = txn;
-		memcpy(txn->mt_dbiseqs, env->me_dbiseqs, env->me_maxdbs * sizeof(unsigned int));
 	}
 
 	/* Copy the DB info and flags */
@@ -3129,15 +3269,13 @@ mdb_txn_renew0(MDB_txn *txn)
 
 	txn->mt_flags = flags;
 
-	/* Setup db info */
+	/* Setup db info. Named DBs are set up on first use, so the
+	 * cost of beginning a txn does not grow with me_numdbs.
+	 */
 	txn->mt_numdbs = env->me_numdbs;
-	for (i=CORE_DBS; i<txn->mt_numdbs; i++) {
-		x = env->me_dbflags[i];
-		txn->mt_dbs[i].md_flags = x & PERSISTENT_FLAGS;
-		txn->mt_dbflags[i] = (x & MDB_VALID) ? DB_VALID|DB_USRVALID|DB_STALE : 0;
-	}
-	txn->mt_dbflags[MAIN_DBI] = DB_VALID|DB_USRVALID;
-	txn->mt_dbflags[FREE_DBI] = DB_VALID;
+	txn->mt_numtouch = 0;
+	txn->mt_dbflags[MAIN_DBI] = DB_VALID|DB_USRVALID|DB_INITED;
+	txn->mt_dbflags[FREE_DBI] = DB_VALID|DB_INITED;
 
 	if (env->me_flags & MDB_FATAL_ERROR) {
 		DPUTS("environment had fatal error, must shutdown!");
@@ -3188,10 +3326,10 @@ mdb_txn_begin(MDB_env *env, MDB_txn *parent, unsigned int flags, MDB_txn **ret)
 			return (parent->mt_flags & MDB_TXN_RDONLY) ? EINVAL : MDB_BAD_TXN;
 		}
 		/* Child txns save MDB_pgstate and use own copy of cursors */
-		size = env->me_maxdbs * (sizeof(MDB_db)+sizeof(MDB_cursor *)+1);
+		size = env->me_maxdbs * (sizeof(MDB_db)+sizeof(MDB_cursor *)+sizeof(MDB_dbi)+1);
 		size += tsize = sizeof(MDB_ntxn);
 	} else if (flags & MDB_RDONLY) {
-		size = env->me_maxdbs * (sizeof(MDB_db)+1);
+		size = env->me_maxdbs * (sizeof(MDB_db)+sizeof(MDB_dbi)+1);
 		size += tsize = sizeof(MDB_txn);
 	} else {
 		/* Reuse preallocated write txn. However, do not touch it until
@@ -3218,11 +3356,13 @@ mdb_txn_begin(MDB_env *env, MDB_txn *parent, unsigned int flags, MDB_txn **ret)
 	txn->mt_dbxs = env->me_dbxs;	/* static */
 	txn->mt_dbs = (MDB_db *) ((char *)txn + tsize);
 	txn->mt_dbflags = (unsigned char *)txn + size - env->me_maxdbs;
+	txn->mt_dbtouch = (MDB_dbi *)txn->mt_dbflags - env->me_maxdbs;
 	txn->mt_flags = flags;
 	txn->mt_env = env;
 
 	if (parent) {
 		unsigned int i;
+		MDB_dbi dbi;
 		txn->mt_cursors = (MDB_cursor **)(txn->mt_dbs + env->me_maxdbs);
 		txn->mt_dbiseqs = parent->mt_dbiseqs;
 		txn->mt_u.dirty_list = malloc(sizeof(MDB_ID2)*MDB_IDL_UM_SIZE);
@@ -3245,10 +3385,19 @@ mdb_txn_begin(MDB_env *env, MDB_txn *parent, unsigned int flags, MDB_txn **ret)
 #ifdef MDB_VL32
 		txn->mt_rpages = parent->mt_rpages;
 #endif
-		memcpy(txn->mt_dbs, parent->mt_dbs, txn->mt_numdbs * sizeof(MDB_db));
-		/* Copy parent's mt_dbflags, but clear DB_NEW */
-		for (i=0; i<txn->mt_numdbs; i++)
-			txn->mt_dbflags[i] = parent->mt_dbflags[i] & ~DB_NEW;
+		/* Copy the DBs the parent has set up, and their mt_dbflags
+		 * but clear DB_NEW. The rest are set up on first use.
+		 */
+		memcpy(txn->mt_dbs, parent->mt_dbs, CORE_DBS * sizeof(MDB_db));
+		txn->mt_dbflags[FREE_DBI] = parent->mt_dbflags[FREE_DBI];
+		txn->mt_dbflags[MAIN_DBI] = parent->mt_dbflags[MAIN_DBI];
+		for (i=0; i<parent->mt_numtouch; i++) {
+			dbi = parent->mt_dbtouch[i];
+			txn->mt_dbs[dbi] = parent->mt_dbs[dbi];
+			txn->mt_dbflags[dbi] = parent->mt_dbflags[dbi] & ~DB_NEW;
+			txn->mt_dbtouch[i] = dbi;
+		}
+		txn->mt_numtouch = parent->mt_numtouch;
 		rc = 0;
 		ntxn = (MDB_ntxn *)txn;
 		ntxn->mnt_pgstate = env->me_pgstate; /* save parent me_pghead & co */
@@ -3279,6 +3428,7 @@ renew:
 	} else {
 		txn->mt_flags |= flags;	/* could not change txn=me_txn0 earlier */
 		*ret = txn;
+		MDB_PROBE3(txn__begin, txn, txn->mt_txnid, txn->mt_flags);
 		DPRINTF(("begin txn %"Yu"%c %p on mdbenv %p, root page %"Yu,
 			txn->mt_txnid, (flags & MDB_RDONLY) ? 'r' : 'w',
 			(void *) txn, (void *) env, txn->mt_dbs[MAIN_DBI].md_root));
@@ -3301,26 +3451,52 @@ mdb_txn_id(MDB_txn *txn)
     return txn->mt_txnid;
 }
 
+/** Set up a named DB slot of a txn on its first use.
+ * Beginning a txn only sets up the core DBs, so that its cost does
+ * not depend on the number of DBs open in the environment. The slot
+ * is recorded in #MDB_txn.mt_dbtouch so that loops over the txn's
+ * DBs, and the cleanup when the txn ends, only visit slots in use.
+ * @param[in] txn the transaction handle
+ * @param[in] dbi a slot below #MDB_txn.mt_numdbs without #DB_INITED
+ * @return 1, for use in #TXN_DBI_EXIST().
+ */
+static int
+mdb_dbi_init(MDB_txn *txn, MDB_dbi dbi)
+{
+	MDB_env *env = txn->mt_env;
+	uint16_t x = env->me_dbflags[dbi];
+
+	txn->mt_dbs[dbi].md_flags = x & PERSISTENT_FLAGS;
+	txn->mt_dbflags[dbi] = ((x & MDB_VALID) ?
+		DB_VALID|DB_USRVALID|DB_STALE : 0) | DB_INITED;
+	/* Read txns share the env's sequence numbers */
+	if (txn->mt_dbiseqs != env->me_dbiseqs)
+		txn->mt_dbiseqs[dbi] = env->me_dbiseqs[dbi];
+	txn->mt_dbtouch[txn->mt_numtouch++] = dbi;
+	return 1;
+}
+
 /** Export or close DBI handles opened in this txn. */
 static void
 mdb_dbis_update(MDB_txn *txn, int keep)
 {
-	int i;
+	MDB_dbi i, dbi;
 	MDB_dbi n = txn->mt_numdbs;
 	MDB_env *env = txn->mt_env;
 	unsigned char *tdbflags = txn->mt_dbflags;
 
-	for (i = n; --i >= CORE_DBS;) {
-		if (tdbflags[i] & DB_NEW) {
+	for (i = txn->mt_numtouch; i-- > 0;) {
+		dbi = txn->mt_dbtouch[i];
+		if (tdbflags[dbi] & DB_NEW) {
 			if (keep) {
-				env->me_dbflags[i] = txn->mt_dbs[i].md_flags | MDB_VALID;
+				env->me_dbflags[dbi] = txn->mt_dbs[dbi].md_flags | MDB_VALID;
 			} else {
-				char *ptr = env->me_dbxs[i].md_name.mv_data;
+				char *ptr = env->me_dbxs[dbi].md_name.mv_data;
 				if (ptr) {
-					env->me_dbxs[i].md_name.mv_data = NULL;
-					env->me_dbxs[i].md_name.mv_size = 0;
-					env->me_dbflags[i] = 0;
-					env->me_dbiseqs[i]++;
+					env->me_dbxs[dbi].md_name.mv_data = NULL;
+					env->me_dbxs[dbi].md_name.mv_size = 0;
+					env->me_dbflags[dbi] = 0;
+					env->me_dbiseqs[dbi]++;
 					free(ptr);
 				}
 			}
@@ -3330,6 +3506,17 @@ mdb_dbis_update(MDB_txn *txn, int keep)
 		env->me_numdbs = n;
 }
 
+/** Forget the DBs set up in this txn, so a reused txn sets them up again.
+ *	Must be done after closing the txn's cursors, and for the write txn
+ *	before releasing the writer mutex, since the next writer reuses it.
+ */
+static void
+mdb_dbis_reset(MDB_txn *txn)
+{
+	while (txn->mt_numtouch)
+		txn->mt_dbflags[txn->mt_dbtouch[--txn->mt_numtouch]] = 0;
+}
+
 /** End a transaction, except successful commit of a nested transaction.
  * May be called twice for readonly txns: First reset it, then abort.
  * @param[in] txn the transaction handle to end
@@ -3361,6 +3548,7 @@ mdb_txn_end(MDB_txn *txn, unsigned mode)
 				txn->mt_u.reader = NULL;
 			} /* else txn owns the slot until it does MDB_END_SLOT */
 		}
+		mdb_dbis_reset(txn);
 		txn->mt_numdbs = 0;		/* prevent further DBI activity */
 		txn->mt_flags |= MDB_TXN_FINISHED;
 
@@ -3373,6 +3561,7 @@ mdb_txn_end(MDB_txn *txn, unsigned mode)
 			mdb_dlist_free(txn);
 		}
 
+		mdb_dbis_reset(txn);
 		txn->mt_numdbs = 0;
 		txn->mt_flags = MDB_TXN_FINISHED;
 
@@ -3451,6 +3640,7 @@ mdb_txn_abort(MDB_txn *txn)
 	if (txn->mt_child)
 		mdb_txn_abort(txn->mt_child);
 
+	MDB_PROBE2(txn__abort, txn, txn->mt_txnid);
 	mdb_txn_end(txn, MDB_END_ABORT|MDB_END_SLOT|MDB_END_FREE);
 }
 
@@ -3911,21 +4101,57 @@ done:
 	i--;
 	txn->mt_dirty_room += i - j;
 	dl[0].mid = j;
+	MDB_PROBE2(page__flush, txn->mt_txnid, i - j);
 	return MDB_SUCCESS;
 }
 
 static int ESECT mdb_env_share_locks(MDB_env *env, int *excl);
 
+/** Read a monotonic clock, in nanoseconds, for #MDB_commit_stat */
+static uint64_t
+mdb_clock_ns(void)
+{
+#ifdef _WIN32
+	LARGE_INTEGER now, freq;
+	QueryPerformanceCounter(&now);
+	QueryPerformanceFrequency(&freq);
+	return (uint64_t)(now.QuadPart / freq.QuadPart) * 1000000000 +
+		(uint64_t)(now.QuadPart % freq.QuadPart) * 1000000000 / freq.QuadPart;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+	/** Charge the time since the last phase to a #MDB_commit_stat field */
+#define COMMIT_PHASE(stat, field, last)	do { \
+	if (stat) { uint64_t now_ = mdb_clock_ns(); \
+		(stat)->field += now_ - (last); (last) = now_; } } while (0)
+
 int
 mdb_txn_commit(MDB_txn *txn)
+{
+	return mdb_txn_commit_stat(txn, NULL);
+}
+
+int
+mdb_txn_commit_stat(MDB_txn *txn, MDB_commit_stat *stat)
 {
 	int		rc;
 	unsigned int i, end_mode;
 	MDB_env	*env;
+	uint64_t start = 0, last = 0;
 
 	if (txn == NULL)
 		return EINVAL;
 
+	MDB_PROBE2(txn__commit__start, txn, txn->mt_txnid);
+	if (stat) {
+		memset(stat, 0, sizeof(*stat));
+		start = last = mdb_clock_ns();
+	}
+
 	/* mdb_txn_end() mode for a commit which writes nothing */
 	end_mode = MDB_END_EMPTY_COMMIT|MDB_END_UPDATE|MDB_END_SLOT|MDB_END_FREE;
 
@@ -3949,6 +4175,12 @@ mdb_txn_commit(MDB_txn *txn)
 		goto fail;
 	}
 
+	/* Update the subtree counts of modified #MDB_COUNTED DBs */
+	for (i = 0; i < txn->mt_numtouch; i++) {
+		if ((rc = mdb_dbi_recount(txn, txn->mt_dbtouch[i])))
+			goto fail;
+	}
+
 	if (txn->mt_parent) {
 		MDB_txn *parent = txn->mt_parent;
 		MDB_page **lp;
@@ -3971,16 +4203,24 @@ mdb_txn_commit(MDB_txn *txn)
 		/* Merge our cursors into parent's and close them */
 		mdb_cursors_close(txn, 1);
 
-		/* Update parent's DB table. */
-		memcpy(parent->mt_dbs, txn->mt_dbs, txn->mt_numdbs * sizeof(MDB_db));
+		/* Update parent's DB table. Our mt_dbtouch starts with
+		 * the parent's, so it covers every DB either txn set up.
+		 */
+		memcpy(parent->mt_dbs, txn->mt_dbs, CORE_DBS * sizeof(MDB_db));
 		parent->mt_numdbs = txn->mt_numdbs;
 		parent->mt_dbflags[FREE_DBI] = txn->mt_dbflags[FREE_DBI];
 		parent->mt_dbflags[MAIN_DBI] = txn->mt_dbflags[MAIN_DBI];
-		for (i=CORE_DBS; i<txn->mt_numdbs; i++) {
-			/* preserve parent's DB_NEW status */
-			x = parent->mt_dbflags[i] & DB_NEW;
-			parent->mt_dbflags[i] = txn->mt_dbflags[i] | x;
+		for (i=0; i<txn->mt_numtouch; i++) {
+			MDB_dbi dbi = txn->mt_dbtouch[i];
+			/* preserve parent's DB_NEW status; our recount left
+			 * the parent's own dirty pages alone
+			 */
+			x = parent->mt_dbflags[dbi] & DB_NEW;
+			parent->mt_dbs[dbi] = txn->mt_dbs[dbi];
+			parent->mt_dbflags[dbi] = (txn->mt_dbflags[dbi] & ~DB_COUNTS) | x;
+			parent->mt_dbtouch[i] = dbi;
 		}
+		parent->mt_numtouch = txn->mt_numtouch;
 
 		dst = parent->mt_u.dirty_list;
 		src = txn->mt_u.dirty_list;
@@ -4076,7 +4316,10 @@ mdb_txn_commit(MDB_txn *txn)
 
 		parent->mt_child = NULL;
 		mdb_midl_free(((MDB_ntxn *)txn)->mnt_pgstate.mf_pghead);
+		MDB_PROBE3(txn__commit__done, txn, txn->mt_txnid, rc);
 		free(txn);
+		if (stat)
+			stat->cs_total_ns = mdb_clock_ns() - start;
 		return rc;
 	}
 
@@ -4098,12 +4341,13 @@ mdb_txn_commit(MDB_txn *txn)
 	/* Update DB root pointers */
 	if (txn->mt_numdbs > CORE_DBS) {
 		MDB_cursor mc;
-		MDB_dbi i;
+		MDB_dbi i, j;
 		MDB_val data;
 		data.mv_size = sizeof(MDB_db);
 
 		mdb_cursor_init(&mc, txn, MAIN_DBI, NULL);
-		for (i = CORE_DBS; i < txn->mt_numdbs; i++) {
+		for (j = 0; j < txn->mt_numtouch; j++) {
+			i = txn->mt_dbtouch[j];
 			if (txn->mt_dbflags[i] & DB_DIRTY) {
 				if (TXN_DBI_CHANGED(txn, i)) {
 					rc = MDB_BAD_DBI;
@@ -4117,10 +4361,24 @@ mdb_txn_commit(MDB_txn *txn)
 			}
 		}
 	}
+	COMMIT_PHASE(stat, cs_dbs_ns, last);
 
 	rc = mdb_freelist_save(txn);
 	if (rc)
 		goto fail;
+	if (stat) {
+		MDB_ID2L dl = txn->mt_u.dirty_list;
+		MDB_page *dp;
+		stat->cs_freelist_pages = txn->mt_free_pgs[0] +
+			(env->me_pghead ? env->me_pghead[0] : 0);
+		stat->cs_dirty_pages = dl[0].mid;
+		for (i = 1; i <= dl[0].mid; i++) {
+			dp = dl[i].mptr;
+			stat->cs_written_pages += IS_OVERFLOW(dp) ? dp->mp_pages : 1;
+		}
+		stat->cs_written_bytes = stat->cs_written_pages * env->me_psize;
+	}
+	COMMIT_PHASE(stat, cs_freelist_ns, last);
 
 	mdb_midl_free(env->me_pghead);
 	env->me_pghead = NULL;
@@ -4132,11 +4390,14 @@ mdb_txn_commit(MDB_txn *txn)
 
 	if ((rc = mdb_page_flush(txn, 0)))
 		goto fail;
+	COMMIT_PHASE(stat, cs_flush_ns, last);
 	if (!F_ISSET(txn->mt_flags, MDB_TXN_NOSYNC) &&
 		(rc = mdb_env_sync0(env, 0, txn->mt_next_pgno)))
 		goto fail;
+	COMMIT_PHASE(stat, cs_sync_ns, last);
 	if ((rc = mdb_env_write_meta(txn)))
 		goto fail;
+	COMMIT_PHASE(stat, cs_meta_ns, last);
 	end_mode = MDB_END_COMMITTED|MDB_END_UPDATE;
 	if (env->me_flags & MDB_PREVSNAPSHOT) {
 		if (!(env->me_flags & MDB_NOLOCK)) {
@@ -4149,10 +4410,14 @@ mdb_txn_commit(MDB_txn *txn)
 	}
 
 done:
+	MDB_PROBE3(txn__commit__done, txn, txn->mt_txnid, MDB_SUCCESS);
 	mdb_txn_end(txn, end_mode);
+	if (stat)
+		stat->cs_total_ns = mdb_clock_ns() - start;
 	return MDB_SUCCESS;
 
 fail:
+	MDB_PROBE3(txn__commit__done, txn, txn->mt_txnid, rc);
 	mdb_txn_abort(txn);
 	return rc;
 }
@@ -4643,6 +4908,16 @@ mdb_env_set_maxreaders(MDB_env *env, unsigned int readers)
 	return MDB_SUCCESS;
 }
 
+int ESECT
+mdb_env_set_writespin(MDB_env *env, unsigned int spins)
+{
+	if (!env)
+		return EINVAL;
+	/* may change while write txns wait for the mutex */
+	MDB_RELAXED_SET(env->me_wspin_max, spins);
+	return MDB_SUCCESS;
+}
+
 int ESECT
 mdb_env_get_maxreaders(MDB_env *env, unsigned int *readers)
 {
@@ -5674,14 +5949,15 @@ mdb_env_open(MDB_env *env, const char *path, unsigned int flags, mdb_mode_t mode
 		if (!(flags & MDB_RDONLY)) {
 			MDB_txn *txn;
 			int tsize = sizeof(MDB_txn), size = tsize + env->me_maxdbs *
-				(sizeof(MDB_db)+sizeof(MDB_cursor *)+sizeof(unsigned int)+1);
+				(sizeof(MDB_db)+sizeof(MDB_cursor *)+sizeof(unsigned int)+sizeof(MDB_dbi)+1);
 			if ((env->me_pbuf = calloc(1, env->me_psize)) &&
 				(txn = calloc(1, size)))
 			{
 				txn->mt_dbs = (MDB_db *)((char *)txn + tsize);
 				txn->mt_cursors = (MDB_cursor **)(txn->mt_dbs + env->me_maxdbs);
 				txn->mt_dbiseqs = (unsigned int *)(txn->mt_cursors + env->me_maxdbs);
-				txn->mt_dbflags = (unsigned char *)(txn->mt_dbiseqs + env->me_maxdbs);
+				txn->mt_dbtouch = (MDB_dbi *)(txn->mt_dbiseqs + env->me_maxdbs);
+				txn->mt_dbflags = (unsigned char *)(txn->mt_dbtouch + env->me_maxdbs);
 				txn->mt_env = env;
 #ifdef MDB_VL32
 				txn->mt_rpages = malloc(MDB_TRPAGE_SIZE * sizeof(MDB_ID3));
@@ -5975,6 +6251,46 @@ mdb_cmp_memnr(const MDB_val *a, const MDB_val *b)
 	return len_diff<0 ? -1 : len_diff;
 }
 
+/** The binary search of #mdb_node_search(), expanded once for each
+ *	built-in comparator so that it is called directly and can be inlined,
+ *	and once for other comparators, which are called through the pointer.
+ */
+#define MDB_NODE_BSEARCH(cmp) do { \
+	if (IS_LEAF2(mp)) { \
+		nodekey.mv_size = mc->mc_db->md_pad; \
+		node = NODEPTR(mp, 0);	/* fake */ \
+		while (low <= high) { \
+			i = (low + high) >> 1; \
+			nodekey.mv_data = LEAF2KEY(mp, i, nodekey.mv_size); \
+			rc = cmp(key, &nodekey); \
+			DPRINTF(("found leaf index %u [%s], rc = %i", \
+			    i, DKEY(&nodekey), rc)); \
+			if (rc == 0) \
+				break; \
+			if (rc > 0) \
+				low = i + 1; \
+			else \
+				high = i - 1; \
+		} \
+	} else { \
+		while (low <= high) { \
+			i = (low + high) >> 1; \
+			node = NODEPTR(mp, i); \
+			nodekey.mv_size = NODEKSZ(node); \
+			nodekey.mv_data = NODEKEY(node); \
+			rc = cmp(key, &nodekey); \
+			DPRINTF(("found %s index %u [%s], rc = %i", \
+			    IS_LEAF(mp) ? "leaf" : "branch", i, DKEY(&nodekey), rc)); \
+			if (rc == 0) \
+				break; \
+			if (rc > 0) \
+				low = i + 1; \
+			else \
+				high = i - 1; \
+		} \
+	} \
+} while (0)
+
 /** Search for key within a page, using binary search.
  * Returns the smallest entry larger or equal to the key.
  * If exactp is non-null, stores whether the found entry was an exact match
@@ -6014,47 +6330,18 @@ mdb_node_search(MDB_cursor *mc, MDB_val *key, int *exactp)
 			cmp = mdb_cmp_int;
 	}
 
-	if (IS_LEAF2(mp)) {
-		nodekey.mv_size = mc->mc_db->md_pad;
-		node = NODEPTR(mp, 0);	/* fake */
-		while (low <= high) {
-			i = (low + high) >> 1;
-			nodekey.mv_data = LEAF2KEY(mp, i, nodekey.mv_size);
-			rc = cmp(key, &nodekey);
-			DPRINTF(("found leaf index %u [%s], rc = %i",
-			    i, DKEY(&nodekey), rc));
-			if (rc == 0)
-				break;
-			if (rc > 0)
-				low = i + 1;
-			else
-				high = i - 1;
-		}
-	} else {
-		while (low <= high) {
-			i = (low + high) >> 1;
-
-			node = NODEPTR(mp, i);
-			nodekey.mv_size = NODEKSZ(node);
-			nodekey.mv_data = NODEKEY(node);
-
-			rc = cmp(key, &nodekey);
-#if MDB_DEBUG
-			if (IS_LEAF(mp))
-				DPRINTF(("found leaf index %u [%s], rc = %i",
-				    i, DKEY(&nodekey), rc));
-			else
-				DPRINTF(("found branch index %u [%s -> %"Yu"], rc = %i",
-				    i, DKEY(&nodekey), NODEPGNO(node), rc));
-#endif
-			if (rc == 0)
-				break;
-			if (rc > 0)
-				low = i + 1;
-			else
-				high = i - 1;
-		}
-	}
+	if (cmp == mdb_cmp_memn)
+		MDB_NODE_BSEARCH(mdb_cmp_memn);
+	else if (cmp == mdb_cmp_cint)
+		MDB_NODE_BSEARCH(mdb_cmp_cint);
+	else if (cmp == mdb_cmp_int)
+		MDB_NODE_BSEARCH(mdb_cmp_int);
+	else if (cmp == mdb_cmp_long)
+		MDB_NODE_BSEARCH(mdb_cmp_long);
+	else if (cmp == mdb_cmp_memnr)
+		MDB_NODE_BSEARCH(mdb_cmp_memnr);
+	else
+		MDB_NODE_BSEARCH(cmp);
 
 	if (rc > 0) {	/* Found entry is less than the key. */
 		i++;	/* Skip to get the smallest entry larger than key. */
@@ -6480,6 +6767,7 @@ mapped:
 	}
 
 done:
+	MDB_PROBE3(page__get, mc->mc_dbi, pgno, level);
 	*ret = p;
 	if (lvl)
 		*lvl = level;
@@ -7689,6 +7977,7 @@ mdb_cursor_put(MDB_cursor *mc, MDB_val *key, MDB_val *data,
 		if ((rc2 = mdb_page_spill(mc, key, rdata)))
 			return rc2;
 	}
+	*mc->mc_dbflag &= ~DB_COUNTS;
 
 	if (rc == MDB_NO_ROOT) {
 		MDB_page *np;
@@ -8131,6 +8420,7 @@ mdb_cursor_del(MDB_cursor *mc, unsigned int flags)
 
 	if (!(flags & MDB_NOSPILL) && (rc = mdb_page_spill(mc, NULL, NULL)))
 		return rc;
+	*mc->mc_dbflag &= ~DB_COUNTS;
 
 	rc = mdb_cursor_touch(mc);
 	if (rc)
@@ -8281,19 +8571,20 @@ mdb_leaf_size(MDB_env *env, MDB_val *key, MDB_val *data)
  * The size should depend on the environment's page size but since
  * we currently don't support spilling large keys onto overflow
  * pages, it's simply the size of the #MDB_node header plus the
- * size of the key. Sizes are always rounded up to an even number
- * of bytes, to guarantee 2-byte alignment of the #MDB_node headers.
- * @param[in] env The environment handle.
+ * size of the key, plus the subtree count in #MDB_COUNTED DBs.
+ * Sizes are always rounded up to an even number of bytes, to
+ * guarantee 2-byte alignment of the #MDB_node headers.
+ * @param[in] mc The cursor for this operation.
  * @param[in] key The key for the node.
  * @return The number of bytes needed to store the node.
  */
 static size_t
-mdb_branch_size(MDB_env *env, MDB_val *key)
+mdb_branch_size(MDB_cursor *mc, MDB_val *key)
 {
 	size_t		 sz;
 
-	sz = INDXSIZE(key);
-	if (sz > env->me_nodemax) {
+	sz = INDXSIZE(key) + NODECNTSZ(mc);
+	if (sz > mc->mc_txn->mt_env->me_nodemax) {
 		/* put on overflow page */
 		/* not implemented */
 		/* sz -= key->size - sizeof(pgno_t); */
@@ -8307,7 +8598,8 @@ mdb_branch_size(MDB_env *env, MDB_val *key)
  * @param[in] mc The cursor for this operation.
  * @param[in] indx The index on the page where the new node should be added.
  * @param[in] key The key for the new node.
- * @param[in] data The data for the new node, if any.
+ * @param[in] data The data for the new node, if any. For a branch node
+ * in an #MDB_COUNTED DB, the subtree count to copy, or NULL for zero.
  * @param[in] pgno The page number, if adding a branch node.
  * @param[in] flags Flags for the node.
  * @return 0 on success, non-zero on failure. Possible errors are:
@@ -8381,6 +8673,8 @@ mdb_node_add(MDB_cursor *mc, indx_t indx,
 		} else {
 			node_size += data->mv_size;
 		}
+	} else {
+		node_size += NODECNTSZ(mc);
 	}
 	node_size = EVEN(node_size);
 	if ((ssize_t)node_size > room)
@@ -8427,6 +8721,12 @@ update:
 			else
 				memcpy(ndata, data->mv_data, data->mv_size);
 		}
+	} else if (NODECNTSZ(mc)) {
+		/* Nodes pointing to a dirty page get their count at commit */
+		if (data)
+			memcpy(NODEDATA(node), data->mv_data, sizeof(mdb_size_t));
+		else
+			memset(NODEDATA(node), 0, sizeof(mdb_size_t));
 	}
 
 	return MDB_SUCCESS;
@@ -8477,6 +8777,8 @@ mdb_node_del(MDB_cursor *mc, int ksize)
 			sz += sizeof(pgno_t);
 		else
 			sz += NODEDSZ(node);
+	} else {
+		sz += NODECNTSZ(mc);
 	}
 	sz = EVEN(sz);
 
@@ -8769,6 +9071,400 @@ mdb_cursor_count(MDB_cursor *mc, mdb_size_t *countp)
 	return MDB_SUCCESS;
 }
 
+/** Compute the number of data items below a page of an #MDB_COUNTED DB.
+ * Clean pages carry correct counts in their branch nodes. A modified
+ * subtree is always reached through dirty pages, so only those are
+ * visited and summed again.
+ * @param[in] mc A cursor on the DB.
+ * @param[in] mp The page to count.
+ * @param[in] fix If non-zero, store the counts found in \b mp's nodes.
+ *	\b mp must then be dirty in this txn.
+ * @param[out] countp Address where the count will be stored.
+ * @return 0 on success, non-zero on failure.
+ */
+static int
+mdb_page_count(MDB_cursor *mc, MDB_page *mp, int fix, mdb_size_t *countp)
+{
+	MDB_page	*cp;
+	MDB_node	*node;
+	mdb_size_t	 total = 0, count;
+	unsigned int i, nkeys = NUMKEYS(mp);
+	int rc, lvl;
+
+	if (IS_LEAF(mp)) {
+		*countp = nkeys;
+		return MDB_SUCCESS;
+	}
+	for (i = 0; i < nkeys; i++) {
+		node = NODEPTR(mp, i);
+		if ((rc = mdb_page_get(mc, NODEPGNO(node), &cp, &lvl)) != 0)
+			return rc;
+		/* Spilled pages come back from the map without P_DIRTY,
+		 * they were counted before being flushed.
+		 */
+		if (F_ISSET(MP_FLAGS(cp), P_DIRTY) && (lvl || (mc->mc_flags & C_WRITEMAP))) {
+			rc = mdb_page_count(mc, cp, fix && lvl <= 1, &count);
+			if (rc)
+				return rc;
+			if (fix)
+				memcpy(NODEDATA(node), &count, sizeof(count));
+		} else {
+			memcpy(&count, NODEDATA(node), sizeof(count));
+		}
+		total += count;
+	}
+	*countp = total;
+	return MDB_SUCCESS;
+}
+
+/** Bring the subtree counts of a modified #MDB_COUNTED DB up to date.
+ * Counts are not maintained while pages are split, merged or have
+ * nodes added; this fixes them in one pass over the dirty pages.
+ * Called before commit, before spilling, and before counts are read.
+ * @param[in] txn A write transaction.
+ * @param[in] dbi The DB to update.
+ * @return 0 on success, non-zero on failure.
+ */
+static int
+mdb_dbi_recount(MDB_txn *txn, MDB_dbi dbi)
+{
+	MDB_cursor	mc;
+	MDB_page	*mp;
+	mdb_size_t	 total;
+	int rc, lvl;
+
+	if (!(txn->mt_dbs[dbi].md_flags & MDB_COUNTED) ||
+		(txn->mt_dbflags[dbi] & (DB_DIRTY|DB_COUNTS)) != DB_DIRTY ||
+		txn->mt_dbs[dbi].md_root == P_INVALID)
+		return MDB_SUCCESS;
+
+	mdb_cursor_init(&mc, txn, dbi, NULL);
+	if ((rc = mdb_page_get(&mc, txn->mt_dbs[dbi].md_root, &mp, &lvl)) != 0)
+		return rc;
+	if (!F_ISSET(MP_FLAGS(mp), P_DIRTY) || (lvl != 1 && !(mc.mc_flags & C_WRITEMAP)))
+		return MDB_SUCCESS;
+	if ((rc = mdb_page_count(&mc, mp, 1, &total)) != 0)
+		return rc;
+	if (total != txn->mt_dbs[dbi].md_entries) {
+		txn->mt_flags |= MDB_TXN_ERROR;
+		return MDB_CORRUPTED;
+	}
+	txn->mt_dbflags[dbi] |= DB_COUNTS;
+	return MDB_SUCCESS;
+}
+
+/** Return the number of data items below a branch node.
+ * Expects #mdb_dbi_recount() to have run in this txn.
+ */
+static int
+mdb_node_count(MDB_cursor *mc, MDB_node *node, mdb_size_t *countp)
+{
+	if (!(mc->mc_flags & C_ORIG_RDONLY)) {
+		MDB_page *mp;
+		int rc, lvl;
+		if ((rc = mdb_page_get(mc, NODEPGNO(node), &mp, &lvl)) != 0)
+			return rc;
+		/* Pages dirtied by a parent txn are counted at its commit */
+		if (lvl > 1 && F_ISSET(MP_FLAGS(mp), P_DIRTY))
+			return mdb_page_count(mc, mp, 0, countp);
+	}
+	memcpy(countp, NODEDATA(node), sizeof(mdb_size_t));
+	return MDB_SUCCESS;
+}
+
+/** Check a cursor before reading subtree counts */
+static int
+mdb_cursor_counted(MDB_cursor *mc)
+{
+	if (!(mc->mc_db->md_flags & MDB_COUNTED) || (mc->mc_flags & C_SUB))
+		return MDB_INCOMPATIBLE;
+
+	if (mc->mc_txn->mt_flags & MDB_TXN_BLOCKED)
+		return MDB_BAD_TXN;
+
+	if (F_ISSET(mc->mc_txn->mt_flags, MDB_TXN_RDONLY))
+		return MDB_SUCCESS;
+
+	return mdb_dbi_recount(mc->mc_txn, mc->mc_dbi);
+}
+
+int
+mdb_cursor_rank(MDB_cursor *mc, mdb_size_t *rankp)
+{
+	MDB_page	*mp;
+	mdb_size_t	 rank = 0, count;
+	unsigned int i, j;
+	int rc;
+
+	if (mc == NULL || rankp == NULL)
+		return EINVAL;
+
+	if ((rc = mdb_cursor_counted(mc)) != 0)
+		return rc;
+
+	if (!(mc->mc_flags & C_INITIALIZED))
+		return EINVAL;
+
+	if (!mc->mc_snum)
+		return MDB_NOTFOUND;
+
+	for (i = 0; i < mc->mc_top; i++) {
+		mp = mc->mc_pg[i];
+		for (j = 0; j < mc->mc_ki[i]; j++) {
+			if ((rc = mdb_node_count(mc, NODEPTR(mp, j), &count)) != 0)
+				return rc;
+			rank += count;
+		}
+	}
+	*rankp = rank + mc->mc_ki[mc->mc_top];
+	return MDB_SUCCESS;
+}
+
+int
+mdb_cursor_select(MDB_cursor *mc, mdb_size_t rank, MDB_val *key, MDB_val *data)
+{
+	MDB_page	*mp;
+	MDB_node	*node;
+	mdb_size_t	 count;
+	unsigned int i, nkeys;
+	int rc;
+
+	if (mc == NULL)
+		return EINVAL;
+
+	if ((rc = mdb_cursor_counted(mc)) != 0)
+		return rc;
+
+	if (rank >= mc->mc_db->md_entries)
+		return MDB_NOTFOUND;
+
+	if ((rc = mdb_page_search(mc, NULL, MDB_PS_ROOTONLY)) != 0)
+		return rc;
+
+	mp = mc->mc_pg[mc->mc_top];
+	while (IS_BRANCH(mp)) {
+		nkeys = NUMKEYS(mp);
+		for (i = 0; i < nkeys - 1; i++) {
+			if ((rc = mdb_node_count(mc, NODEPTR(mp, i), &count)) != 0)
+				return rc;
+			if (rank < count)
+				break;
+			rank -= count;
+		}
+		mc->mc_ki[mc->mc_top] = i;
+		if ((rc = mdb_page_get(mc, NODEPGNO(NODEPTR(mp, i)), &mp, NULL)) != 0)
+			return rc;
+		if ((rc = mdb_cursor_push(mc, mp)) != 0)
+			return rc;
+	}
+
+	if (!IS_LEAF(mp) || rank >= NUMKEYS(mp)) {
+		mc->mc_txn->mt_flags |= MDB_TXN_ERROR;
+		return MDB_CORRUPTED;
+	}
+	mc->mc_ki[mc->mc_top] = rank;
+	mc->mc_flags |= C_INITIALIZED;
+	mc->mc_flags &= ~C_EOF;
+
+	node = NODEPTR(mp, rank);
+	MDB_GET_KEY(node, key);
+	if (data)
+		return mdb_node_read(mc, node, data);
+	return MDB_SUCCESS;
+}
+
+/** Find the share of the DB's key space below each child of the root.
+ * The root's children are weighted by how many nodes they hold, since
+ * a partly filled child there would skew every estimate by a large
+ * fraction. Deeper pages are assumed to split their range evenly.
+ * @param[in] mc A cursor whose stack holds the root page.
+ * @param[in] indx The child to locate.
+ * @param[out] startp The share of the key space before child \b indx.
+ * @param[out] widthp The share of the key space below child \b indx.
+ * @return 0 on success, non-zero on failure.
+ */
+static int
+mdb_root_share(MDB_cursor *mc, unsigned int indx, double *startp, double *widthp)
+{
+	MDB_page	*mp = mc->mc_pg[0], *cp;
+	unsigned int i, nkeys = NUMKEYS(mp);
+	mdb_size_t	 before = 0, total = 0, n = 0;
+	int rc;
+
+	if (IS_LEAF(mp)) {
+		*startp = (double)indx / nkeys;
+		*widthp = 1.0 / nkeys;
+		return MDB_SUCCESS;
+	}
+	for (i = 0; i < nkeys; i++) {
+		if ((rc = mdb_page_get(mc, NODEPGNO(NODEPTR(mp, i)), &cp, NULL)) != 0)
+			return rc;
+		n = NUMKEYS(cp);
+		if (i < indx)
+			before += n;
+		else if (i == indx)
+			*widthp = n;
+		total += n;
+	}
+	*startp = (double)before / total;
+	*widthp /= total;
+	return MDB_SUCCESS;
+}
+
+int
+mdb_cursor_fraction(MDB_cursor *mc, double *fracp)
+{
+	MDB_page	*mp;
+	double		 frac, width;
+	unsigned int i, nkeys;
+	int rc;
+
+	if (mc == NULL || fracp == NULL || (mc->mc_flags & C_SUB))
+		return EINVAL;
+
+	if (mc->mc_txn->mt_flags & MDB_TXN_BLOCKED)
+		return MDB_BAD_TXN;
+
+	if (!(mc->mc_flags & C_INITIALIZED))
+		return EINVAL;
+
+	if (!mc->mc_snum || (mc->mc_flags & C_EOF)) {
+		*fracp = 1.0;
+		return MDB_SUCCESS;
+	}
+
+	if ((rc = mdb_root_share(mc, mc->mc_ki[0], &frac, &width)) != 0)
+		return rc;
+	for (i = 1; i < mc->mc_snum; i++) {
+		mp = mc->mc_pg[i];
+		nkeys = NUMKEYS(mp);
+		if (!nkeys)
+			break;
+		width /= nkeys;
+		frac += width * mc->mc_ki[i];
+	}
+	*fracp = frac < 1.0 ? frac : 1.0;
+	return MDB_SUCCESS;
+}
+
+/** Position a cursor at an estimated fraction of its DB.
+ * @param[in] mc The cursor to position.
+ * @param[in] frac The fraction, from 0.0 up to 1.0.
+ * @param[in] weigh How many levels, counting from the root, have their
+ *	children weighed by the number of nodes they hold. Below those, pages
+ *	are assumed to split their range evenly. Weighing a level costs a
+ *	read of every child of the page visited there.
+ * @param[out] key The key found, may be NULL.
+ * @param[out] data The data found, may be NULL.
+ * @return 0 on success, non-zero on failure.
+ */
+static int
+mdb_cursor_seek_fraction0(MDB_cursor *mc, double frac, unsigned int weigh,
+	MDB_val *key, MDB_val *data)
+{
+	MDB_page	*mp, *cp;
+	MDB_node	*leaf;
+	unsigned int nkeys;
+	indx_t		 indx;
+	int rc;
+
+	if (mc == NULL || (mc->mc_flags & C_SUB) || !(frac >= 0.0))
+		return EINVAL;
+
+	if (mc->mc_txn->mt_flags & MDB_TXN_BLOCKED)
+		return MDB_BAD_TXN;
+
+	if (frac >= 1.0)
+		return MDB_NOTFOUND;
+
+	if (mc->mc_xcursor) {
+		MDB_CURSOR_UNREF(&mc->mc_xcursor->mx_cursor, 0);
+		mc->mc_xcursor->mx_cursor.mc_flags &= ~(C_INITIALIZED|C_EOF);
+	}
+
+	if ((rc = mdb_page_search(mc, NULL, MDB_PS_ROOTONLY)) != 0)
+		return rc;
+
+	/* Descend into the node covering frac, rescaling frac to the
+	 * part of that node's range that is left over.
+	 */
+	for (;;) {
+		mp = mc->mc_pg[mc->mc_top];
+		nkeys = NUMKEYS(mp);
+		if (mc->mc_top >= weigh || IS_LEAF(mp)) {
+			frac *= nkeys;
+			indx = (indx_t)frac;
+			if (indx >= nkeys)
+				indx = nkeys - 1;
+			frac -= indx;
+		} else {
+			mdb_size_t total = 0, before = 0, n = 0;
+			for (indx = 0; indx < nkeys; indx++) {
+				if ((rc = mdb_page_get(mc, NODEPGNO(NODEPTR(mp, indx)), &cp, NULL)) != 0)
+					return rc;
+				total += NUMKEYS(cp);
+			}
+			frac *= total;
+			for (indx = 0; indx < nkeys; indx++) {
+				if ((rc = mdb_page_get(mc, NODEPGNO(NODEPTR(mp, indx)), &cp, NULL)) != 0)
+					return rc;
+				n = NUMKEYS(cp);
+				if (frac < before + n || indx == nkeys - 1)
+					break;
+				before += n;
+			}
+			frac = n ? (frac - before) / n : 0.0;
+			if (frac < 0.0)
+				frac = 0.0;
+		}
+		mc->mc_ki[mc->mc_top] = indx;
+		if (IS_LEAF(mp))
+			break;
+		if ((rc = mdb_page_get(mc, NODEPGNO(NODEPTR(mp, indx)), &mp, NULL)) != 0)
+			return rc;
+		if ((rc = mdb_cursor_push(mc, mp)) != 0)
+			return rc;
+	}
+
+	mc->mc_flags |= C_INITIALIZED;
+	mc->mc_flags &= ~C_EOF;
+
+	if (IS_LEAF2(mp)) {
+		if (key) {
+			key->mv_size = mc->mc_db->md_pad;
+			key->mv_data = LEAF2KEY(mp, indx, key->mv_size);
+		}
+		return MDB_SUCCESS;
+	}
+
+	leaf = NODEPTR(mp, indx);
+	if (F_ISSET(leaf->mn_flags, F_DUPDATA)) {
+		mdb_xcursor_init1(mc, leaf);
+		rc = mdb_cursor_first(&mc->mc_xcursor->mx_cursor, data, NULL);
+		if (rc)
+			return rc;
+	} else if (data) {
+		if ((rc = mdb_node_read(mc, leaf, data)) != MDB_SUCCESS)
+			return rc;
+	}
+
+	MDB_GET_KEY(leaf, key);
+	return MDB_SUCCESS;
+}
+
+int
+mdb_cursor_seek_fraction(MDB_cursor *mc, double frac, MDB_val *key, MDB_val *data)
+{
+	/* Weigh the root's children as #mdb_root_share() does */
+	return mdb_cursor_seek_fraction0(mc, frac, 1, key, data);
+}
+
+int
+mdb_cursor_sample(MDB_cursor *mc, double frac, MDB_val *key, MDB_val *data)
+{
+	return mdb_cursor_seek_fraction0(mc, frac, ~0U, key, data);
+}
+
 void
 mdb_cursor_close(MDB_cursor *mc)
 {
@@ -8818,12 +9514,19 @@ mdb_update_key(MDB_cursor *mc, MDB_val *key)
 	size_t			 len;
 	int				 delta, ksize, oksize;
 	indx_t			 ptr, i, numkeys, indx;
+	mdb_size_t		 count;
+	MDB_val			 cdata;
 	DKBUF;
 
 	indx = mc->mc_ki[mc->mc_top];
 	mp = mc->mc_pg[mc->mc_top];
 	node = NODEPTR(mp, indx);
 	ptr = mp->mp_ptrs[indx];
+	/* The subtree count follows the key, keep it across the change */
+	cdata.mv_size = NODECNTSZ(mc);
+	cdata.mv_data = &count;
+	if (cdata.mv_size)
+		memcpy(&count, NODEDATA(node), sizeof(count));
 #if MDB_DEBUG
 	{
 		MDB_val	k2;
@@ -8851,7 +9554,8 @@ mdb_update_key(MDB_cursor *mc, MDB_val *key)
 			DPRINTF(("Not enough room, delta = %d, splitting...", delta));
 			pgno = NODEPGNO(node);
 			mdb_node_del(mc, 0);
-			return mdb_page_split(mc, key, NULL, pgno, MDB_SPLIT_REPLACE);
+			return mdb_page_split(mc, key, cdata.mv_size ? &cdata : NULL,
+				pgno, MDB_SPLIT_REPLACE);
 		}
 
 		numkeys = NUMKEYS(mp);
@@ -8874,6 +9578,8 @@ mdb_update_key(MDB_cursor *mc, MDB_val *key)
 
 	if (key->mv_size)
 		memcpy(NODEKEY(node), key->mv_data, key->mv_size);
+	if (cdata.mv_size)
+		memcpy(NODEDATA(node), &count, sizeof(count));
 
 	return MDB_SUCCESS;
 }
@@ -8949,7 +9655,8 @@ mdb_node_move(MDB_cursor *csrc, MDB_cursor *cdst, int fromleft)
 			key.mv_size = NODEKSZ(srcnode);
 			key.mv_data = NODEKEY(srcnode);
 		}
-		data.mv_size = NODEDSZ(srcnode);
+		data.mv_size = IS_LEAF(csrc->mc_pg[csrc->mc_top]) ?
+			NODEDSZ(srcnode) : NODECNTSZ(csrc);
 		data.mv_data = NODEDATA(srcnode);
 	}
 	mn.mc_xcursor = NULL;
@@ -9190,7 +9897,7 @@ mdb_page_merge(MDB_cursor *csrc, MDB_cursor *cdst)
 				key.mv_data = NODEKEY(srcnode);
 			}
 
-			data.mv_size = NODEDSZ(srcnode);
+			data.mv_size = IS_LEAF(psrc) ? NODEDSZ(srcnode) : NODECNTSZ(csrc);
 			data.mv_data = NODEDATA(srcnode);
 			rc = mdb_node_add(cdst, j, &key, &data, NODEPGNO(srcnode), srcnode->mn_flags);
 			if (rc != MDB_SUCCESS)
@@ -9644,6 +10351,227 @@ mdb_del0(MDB_txn *txn, MDB_dbi dbi,
 	return rc;
 }
 
+/** Free the pages of a subtree that has been cut out of its DB.
+ * Branch pages are read to find their children. Leaf pages are only
+ * read when they may refer to overflow pages, or when their keys must
+ * be counted.
+ * @param[in] mc A cursor on the DB.
+ * @param[in] mp The root page of the subtree.
+ * @param[in] height The number of levels in the subtree.
+ * @param[in,out] countp If not NULL, the number of keys freed is added here.
+ * @return 0 on success, non-zero on failure.
+ */
+static int
+mdb_page_free_tree(MDB_cursor *mc, MDB_page *mp, unsigned int height,
+	mdb_size_t *countp)
+{
+	MDB_txn *txn = mc->mc_txn;
+	MDB_db *db = mc->mc_db;
+	MDB_node *node;
+	MDB_page *cp;
+	pgno_t pg;
+	unsigned int i, nkeys = NUMKEYS(mp);
+	int rc;
+
+	if (IS_LEAF(mp)) {
+		for (i = 0; db->md_overflow_pages && i < nkeys; i++) {
+			node = NODEPTR(mp, i);
+			if (node->mn_flags & F_BIGDATA) {
+				memcpy(&pg, NODEDATA(node), sizeof(pg));
+				if ((rc = mdb_page_get(mc, pg, &cp, NULL)) != 0)
+					return rc;
+				mdb_cassert(mc, IS_OVERFLOW(cp));
+				rc = mdb_midl_append_range(&txn->mt_free_pgs, pg, cp->mp_pages);
+				if (rc)
+					return rc;
+				db->md_overflow_pages -= cp->mp_pages;
+			}
+		}
+		if (countp)
+			*countp += nkeys;
+		db->md_leaf_pages--;
+	} else {
+		for (i = 0; i < nkeys; i++) {
+			pg = NODEPGNO(NODEPTR(mp, i));
+			if (height > 2 || countp || db->md_overflow_pages) {
+				if ((rc = mdb_page_get(mc, pg, &cp, NULL)) != 0 ||
+					(rc = mdb_page_free_tree(mc, cp, height - 1, countp)) != 0)
+					return rc;
+			} else {
+				/* a leaf with nothing in it to free or count */
+				if ((rc = mdb_midl_append(&txn->mt_free_pgs, pg)) != 0)
+					return rc;
+				db->md_leaf_pages--;
+			}
+		}
+		db->md_branch_pages--;
+	}
+	return mdb_midl_append(&txn->mt_free_pgs, mp->mp_pgno);
+}
+
+/** Cut a whole subtree out of a DB.
+ * The node pointing to the subtree is deleted from its branch page and
+ * the subtree's pages are freed without being touched.
+ * @param[in] mc A cursor on the first key of the subtree.
+ * @param[in] lvl The level of the branch page that points to the subtree.
+ * @return 0 on success, non-zero on failure.
+ */
+static int
+mdb_del_subtree(MDB_cursor *mc, unsigned int lvl)
+{
+	MDB_db *db = mc->mc_db;
+	MDB_page *mp;
+	MDB_val key;
+	mdb_size_t count = 0, *countp = &count;
+	int rc;
+
+	if ((rc = mdb_page_spill(mc, NULL, NULL)) != 0)
+		return rc;
+	mc->mc_snum = lvl + 1;
+	mc->mc_top = lvl;
+	if ((rc = mdb_cursor_touch(mc)) != 0)
+		return rc;
+	rc = mdb_page_get(mc, NODEPGNO(NODEPTR(mc->mc_pg[lvl], mc->mc_ki[lvl])),
+		&mp, NULL);
+	if (rc)
+		return rc;
+	/* Subtree counts are exact below clean pages, so take the
+	 * count from them instead of reading every leaf.
+	 */
+	if (db->md_flags & MDB_COUNTED) {
+		if ((rc = mdb_page_count(mc, mp, 0, &count)) != 0)
+			return rc;
+		countp = NULL;
+	}
+	*mc->mc_dbflag &= ~DB_COUNTS;
+	if ((rc = mdb_page_free_tree(mc, mp, db->md_depth - lvl - 1, countp)) != 0)
+		return rc;
+	db->md_entries -= count;
+
+	mdb_node_del(mc, 0);
+	if (mc->mc_ki[lvl] == 0) {
+		key.mv_size = 0;
+		if ((rc = mdb_update_key(mc, &key)) != 0)
+			return rc;
+	}
+	return mdb_rebalance(mc);
+}
+
+int
+mdb_del_range(MDB_txn *txn, MDB_dbi dbi, MDB_val *lo, MDB_val *hi,
+	mdb_size_t *countp)
+{
+	MDB_cursor mc, *m2;
+	MDB_xcursor mx;
+	MDB_val key, data, ub;
+	MDB_page *mp;
+	MDB_node *node;
+	MDB_cmp_func *cmp;
+	mdb_size_t entries;
+	int rc, i, j, top, past, bounded, dupsort, seek = 1;
+
+	if (!TXN_DBI_EXIST(txn, dbi, DB_USRVALID))
+		return EINVAL;
+
+	if (txn->mt_flags & (MDB_TXN_RDONLY|MDB_TXN_BLOCKED))
+		return (txn->mt_flags & MDB_TXN_RDONLY) ? EACCES : MDB_BAD_TXN;
+
+	if (countp)
+		*countp = 0;
+	/* No key sorts before an empty one */
+	if (lo && !lo->mv_size)
+		lo = NULL;
+
+	mdb_cursor_init(&mc, txn, dbi, &mx);
+	cmp = mc.mc_dbx->md_cmp;
+	entries = mc.mc_db->md_entries;
+	dupsort = mc.mc_db->md_flags & MDB_DUPSORT;
+
+	/* Subtrees on the right edge of the tree have no upper
+	 * separator; they are inside the range if the last key is.
+	 */
+	rc = mdb_cursor_get(&mc, &key, NULL, MDB_LAST);
+	if (rc)
+		return rc == MDB_NOTFOUND ? MDB_SUCCESS : rc;
+	past = !hi || cmp(&key, hi) < 0;
+
+	/* Unlinked subtrees would leave other cursors on freed pages */
+	for (m2 = txn->mt_cursors[dbi]; m2; m2 = m2->mc_next) {
+		m2->mc_flags &= ~(C_INITIALIZED|C_EOF);
+		m2->mc_snum = 0;
+		m2->mc_top = 0;
+	}
+	mc.mc_next = txn->mt_cursors[dbi];
+	txn->mt_cursors[dbi] = &mc;
+
+	for (;;) {
+		if (!seek) {
+			rc = mdb_cursor_get(&mc, &key, &data, MDB_NEXT);
+		} else if (lo) {
+			key = *lo;
+			rc = mdb_cursor_get(&mc, &key, &data, MDB_SET_RANGE);
+		} else {
+			rc = mdb_cursor_get(&mc, &key, &data, MDB_FIRST);
+		}
+		if (rc || (hi && cmp(&key, hi) >= 0))
+			break;
+
+		if (!dupsort) {
+			/* Every subtree below level i starts at this key */
+			top = mc.mc_top;
+			for (i = top; i >= 0 && !mc.mc_ki[i]; i--) ;
+			if (i < 0 && past) {
+				/* The whole tree is in the range */
+				if ((rc = mdb_drop0(&mc, 0)) != 0)
+					break;
+				*mc.mc_dbflag |= DB_DIRTY;
+				mc.mc_db->md_depth = 0;
+				mc.mc_db->md_branch_pages = 0;
+				mc.mc_db->md_leaf_pages = 0;
+				mc.mc_db->md_overflow_pages = 0;
+				mc.mc_db->md_entries = 0;
+				mc.mc_db->md_root = P_INVALID;
+				txn->mt_flags |= MDB_TXN_DIRTY;
+				break;
+			}
+			/* Find the largest of those subtrees that ends before hi */
+			bounded = 0;
+			for (j = 0; j < top; j++) {
+				mp = mc.mc_pg[j];
+				if (mc.mc_ki[j] + 1u < NUMKEYS(mp)) {
+					node = NODEPTR(mp, mc.mc_ki[j] + 1);
+					ub.mv_size = NODEKSZ(node);
+					ub.mv_data = NODEKEY(node);
+					bounded = 1;
+				}
+				if (j >= i && (bounded ? !hi || cmp(&ub, hi) <= 0 : past))
+					break;
+			}
+			if (j < top) {
+				if ((rc = mdb_del_subtree(&mc, j)) != 0)
+					break;
+				/* The cursor was left on a branch page */
+				mc.mc_flags &= ~(C_INITIALIZED|C_EOF);
+				seek = 1;
+				continue;
+			}
+		}
+		if ((rc = mdb_cursor_del(&mc, dupsort ? MDB_NODUPDATA : 0)) != 0)
+			break;
+		/* A deleted key's duplicates leave the sub-cursor behind */
+		seek = dupsort;
+	}
+	txn->mt_cursors[dbi] = mc.mc_next;
+
+	if (rc == MDB_NOTFOUND)
+		rc = MDB_SUCCESS;
+	if (rc)
+		txn->mt_flags |= MDB_TXN_ERROR;
+	else if (countp)
+		*countp = entries - mc.mc_db->md_entries;
+	return rc;
+}
+
 /** Split a page and insert a new node.
  * Set #MDB_TXN_ERROR on failure.
  * @param[in,out] mc Cursor pointing to the page and desired insertion index.
@@ -9680,6 +10608,7 @@ mdb_page_split(MDB_cursor *mc, MDB_val *newkey, MDB_val *newdata, pgno_t newpgno
 	DPRINTF(("-----> splitting %s page %"Yu" and adding [%s] at index %i/%i",
 	    IS_LEAF(mp) ? "leaf" : "branch", mp->mp_pgno,
 	    DKEY(newkey), mc->mc_ki[mc->mc_top], nkeys));
+	MDB_PROBE3(page__split, mc->mc_dbi, mp->mp_pgno, nkeys);
 
 	/* Create a right sibling. */
 	if ((rc = mdb_page_new(mc, mp->mp_flags, 1, &rp)))
@@ -9786,7 +10715,7 @@ mdb_page_split(MDB_cursor *mc, MDB_val *newkey, MDB_val *newdata, pgno_t newpgno
 			if (IS_LEAF(mp))
 				nsize = mdb_leaf_size(env, newkey, newdata);
 			else
-				nsize = mdb_branch_size(env, newkey);
+				nsize = mdb_branch_size(mc, newkey);
 			nsize = EVEN(nsize);
 
 			/* grab a page to hold a temporary copy */
@@ -9845,6 +10774,8 @@ mdb_page_split(MDB_cursor *mc, MDB_val *newkey, MDB_val *newdata, pgno_t newpgno
 								psize += sizeof(pgno_t);
 							else
 								psize += NODEDSZ(node);
+						} else {
+							psize += NODECNTSZ(mc);
 						}
 						psize = EVEN(psize);
 					}
@@ -9869,7 +10800,7 @@ mdb_page_split(MDB_cursor *mc, MDB_val *newkey, MDB_val *newdata, pgno_t newpgno
 
 	/* Copy separator key to the parent.
 	 */
-	if (SIZELEFT(mn.mc_pg[ptop]) < mdb_branch_size(env, &sepkey)) {
+	if (SIZELEFT(mn.mc_pg[ptop]) < mdb_branch_size(mc, &sepkey)) {
 		int snum = mc->mc_snum;
 		mn.mc_snum--;
 		mn.mc_top--;
@@ -9931,8 +10862,11 @@ mdb_page_split(MDB_cursor *mc, MDB_val *newkey, MDB_val *newdata, pgno_t newpgno
 				rkey.mv_size = newkey->mv_size;
 				if (IS_LEAF(mp)) {
 					rdata = newdata;
-				} else
+				} else {
+					/* subtree count, if the caller is moving a node */
+					rdata = newdata;
 					pgno = newpgno;
+				}
 				flags = nflags;
 				/* Update index for the new key. */
 				mc->mc_ki[mc->mc_top] = j;
@@ -9943,9 +10877,12 @@ mdb_page_split(MDB_cursor *mc, MDB_val *newkey, MDB_val *newdata, pgno_t newpgno
 				if (IS_LEAF(mp)) {
 					xdata.mv_data = NODEDATA(node);
 					xdata.mv_size = NODEDSZ(node);
-					rdata = &xdata;
-				} else
+				} else {
+					xdata.mv_data = NODEDATA(node);
+					xdata.mv_size = NODECNTSZ(mc);
 					pgno = NODEPGNO(node);
+				}
+				rdata = &xdata;
 				flags = node->mn_flags;
 			}
 
@@ -10811,6 +11748,11 @@ int mdb_dbi_open(MDB_txn *txn, const char *name, unsigned int flags, MDB_dbi *db
 
 	if (flags & ~VALID_FLAGS)
 		return EINVAL;
+	/* Subtree counts only cover unique keys, and the main DB holds
+	 * the named DB records which are written during commit.
+	 */
+	if ((flags & MDB_COUNTED) && (!name || (flags & MDB_DUPSORT)))
+		return EINVAL;
 	if (txn->mt_flags & MDB_TXN_BLOCKED)
 		return MDB_BAD_TXN;
 
@@ -10899,7 +11841,9 @@ int mdb_dbi_open(MDB_txn *txn, const char *name, unsigned int flags, MDB_dbi *db
 		txn->mt_dbxs[slot].md_name.mv_data = namedup;
 		txn->mt_dbxs[slot].md_name.mv_size = len;
 		txn->mt_dbxs[slot].md_rel = NULL;
-		txn->mt_dbflags[slot] = dbflag;
+		if (!(txn->mt_dbflags[slot] & DB_INITED))
+			txn->mt_dbtouch[txn->mt_numtouch++] = slot;
+		txn->mt_dbflags[slot] = dbflag|DB_INITED;
 		/* txn-> and env-> are the same in read txns, use
 		 * tmp variable to avoid undefined assignment
 		 */
@@ -10935,6 +11879,106 @@ mdb_stat(MDB_txn *txn, MDB_dbi dbi, MDB_stat *arg)
 	return mdb_stat0(txn->mt_env, &txn->mt_dbs[dbi], arg);
 }
 
+/** Visit the subtree rooted at \b pgno, see #mdb_page_walk().
+ * @param[in] mc A cursor of the walked transaction, used to fetch pages.
+ * @param[in] pgno The root of the subtree.
+ * @param[in] depth The level of \b pgno in its tree.
+ * @param[in] dup Nonzero when walking a sorted-duplicate subtree.
+ * @param[in] func The callback.
+ * @param[in] ctx The callback's context.
+ * @return 0 on success, non-zero on failure or when \b func stopped.
+ */
+static int ESECT
+mdb_page_walk0(MDB_cursor *mc, pgno_t pgno, unsigned int depth, int dup,
+	MDB_page_func *func, void *ctx)
+{
+	MDB_env *env = mc->mc_txn->mt_env;
+	MDB_page_info pi;
+	MDB_page *mp, *omp;
+	MDB_node *ni;
+	MDB_db db;
+	pgno_t pg;
+	unsigned int i, n;
+	int rc;
+
+	if ((rc = mdb_page_get(mc, pgno, &mp, NULL)) != 0)
+		return rc;
+	if (!(MP_FLAGS(mp) & (P_BRANCH|P_LEAF)))
+		return MDB_CORRUPTED;
+	n = NUMKEYS(mp);
+	pi.pi_pgno = pgno;
+	pi.pi_type = IS_BRANCH(mp) ? MDB_PAGE_BRANCH : MDB_PAGE_LEAF;
+	pi.pi_depth = depth;
+	pi.pi_nkeys = n;
+	pi.pi_pages = 1;
+	pi.pi_size = env->me_psize;
+	pi.pi_used = env->me_psize - SIZELEFT(mp);
+	pi.pi_dup = dup;
+	if ((rc = func(&pi, ctx)) != 0)
+		return rc;
+
+	if (IS_BRANCH(mp)) {
+		for (i=0; i<n; i++) {
+			rc = mdb_page_walk0(mc, NODEPGNO(NODEPTR(mp, i)), depth + 1, dup,
+				func, ctx);
+			if (rc)
+				return rc;
+		}
+		return MDB_SUCCESS;
+	}
+
+	/* A LEAF2 page or a leaf of a duplicate subtree holds only keys */
+	if (IS_LEAF2(mp) || dup)
+		return MDB_SUCCESS;
+	for (i=0; i<n; i++) {
+		ni = NODEPTR(mp, i);
+		if (ni->mn_flags & F_BIGDATA) {
+			memcpy(&pg, NODEDATA(ni), sizeof(pg));
+			if ((rc = mdb_page_get(mc, pg, &omp, NULL)) != 0)
+				return rc;
+			if (!IS_OVERFLOW(omp))
+				return MDB_CORRUPTED;
+			pi.pi_pgno = pg;
+			pi.pi_type = MDB_PAGE_OVERFLOW;
+			pi.pi_depth = depth;
+			pi.pi_nkeys = 0;
+			pi.pi_pages = omp->mp_pages;
+			pi.pi_size = (size_t)omp->mp_pages * env->me_psize;
+			pi.pi_used = PAGEHDRSZ + NODEDSZ(ni);
+			pi.pi_dup = 0;
+			if ((rc = func(&pi, ctx)) != 0)
+				return rc;
+		} else if ((ni->mn_flags & (F_DUPDATA|F_SUBDATA)) == (F_DUPDATA|F_SUBDATA)) {
+			memcpy(&db, NODEDATA(ni), sizeof(db));
+			if (db.md_root != P_INVALID) {
+				rc = mdb_page_walk0(mc, db.md_root, 1, 1, func, ctx);
+				if (rc)
+					return rc;
+			}
+		}
+	}
+	return MDB_SUCCESS;
+}
+
+int ESECT
+mdb_page_walk(MDB_txn *txn, MDB_dbi dbi, MDB_page_func *func, void *ctx)
+{
+	MDB_cursor mc;
+	MDB_xcursor mx;
+
+	if (!func || !TXN_DBI_EXIST(txn, dbi, DB_VALID))
+		return EINVAL;
+
+	if (txn->mt_flags & MDB_TXN_BLOCKED)
+		return MDB_BAD_TXN;
+
+	/* Stale, must read the DB's root. cursor_init does it for us. */
+	mdb_cursor_init(&mc, txn, dbi, &mx);
+	if (txn->mt_dbs[dbi].md_root == P_INVALID)
+		return MDB_SUCCESS;
+	return mdb_page_walk0(&mc, txn->mt_dbs[dbi].md_root, 1, 0, func, ctx);
+}
+
 void mdb_dbi_close(MDB_env *env, MDB_dbi dbi)
 {
 	char *ptr;
@@ -11095,7 +12139,7 @@ int mdb_drop(MDB_txn *txn, MDB_dbi dbi, int del)
 	if (del && dbi >= CORE_DBS) {
 		rc = mdb_del0(txn, MAIN_DBI, &mc->mc_dbx->md_name, NULL, F_SUBDATA);
 		if (!rc) {
-			txn->mt_dbflags[dbi] = DB_STALE;
+			txn->mt_dbflags[dbi] = DB_STALE|DB_INITED;
 			mdb_dbi_close(txn->mt_env, dbi);
 		} else {
 			txn->mt_flags |= MDB_TXN_ERROR;
@@ -11117,6 +12161,52 @@ leave:
 	return rc;
 }
 
+int mdb_dbi_swap(MDB_txn *txn, MDB_dbi a, MDB_dbi b)
+{
+	MDB_cursor mc, *m2;
+	MDB_xcursor mx;
+	MDB_db db;
+	unsigned int i, fa, fb;
+	MDB_dbi dbi[2];
+
+	if (a == b || a < CORE_DBS || b < CORE_DBS ||
+		!TXN_DBI_EXIST(txn, a, DB_USRVALID) || !TXN_DBI_EXIST(txn, b, DB_USRVALID))
+		return EINVAL;
+
+	if (txn->mt_flags & (MDB_TXN_RDONLY|MDB_TXN_BLOCKED))
+		return (txn->mt_flags & MDB_TXN_RDONLY) ? EACCES : MDB_BAD_TXN;
+
+	if (TXN_DBI_CHANGED(txn, a) || TXN_DBI_CHANGED(txn, b))
+		return MDB_BAD_DBI;
+
+	dbi[0] = a;
+	dbi[1] = b;
+	for (i = 0; i < 2; i++) {
+		/* Stale, must read the DB's root. cursor_init does it for us. */
+		if (txn->mt_dbflags[dbi[i]] & DB_STALE)
+			mdb_cursor_init(&mc, txn, dbi[i], &mx);
+	}
+	/* The records must agree on how their keys and data are kept */
+	if (txn->mt_dbs[a].md_flags != txn->mt_dbs[b].md_flags)
+		return MDB_INCOMPATIBLE;
+
+	/* The trees now belong to the other handle */
+	for (i = 0; i < 2; i++) {
+		for (m2 = txn->mt_cursors[dbi[i]]; m2; m2 = m2->mc_next)
+			m2->mc_flags &= ~(C_INITIALIZED|C_EOF);
+	}
+
+	db = txn->mt_dbs[a];
+	txn->mt_dbs[a] = txn->mt_dbs[b];
+	txn->mt_dbs[b] = db;
+	fa = txn->mt_dbflags[a] & DB_COUNTS;
+	fb = txn->mt_dbflags[b] & DB_COUNTS;
+	txn->mt_dbflags[a] = (txn->mt_dbflags[a] & ~DB_COUNTS) | fb | DB_DIRTY;
+	txn->mt_dbflags[b] = (txn->mt_dbflags[b] & ~DB_COUNTS) | fa | DB_DIRTY;
+	txn->mt_flags |= MDB_TXN_DIRTY;
+	return MDB_SUCCESS;
+}
+
 int mdb_set_compare(MDB_txn *txn, MDB_dbi dbi, MDB_cmp_func *cmp)
 {
 	if (!TXN_DBI_EXIST(txn, dbi, DB_USRVALID))